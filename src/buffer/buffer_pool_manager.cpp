@@ -13,8 +13,11 @@
 #include "buffer/buffer_pool_manager.h"
 #include "common/logger.h"
 
+#include <algorithm>
 #include <list>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace bustub {
 
@@ -43,7 +46,7 @@ Page *BufferPoolManager::FetchPageImpl(page_id_t page_id) {
   // 2.     If R is dirty, write it back to the disk.
   // 3.     Delete R from the page table and insert P.
   // 4.     Update P's metadata, read in the page content from disk, and then return a pointer to P.
-    std::lock_guard<std::mutex> lock(latch_);
+    std::unique_lock<std::mutex> lock(latch_);
     Page* ret = nullptr;
     if (page_table_.find(page_id) != page_table_.end()) {
         frame_id_t fid = page_table_[page_id];
@@ -52,10 +55,32 @@ Page *BufferPoolManager::FetchPageImpl(page_id_t page_id) {
         ret = pages_ + fid;
     } else {
         ret = GetNewPageFromBPM(false, page_id);
+        if (ret != nullptr && page_load_hook_) {
+            // Latch the page before it becomes reachable, so other users wait until the hook has finished with it.
+            ret->WLatch();
+            lock.unlock();
+            hook_latch_.RLock();
+            bool dirty = page_load_hook_ && page_load_hook_(ret);
+            hook_latch_.RUnlock();
+            ret->WUnlatch();
+            if (dirty) {
+                lock.lock();
+                ret->is_dirty_ = true;
+            }
+        }
     }
     return ret;
 }
 
+void BufferPoolManager::SetPageLoadHook(std::function<bool(Page *)> hook) {
+    hook_latch_.WLock();
+    {
+        std::lock_guard<std::mutex> lock(latch_);
+        page_load_hook_ = std::move(hook);
+    }
+    hook_latch_.WUnlock();
+}
+
 bool BufferPoolManager::UnpinPageImpl(page_id_t page_id, bool is_dirty, LatchType latch_type) { 
     std::lock_guard<std::mutex> lock(latch_);
     bool ret = false;
@@ -131,14 +156,47 @@ bool BufferPoolManager::FlushSinglePage(page_id_t page_id) {
     bool ret = false;
     assert(page_id != INVALID_PAGE_ID);
     if( page_table_.find(page_id) != page_table_.end()) {
-        frame_id_t fid = page_table_[page_id];
-        if (pages_[fid].is_dirty_) disk_manager_->WritePage(page_id, pages_[fid].GetData());
-        pages_[fid].is_dirty_ &= 0;
+        WriteBackFrame(page_table_[page_id]);
         ret = true;
     }
     return ret;
 }
 
+void BufferPoolManager::WriteBackFrame(frame_id_t fid) {
+    if (!pages_[fid].is_dirty_) return;
+    if (enable_logging && log_manager_ != nullptr) log_manager_->Flush(pages_[fid].GetLSN());
+    disk_manager_->WritePage(pages_[fid].page_id_, pages_[fid].data_);
+    pages_[fid].is_dirty_ = false;
+    pages_[fid].rec_lsn_ = INVALID_LSN;
+}
+
+std::vector<std::pair<page_id_t, lsn_t>> BufferPoolManager::GetDirtyPageTable() {
+    std::lock_guard<std::mutex> lock(latch_);
+    std::vector<std::pair<page_id_t, lsn_t>> dirty_pages;
+    for (auto &entry : page_table_) {
+        Page &page = pages_[entry.second];
+        lsn_t rec_lsn = page.rec_lsn_;
+        if (page.is_dirty_ && rec_lsn != INVALID_LSN) dirty_pages.emplace_back(entry.first, rec_lsn);
+    }
+    return dirty_pages;
+}
+
+size_t BufferPoolManager::FlushOldestDirtyPages(size_t max_pages) {
+    std::lock_guard<std::mutex> lock(latch_);
+    std::vector<std::pair<lsn_t, frame_id_t>> candidates;
+    for (auto &entry : page_table_) {
+        Page &page = pages_[entry.second];
+        lsn_t rec_lsn = page.rec_lsn_;
+        if (page.is_dirty_ && rec_lsn != INVALID_LSN) candidates.emplace_back(rec_lsn, entry.second);
+    }
+    size_t count = std::min(max_pages, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end());
+    for (size_t i = 0; i < count; i++) {
+        WriteBackFrame(candidates[i].second);
+    }
+    return count;
+}
+
 Page* BufferPoolManager::GetNewPageFromBPM(bool newpage, page_id_t page_id) {
     Page* ret = nullptr;
     frame_id_t fid = -1;
@@ -147,8 +205,7 @@ Page* BufferPoolManager::GetNewPageFromBPM(bool newpage, page_id_t page_id) {
         free_list_.pop_front();
     } else {
         if (replacer_->Victim(&fid)) {
-            if(pages_[fid].is_dirty_) disk_manager_->WritePage(pages_[fid].page_id_, pages_[fid].data_);
-            pages_[fid].is_dirty_ &= 0;
+            WriteBackFrame(fid);
             page_table_.erase(pages_[fid].page_id_);
             replacer_->Pin(fid);
         }
@@ -165,6 +222,7 @@ Page* BufferPoolManager::GetNewPageFromBPM(bool newpage, page_id_t page_id) {
             page_table_[page_id] = fid;
         }
         pages_[fid].is_dirty_ = false;
+        pages_[fid].rec_lsn_ = INVALID_LSN;
         pages_[fid].pin_count_ = 1;
         ret = pages_ + fid;
     }
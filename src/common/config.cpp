@@ -18,6 +18,12 @@ std::atomic<bool> enable_logging(false);
 
 std::chrono::duration<int64_t> log_timeout = std::chrono::seconds(1);
 
+std::atomic<bool> enable_delta_update_logging(false);
+
+std::chrono::milliseconds background_writer_interval = std::chrono::milliseconds(100);
+
+std::chrono::milliseconds commit_latency_dump_interval = std::chrono::seconds(10);
+
 std::chrono::milliseconds cycle_detection_interval = std::chrono::milliseconds(50);
 
 }  // namespace bustub
@@ -0,0 +1,57 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// latency_histogram.cpp
+//
+// Identification: src/common/latency_histogram.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "common/latency_histogram.h"
+
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace bustub {
+
+std::chrono::nanoseconds LatencyHistogram::GetPercentile(double quantile) const {
+  uint64_t count = GetCount();
+  if (count == 0) {
+    return std::chrono::nanoseconds(0);
+  }
+  auto rank = static_cast<uint64_t>(std::ceil(std::clamp(quantile, 0.0, 1.0) * count));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < NUM_BUCKETS; i++) {
+    seen += buckets_[i].load(std::memory_order_relaxed);
+    if (seen >= rank && seen > 0) {
+      uint64_t bucket_end = i == 0 ? 0 : (uint64_t{1} << i) - 1;
+      return std::min(std::chrono::nanoseconds(bucket_end), GetMax());
+    }
+  }
+  return GetMax();
+}
+
+void LatencyHistogram::Reset() {
+  for (auto &bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  count_.store(0, std::memory_order_relaxed);
+  total_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+}
+
+std::string LatencyHistogram::ToString() const {
+  auto micros = [](std::chrono::nanoseconds duration) { return duration.count() / 1000.0; };
+  uint64_t count = GetCount();
+  std::ostringstream os;
+  os << std::fixed << std::setprecision(1) << "count=" << count
+     << " avg=" << (count == 0 ? 0.0 : micros(GetTotal()) / count) << "us p50=" << micros(GetPercentile(0.5))
+     << "us p99=" << micros(GetPercentile(0.99)) << "us max=" << micros(GetMax()) << "us";
+  return os.str();
+}
+
+}  // namespace bustub
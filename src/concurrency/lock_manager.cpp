@@ -12,22 +12,39 @@
 
 #include "concurrency/lock_manager.h"
 
+#include <chrono>  // NOLINT
 #include <utility>
 #include <vector>
 
 namespace bustub {
 
+namespace {
+/** Adds the time until it goes out of scope to the transaction's lock wait time. */
+class LockWaitTimer {
+ public:
+  explicit LockWaitTimer(Transaction *txn) : txn_(txn), start_(std::chrono::steady_clock::now()) {}
+  ~LockWaitTimer() { txn_->AddLockWaitTime(std::chrono::steady_clock::now() - start_); }
+
+ private:
+  Transaction *txn_;
+  std::chrono::steady_clock::time_point start_;
+};
+}  // namespace
+
 bool LockManager::LockShared(Transaction *txn, const RID &rid) {
+  LockWaitTimer timer(txn);
   txn->GetSharedLockSet()->emplace(rid);
   return true;
 }
 
 bool LockManager::LockExclusive(Transaction *txn, const RID &rid) {
+  LockWaitTimer timer(txn);
   txn->GetExclusiveLockSet()->emplace(rid);
   return true;
 }
 
 bool LockManager::LockUpgrade(Transaction *txn, const RID &rid) {
+  LockWaitTimer timer(txn);
   txn->GetSharedLockSet()->erase(rid);
   txn->GetExclusiveLockSet()->emplace(rid);
   return true;
@@ -12,6 +12,10 @@
 
 #include "concurrency/transaction_manager.h"
 
+#include <chrono>  // NOLINT
+#include <iomanip>
+#include <sstream>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -31,10 +35,16 @@ Transaction *TransactionManager::Begin(Transaction *txn, IsolationLevel isolatio
   }
 
   txn_map[txn->GetTransactionId()] = txn;
+  lsn_t begin_lsn = AppendTransactionRecord(txn, LogRecordType::BEGIN);
+  {
+    std::lock_guard<std::mutex> guard(active_txns_latch_);
+    active_txns_[txn->GetTransactionId()] = {txn, begin_lsn};
+  }
   return txn;
 }
 
 void TransactionManager::Commit(Transaction *txn) {
+  auto start = std::chrono::steady_clock::now();
   txn->SetState(TransactionState::COMMITTED);
 
   // Perform all deletes before we commit.
@@ -49,11 +59,34 @@ void TransactionManager::Commit(Transaction *txn) {
     write_set->pop_back();
   }
   write_set->clear();
+  auto applied = std::chrono::steady_clock::now();
+
+  // A synchronous commit has its record on disk before the transaction's effects become visible to others. An
+  // asynchronous one leaves that to the flush thread and may be lost in a crash.
+  lsn_t commit_lsn = AppendTransactionRecord(txn, LogRecordType::COMMIT);
+  auto appended = std::chrono::steady_clock::now();
+  if (commit_lsn != INVALID_LSN && txn->IsSynchronousCommit()) {
+    log_manager_->Flush(commit_lsn);
+  }
+  auto flushed = std::chrono::steady_clock::now();
+
+  {
+    std::lock_guard<std::mutex> guard(active_txns_latch_);
+    active_txns_.erase(txn->GetTransactionId());
+  }
 
   // Release all the locks.
   ReleaseLocks(txn);
   // Release the global transaction latch.
   global_txn_latch_.RUnlock();
+  auto end = std::chrono::steady_clock::now();
+
+  commit_latency_[static_cast<size_t>(CommitStage::LOCK_WAIT)].Record(txn->GetLockWaitTime());
+  commit_latency_[static_cast<size_t>(CommitStage::APPLY_DELETE)].Record(applied - start);
+  commit_latency_[static_cast<size_t>(CommitStage::LOG_APPEND)].Record(appended - applied);
+  commit_latency_[static_cast<size_t>(CommitStage::FLUSH_WAIT)].Record(flushed - appended);
+  commit_latency_[static_cast<size_t>(CommitStage::RELEASE_LOCKS)].Record(end - flushed);
+  commit_latency_[static_cast<size_t>(CommitStage::TOTAL)].Record(end - start);
 }
 
 void TransactionManager::Abort(Transaction *txn) {
@@ -100,12 +133,105 @@ void TransactionManager::Abort(Transaction *txn) {
   table_write_set->clear();
   index_write_set->clear();
 
+  AppendTransactionRecord(txn, LogRecordType::ABORT);
+
+  {
+    std::lock_guard<std::mutex> guard(active_txns_latch_);
+    active_txns_.erase(txn->GetTransactionId());
+  }
+
   // Release all the locks.
   ReleaseLocks(txn);
   // Release the global transaction latch.
   global_txn_latch_.RUnlock();
 }
 
+std::vector<std::pair<txn_id_t, lsn_t>> TransactionManager::GetActiveTransactionTable() {
+  std::lock_guard<std::mutex> guard(active_txns_latch_);
+  std::vector<std::pair<txn_id_t, lsn_t>> active_txns;
+  active_txns.reserve(active_txns_.size());
+  for (auto &entry : active_txns_) {
+    active_txns.emplace_back(entry.first, entry.second.first->GetPrevLSN());
+  }
+  return active_txns;
+}
+
+lsn_t TransactionManager::GetOldestActiveLSN() {
+  std::lock_guard<std::mutex> guard(active_txns_latch_);
+  lsn_t oldest = INVALID_LSN;
+  for (auto &entry : active_txns_) {
+    lsn_t begin_lsn = entry.second.second;
+    if (begin_lsn != INVALID_LSN && (oldest == INVALID_LSN || begin_lsn < oldest)) {
+      oldest = begin_lsn;
+    }
+  }
+  return oldest;
+}
+
+const LatencyHistogram &TransactionManager::GetCommitLatency(CommitStage stage) {
+  if (stage == CommitStage::LOG_SYNC && log_manager_ != nullptr) {
+    return log_manager_->GetLogSyncLatency();
+  }
+  return commit_latency_[static_cast<size_t>(stage)];
+}
+
+void TransactionManager::ResetCommitLatency() {
+  for (auto &histogram : commit_latency_) {
+    histogram.Reset();
+  }
+  if (log_manager_ != nullptr) {
+    log_manager_->GetLogSyncLatency().Reset();
+  }
+}
+
+std::string TransactionManager::CommitLatencyToString() {
+  static constexpr std::array<std::pair<CommitStage, const char *>, 7> STAGES{{
+      {CommitStage::LOCK_WAIT, "lock wait"},
+      {CommitStage::APPLY_DELETE, "apply delete"},
+      {CommitStage::LOG_APPEND, "log append"},
+      {CommitStage::FLUSH_WAIT, "flush wait"},
+      {CommitStage::LOG_SYNC, "log sync"},
+      {CommitStage::RELEASE_LOCKS, "release locks"},
+      {CommitStage::TOTAL, "total"},
+  }};
+  std::ostringstream os;
+  for (auto &stage : STAGES) {
+    os << std::left << std::setw(14) << stage.second << GetCommitLatency(stage.first).ToString() << "\n";
+  }
+  return os.str();
+}
+
+void TransactionManager::RunCommitLatencyDump() {
+  std::lock_guard<std::mutex> guard(latency_dump_latch_);
+  if (latency_dump_running_) {
+    return;
+  }
+  latency_dump_running_ = true;
+  latency_dump_thread_ = new std::thread([this] {
+    std::unique_lock<std::mutex> lock(latency_dump_latch_);
+    while (latency_dump_running_) {
+      if (latency_dump_cv_.wait_for(lock, commit_latency_dump_interval, [this] { return !latency_dump_running_; })) {
+        break;
+      }
+      LOG_INFO("Commit latency:\n%s", CommitLatencyToString().c_str());
+    }
+  });
+}
+
+void TransactionManager::StopCommitLatencyDump() {
+  {
+    std::lock_guard<std::mutex> guard(latency_dump_latch_);
+    if (!latency_dump_running_) {
+      return;
+    }
+    latency_dump_running_ = false;
+    latency_dump_cv_.notify_one();
+  }
+  latency_dump_thread_->join();
+  delete latency_dump_thread_;
+  latency_dump_thread_ = nullptr;
+}
+
 void TransactionManager::BlockAllTransactions() { global_txn_latch_.WLock(); }
 
 void TransactionManager::ResumeTransactions() { global_txn_latch_.WUnlock(); }
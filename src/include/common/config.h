@@ -27,6 +27,15 @@ extern std::atomic<bool> enable_logging;
 /** If ENABLE_LOGGING is true, the log should be flushed to disk every LOG_TIMEOUT. */
 extern std::chrono::duration<int64_t> log_timeout;
 
+/** The background writer flushes the oldest dirty pages every BACKGROUND_WRITER_INTERVAL. */
+extern std::chrono::milliseconds background_writer_interval;
+
+/** TransactionManager::RunCommitLatencyDump() logs the commit latency breakdown every COMMIT_LATENCY_DUMP_INTERVAL. */
+extern std::chrono::milliseconds commit_latency_dump_interval;
+
+/** True if UPDATE log records should carry only the changed byte ranges of the tuple, false for full images. */
+extern std::atomic<bool> enable_delta_update_logging;
+
 static constexpr int INVALID_PAGE_ID = -1;                                    // invalid page id
 static constexpr int INVALID_TXN_ID = -1;                                     // invalid transaction id
 static constexpr int INVALID_LSN = -1;                                        // invalid log sequence number
@@ -34,6 +43,9 @@ static constexpr int HEADER_PAGE_ID = 0;                                      //
 static constexpr int PAGE_SIZE = 4096;                                        // size of a data page in byte
 static constexpr int BUFFER_POOL_SIZE = 10;                                   // size of buffer pool
 static constexpr int LOG_BUFFER_SIZE = ((BUFFER_POOL_SIZE + 1) * PAGE_SIZE);  // size of a log buffer in byte
+static constexpr int LOG_SEGMENT_SIZE = 16 * LOG_BUFFER_SIZE;                 // size of a log segment file in byte
+static constexpr int MAX_SPARE_LOG_SEGMENTS = 4;                              // recycled log segments kept for reuse
+static constexpr int LOG_READ_AHEAD_SIZE = 1 << 22;                           // bytes read at once when scanning the log
 static constexpr int BUCKET_SIZE = 50;                                        // size of extendible hash bucket
 
 using frame_id_t = int32_t;    // frame id type
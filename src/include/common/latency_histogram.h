@@ -0,0 +1,80 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// latency_histogram.h
+//
+// Identification: src/include/common/latency_histogram.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <string>
+
+#include "common/macros.h"
+
+namespace bustub {
+
+/**
+ * A histogram of durations with power-of-two buckets. Recording is lock-free, so the threads being measured do not
+ * serialize on it; a reader that runs concurrently may see a sample in the count but not yet in its bucket.
+ */
+class LatencyHistogram {
+ public:
+  /** Bucket 0 counts zero durations, bucket i > 0 the durations in [2^(i-1), 2^i) nanoseconds. */
+  static constexpr size_t NUM_BUCKETS = 48;
+
+  LatencyHistogram() = default;
+  DISALLOW_COPY_AND_MOVE(LatencyHistogram);
+
+  /** Records one duration, negative ones count as zero. */
+  void Record(std::chrono::nanoseconds duration) {
+    auto nanos = static_cast<uint64_t>(std::max<int64_t>(0, duration.count()));
+    size_t bucket = nanos == 0 ? 0 : std::min<size_t>(NUM_BUCKETS - 1, 64 - __builtin_clzll(nanos));
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    total_.fetch_add(nanos, std::memory_order_relaxed);
+    uint64_t max = max_.load(std::memory_order_relaxed);
+    while (nanos > max && !max_.compare_exchange_weak(max, nanos, std::memory_order_relaxed)) {
+    }
+  }
+
+  /** @return the number of recorded durations */
+  uint64_t GetCount() const { return count_.load(std::memory_order_relaxed); }
+
+  /** @return the sum of the recorded durations */
+  std::chrono::nanoseconds GetTotal() const {
+    return std::chrono::nanoseconds(total_.load(std::memory_order_relaxed));
+  }
+
+  /** @return the longest recorded duration */
+  std::chrono::nanoseconds GetMax() const { return std::chrono::nanoseconds(max_.load(std::memory_order_relaxed)); }
+
+  /**
+   * @param quantile between 0 and 1, e.g. 0.99 for the 99th percentile
+   * @return an upper bound of the quantile: the end of its bucket, capped by the maximum; zero if nothing was recorded
+   */
+  std::chrono::nanoseconds GetPercentile(double quantile) const;
+
+  /** Forgets every recorded duration. */
+  void Reset();
+
+  /** @return one line with the count, average, 50th and 99th percentile and maximum, in microseconds */
+  std::string ToString() const;
+
+ private:
+  std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> total_{0};
+  std::atomic<uint64_t> max_{0};
+};
+
+}  // namespace bustub
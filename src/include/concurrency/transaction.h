@@ -13,6 +13,7 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>  // NOLINT
 #include <deque>
 #include <memory>
 #include <string>
@@ -99,6 +100,16 @@ class IndexWriteRecord {
   Catalog *catalog_;
 };
 
+/**
+ * Concurrent index: the left link of leaf page_id goes from old_prev to new_prev, once the latches of the split or
+ * merge that calls for it are let go.
+ */
+struct LeafRelink {
+  page_id_t page_id;
+  page_id_t old_prev;
+  page_id_t new_prev;
+};
+
 /**
  * Reason to a transaction abortion
  */
@@ -162,6 +173,7 @@ class Transaction {
     page_set_ = std::make_shared<std::deque<bustub::Page *>>();
     release_page_set_ = std::make_shared<std::deque<bustub::Page *>>();
     deleted_page_set_ = std::make_shared<std::unordered_set<page_id_t>>();
+    leaf_relink_set_ = std::make_shared<std::deque<LeafRelink>>();
     tree_latch = false;
   }
 
@@ -225,6 +237,15 @@ class Transaction {
    */
   inline void AddIntoDeletedPageSet(page_id_t page_id) { deleted_page_set_->insert(page_id); }
 
+  /** @return the left links of leaves to set once the latches are let go */
+  inline std::shared_ptr<std::deque<LeafRelink>> GetLeafRelinkSet() { return leaf_relink_set_; }
+
+  /**
+   * Adds a left link to set once the latches are let go.
+   * @param relink the leaf and its old and new left link
+   */
+  inline void AddIntoLeafRelinkSet(const LeafRelink &relink) { leaf_relink_set_->push_back(relink); }
+
   /** @return the set of resources under a shared lock */
   inline std::shared_ptr<std::unordered_set<RID>> GetSharedLockSet() { return shared_lock_set_; }
 
@@ -255,6 +276,25 @@ class Transaction {
    */
   inline void SetPrevLSN(lsn_t prev_lsn) { prev_lsn_ = prev_lsn; }
 
+  /** @return true if Commit() waits until the commit record is on disk */
+  inline bool IsSynchronousCommit() { return synchronous_commit_; }
+
+  /**
+   * Chooses between synchronous and asynchronous commit. An asynchronous commit returns as soon as the commit record
+   * is in the log buffer; the next group flush or log_timeout makes it durable, so a crash can lose it.
+   * @param synchronous_commit false to commit asynchronously
+   */
+  inline void SetSynchronousCommit(bool synchronous_commit) { synchronous_commit_ = synchronous_commit; }
+
+  /** @return the total time this transaction has waited for tuple locks */
+  inline std::chrono::nanoseconds GetLockWaitTime() { return lock_wait_time_; }
+
+  /**
+   * Adds to the time this transaction has waited for tuple locks, called by the lock manager.
+   * @param wait_time the time one lock request took
+   */
+  inline void AddLockWaitTime(std::chrono::nanoseconds wait_time) { lock_wait_time_ += wait_time; }
+
   inline bool GetTreeLatch() { return tree_latch; }
   inline void SetTreeLatch(bool tl) { tree_latch = tl; }
   
@@ -274,6 +314,10 @@ class Transaction {
   std::shared_ptr<std::deque<IndexWriteRecord>> index_write_set_;
   /** The LSN of the last record written by the transaction. */
   lsn_t prev_lsn_;
+  /** Whether Commit() waits for the commit record to become durable. */
+  bool synchronous_commit_{true};
+  /** The time spent in lock requests so far. */
+  std::chrono::nanoseconds lock_wait_time_{0};
 
   /** Concurrent index: the pages that were latched during index operation. */
   std::shared_ptr<std::deque<Page *>> page_set_;
@@ -281,6 +325,8 @@ class Transaction {
   std::shared_ptr<std::deque<Page *>> release_page_set_;
   /** Concurrent index: the page IDs that were deleted during index operation.*/
   std::shared_ptr<std::unordered_set<page_id_t>> deleted_page_set_;
+  /** Concurrent index: the left links of leaves that splits and merges changed. */
+  std::shared_ptr<std::deque<LeafRelink>> leaf_relink_set_;
   /** The tree have tree latch or not. */
   bool tree_latch;
 
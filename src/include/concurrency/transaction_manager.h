@@ -12,11 +12,19 @@
 
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <condition_variable>  // NOLINT
+#include <mutex>               // NOLINT
+#include <string>
+#include <thread>  // NOLINT
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
+#include "common/latency_histogram.h"
 #include "concurrency/lock_manager.h"
 #include "concurrency/transaction.h"
 #include "recovery/log_manager.h"
@@ -24,6 +32,27 @@
 namespace bustub {
 class LockManager;
 
+/** The parts of TransactionManager::Commit() whose latencies are recorded separately. */
+enum class CommitStage {
+  /** The time the transaction waited for tuple locks over its whole lifetime. */
+  LOCK_WAIT = 0,
+  /** Applying the deletes in the write set. */
+  APPLY_DELETE,
+  /** Appending the commit record to the log buffer. */
+  LOG_APPEND,
+  /** Waiting until the commit record is on disk, which includes LOG_SYNC. Zero for an asynchronous commit. */
+  FLUSH_WAIT,
+  /** Releasing the locks. */
+  RELEASE_LOCKS,
+  /** All of Commit(). */
+  TOTAL,
+  /**
+   * One write and sync of the log. Recorded by the log manager per write instead of per transaction, since a group of
+   * commits shares a write.
+   */
+  LOG_SYNC,
+};
+
 /**
  * TransactionManager keeps track of all the transactions running in the system.
  */
@@ -32,7 +61,7 @@ class TransactionManager {
   explicit TransactionManager(LockManager *lock_manager, LogManager *log_manager = nullptr)
       : lock_manager_(lock_manager), log_manager_(log_manager) {}
 
-  ~TransactionManager() = default;
+  ~TransactionManager() { StopCommitLatencyDump(); }
 
   /**
    * Begins a new transaction.
@@ -73,6 +102,31 @@ class TransactionManager {
     return res;
   }
 
+  /**
+   * Takes a snapshot of the active transaction table for a fuzzy checkpoint.
+   * @return (txn id, last LSN) of every transaction that has neither committed nor aborted
+   */
+  std::vector<std::pair<txn_id_t, lsn_t>> GetActiveTransactionTable();
+
+  /** @return the BEGIN record LSN of the oldest active transaction, INVALID_LSN if there is none */
+  lsn_t GetOldestActiveLSN();
+
+  /**
+   * @param stage a part of the commit path
+   * @return the latencies recorded for stage since the start or the last ResetCommitLatency()
+   */
+  const LatencyHistogram &GetCommitLatency(CommitStage stage);
+
+  /** Forgets the recorded commit latencies. */
+  void ResetCommitLatency();
+
+  /** @return one line per commit stage with its count, average, percentiles and maximum */
+  std::string CommitLatencyToString();
+
+  /** Starts a thread that logs CommitLatencyToString() every commit_latency_dump_interval. */
+  void RunCommitLatencyDump();
+  void StopCommitLatencyDump();
+
   /** Prevents all transactions from performing operations, used for checkpointing. */
   void BlockAllTransactions();
 
@@ -84,6 +138,17 @@ class TransactionManager {
    * Releases all the locks held by the given transaction.
    * @param txn the transaction whose locks should be released
    */
+  /** Appends a BEGIN/COMMIT/ABORT record for txn if logging is enabled, returns its LSN or INVALID_LSN. */
+  lsn_t AppendTransactionRecord(Transaction *txn, LogRecordType log_record_type) {
+    if (!enable_logging || log_manager_ == nullptr) {
+      return INVALID_LSN;
+    }
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), log_record_type);
+    lsn_t lsn = log_manager_->AppendLogRecord(&log_record);
+    txn->SetPrevLSN(lsn);
+    return lsn;
+  }
+
   void ReleaseLocks(Transaction *txn) {
     std::unordered_set<RID> lock_set;
     for (auto item : *txn->GetExclusiveLockSet()) {
@@ -99,10 +164,21 @@ class TransactionManager {
 
   std::atomic<txn_id_t> next_txn_id_{0};
   LockManager *lock_manager_ __attribute__((__unused__));
-  LogManager *log_manager_ __attribute__((__unused__));
+  LogManager *log_manager_;
+
+  /** Transactions that have begun but not yet committed or aborted, for the checkpoint's active transaction table. */
+  std::unordered_map<txn_id_t, std::pair<Transaction *, lsn_t>> active_txns_;
+  std::mutex active_txns_latch_;
 
   /** The global transaction latch is used for checkpointing. */
   ReaderWriterLatch global_txn_latch_;
+
+  /** One histogram per CommitStage; the LOG_SYNC one is only used without a log manager. */
+  std::array<LatencyHistogram, static_cast<size_t>(CommitStage::LOG_SYNC) + 1> commit_latency_;
+  std::thread *latency_dump_thread_{nullptr};
+  bool latency_dump_running_{false};
+  std::mutex latency_dump_latch_;
+  std::condition_variable latency_dump_cv_;
 };
 
 }  // namespace bustub
@@ -12,6 +12,12 @@
 
 #pragma once
 
+#include <condition_variable>  // NOLINT
+#include <mutex>               // NOLINT
+#include <thread>              // NOLINT
+#include <utility>
+#include <vector>
+
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/transaction_manager.h"
 #include "recovery/log_manager.h"
@@ -19,7 +25,12 @@
 namespace bustub {
 
 /**
- * CheckpointManager creates consistent checkpoints by blocking all other transactions temporarily.
+ * CheckpointManager takes fuzzy (ARIES-style) checkpoints. Transactions keep running while a checkpoint is taken:
+ * BeginCheckpoint() logs a BEGINCHECKPOINT record and snapshots the active transaction table and the dirty page table,
+ * EndCheckpoint() logs them in an ENDCHECKPOINT record and forces the log. No page is written as part of the
+ * checkpoint; instead the background writer keeps flushing the dirty pages with the oldest recLSNs, which moves the
+ * point where redo has to start forward. Once the checkpoint is complete, the log segments in front of both the redo
+ * point and the oldest active transaction are recycled.
  */
 class CheckpointManager {
  public:
@@ -29,15 +40,37 @@ class CheckpointManager {
         log_manager_(log_manager),
         buffer_pool_manager_(buffer_pool_manager) {}
 
-  ~CheckpointManager() = default;
+  ~CheckpointManager() { StopBackgroundWriter(); }
 
   void BeginCheckpoint();
   void EndCheckpoint();
 
+  /** @return the LSN of the BEGINCHECKPOINT record of the last completed checkpoint, or INVALID_LSN */
+  inline lsn_t GetLastCheckpointLSN() { return last_checkpoint_lsn_; }
+
+  /**
+   * Starts a thread that writes out up to pages_per_round dirty pages, oldest recLSN first, every
+   * background_writer_interval.
+   */
+  void RunBackgroundWriter(size_t pages_per_round);
+  void StopBackgroundWriter();
+
  private:
-  TransactionManager *transaction_manager_ __attribute__((__unused__));
-  LogManager *log_manager_ __attribute__((__unused__));
-  BufferPoolManager *buffer_pool_manager_ __attribute__((__unused__));
+  TransactionManager *transaction_manager_;
+  LogManager *log_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+
+  /** The checkpoint in progress: its BEGINCHECKPOINT LSN and the tables snapshotted after it. */
+  lsn_t begin_checkpoint_lsn_{INVALID_LSN};
+  std::vector<std::pair<txn_id_t, lsn_t>> active_txns_;
+  std::vector<std::pair<page_id_t, lsn_t>> dirty_pages_;
+  lsn_t oldest_active_lsn_{INVALID_LSN};
+  lsn_t last_checkpoint_lsn_{INVALID_LSN};
+
+  std::thread *background_writer_{nullptr};
+  bool background_writer_running_{false};
+  std::mutex latch_;
+  std::condition_variable cv_;
 };
 
 }  // namespace bustub
@@ -13,10 +13,16 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <condition_variable>  // NOLINT
+#include <deque>
 #include <future>              // NOLINT
+#include <memory>
 #include <mutex>               // NOLINT
+#include <thread>              // NOLINT
+#include <utility>
 
+#include "common/latency_histogram.h"
 #include "recovery/log_record.h"
 #include "storage/disk/disk_manager.h"
 
@@ -25,50 +31,137 @@ namespace bustub {
 /**
  * LogManager maintains a separate thread that is awakened whenever the log buffer is full or whenever a timeout
  * happens. When the thread is awakened, the log buffer's content is written into the disk log file.
+ *
+ * Appending does not take a latch. A writer reserves its LSN and its byte range in one of the two log buffers with a
+ * single compare-and-swap on reserve_state_, serializes its record into that range in parallel with the other writers,
+ * and then marks its LSN complete in completion_ring_. The flush thread walks the ring in LSN order and writes out
+ * only the contiguous completed prefix, so a slow writer delays the records behind it but not the ones in front.
+ * When the active buffer is full the flush thread switches reservations over to the other buffer; the old buffer is
+ * reused only after all of its records have reached the disk.
  */
 class LogManager {
  public:
   explicit LogManager(DiskManager *disk_manager)
-      : next_lsn_(0), persistent_lsn_(INVALID_LSN), disk_manager_(disk_manager) {
-    log_buffer_ = new char[LOG_BUFFER_SIZE];
-    flush_buffer_ = new char[LOG_BUFFER_SIZE];
+      : persistent_lsn_(INVALID_LSN),
+        completion_ring_(new std::atomic<uint64_t>[COMPLETION_RING_SIZE]),
+        disk_manager_(disk_manager) {
+    log_buffers_[0] = new char[LOG_BUFFER_SIZE];
+    log_buffers_[1] = new char[LOG_BUFFER_SIZE];
+    for (size_t i = 0; i < COMPLETION_RING_SIZE; i++) {
+      completion_ring_[i].store(PackState(INVALID_LSN, 0, 0));
+    }
   }
 
   ~LogManager() {
-    delete[] log_buffer_;
-    delete[] flush_buffer_;
-    log_buffer_ = nullptr;
-    flush_buffer_ = nullptr;
+    delete[] log_buffers_[0];
+    delete[] log_buffers_[1];
+    log_buffers_[0] = nullptr;
+    log_buffers_[1] = nullptr;
   }
 
   void RunFlushThread();
   void StopFlushThread();
 
+  /**
+   * Reserves space for the record, assigns its LSN and serializes it into the log buffer.
+   * @param log_record the record to append; its lsn_ is set by this call
+   * @return the LSN assigned to the record
+   * @throws Exception if the record is larger than the log buffer
+   */
   lsn_t AppendLogRecord(LogRecord *log_record);
 
-  inline lsn_t GetNextLSN() { return next_lsn_; }
+  /**
+   * Blocks until every log record up to and including lsn is on disk. Concurrent callers are satisfied by the same
+   * flush (group commit).
+   * @param lsn the log sequence number that must become persistent
+   */
+  void Flush(lsn_t lsn);
+
+  /**
+   * Lets the disk manager recycle the log segments that only hold records older than lsn. Only segments written by
+   * this log manager are tracked, older ones go away with the first truncation.
+   * @param lsn the oldest record that recovery may still need
+   */
+  void TruncateLog(lsn_t lsn);
+
+  inline lsn_t GetNextLSN() { return StateLSN(reserve_state_.load()); }
   inline lsn_t GetPersistentLSN() { return persistent_lsn_; }
   inline void SetPersistentLSN(lsn_t lsn) { persistent_lsn_ = lsn; }
-  inline char *GetLogBuffer() { return log_buffer_; }
+  /** @return the total number of bytes that DELTAUPDATE records saved over full-image UPDATE records */
+  inline uint64_t GetDeltaBytesSaved() { return delta_bytes_saved_; }
+  /** @return how long each write of the log to disk took, including the sync */
+  inline LatencyHistogram &GetLogSyncLatency() { return log_sync_latency_; }
+  inline char *GetLogBuffer() { return log_buffers_[StateBuffer(reserve_state_.load())]; }
 
  private:
-  // TODO(students): you may add your own member variables
+  /**
+   * Every LSN that is reserved but not yet on disk lives in one of the two buffers, and each record takes at least
+   * HEADER_SIZE bytes, so a ring of this size never wraps onto an LSN the flush thread still has to look at.
+   */
+  static constexpr size_t COMPLETION_RING_SIZE = 2 * LOG_BUFFER_SIZE / LogRecord::HEADER_SIZE + 1;
+  static constexpr uint32_t BUFFER_BIT = 1U << 31;
+
+  /** reserve_state_ and the ring entries share one layout: LSN (high 32 bits), buffer index (bit 31), offset. */
+  static inline uint64_t PackState(lsn_t lsn, uint32_t buffer, uint32_t offset) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(lsn)) << 32) | (buffer != 0 ? BUFFER_BIT : 0) | offset;
+  }
+  static inline lsn_t StateLSN(uint64_t state) { return static_cast<lsn_t>(state >> 32); }
+  static inline uint32_t StateBuffer(uint64_t state) {
+    return (static_cast<uint32_t>(state) & BUFFER_BIT) != 0 ? 1 : 0;
+  }
+  static inline uint32_t StateOffset(uint64_t state) { return static_cast<uint32_t>(state) & (BUFFER_BIT - 1); }
+
+  /**
+   * Writes out the completed prefix of the log. If switch_buffer is set and the active buffer is not empty, new
+   * reservations are moved to the other buffer as well. Only one flush runs at a time.
+   */
+  void FlushLogBuffer(bool switch_buffer);
+
+  /** Writes every completed record that follows flush_lsn_ to disk. Caller holds flush_latch_. */
+  void WriteCompletedPrefix();
+
+  /** Writes [flush_offset_, end) of the flush buffer, whose first record is first_lsn. Caller holds flush_latch_. */
+  void WriteLogRange(uint32_t end, lsn_t first_lsn);
 
-  /** The atomic counter which records the next log sequence number. */
-  std::atomic<lsn_t> next_lsn_;
   /** The log records before and including the persistent lsn have been written to disk. */
   std::atomic<lsn_t> persistent_lsn_;
 
-  char *log_buffer_;
-  char *flush_buffer_;
+  /** The next LSN, the buffer new records go to, and the next free offset in that buffer. */
+  std::atomic<uint64_t> reserve_state_{0};
+  /** Slot lsn % COMPLETION_RING_SIZE holds (lsn, buffer, end offset) once record lsn is fully serialized. */
+  std::unique_ptr<std::atomic<uint64_t>[]> completion_ring_;
 
+  char *log_buffers_[2];
+
+  std::atomic<uint64_t> delta_bytes_saved_{0};
+  LatencyHistogram log_sync_latency_;
+
+  /** Flush progress, protected by flush_latch_: first LSN not on disk, and where it starts. */
+  lsn_t flush_lsn_{0};
+  uint32_t flush_buffer_{0};
+  uint32_t flush_offset_{0};
+  /** The first LSN and log offset of every segment written so far, oldest first. Protected by flush_latch_. */
+  std::deque<std::pair<lsn_t, int64_t>> segment_starts_;
+
+  /** Protects the condition variables below and the flush request flags. */
   std::mutex latch_;
+  /** Serializes FlushLogBuffer(), since the flush progress above is only touched by one flusher. */
+  std::mutex flush_latch_;
 
-  std::thread *flush_thread_ __attribute__((__unused__));
+  std::thread *flush_thread_{nullptr};
 
+  /** Wakes up the flush thread. */
   std::condition_variable cv_;
+  /** Wakes up writers that are waiting for room in the log buffer. */
+  std::condition_variable append_cv_;
+  /** Wakes up threads that are waiting for their records to become persistent. */
+  std::condition_variable flush_cv_;
+
+  bool flush_requested_{false};
+  bool switch_requested_{false};
+  bool flush_thread_running_{false};
 
-  DiskManager *disk_manager_ __attribute__((__unused__));
+  DiskManager *disk_manager_;
 };
 
 }  // namespace bustub
@@ -0,0 +1,94 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_reader.h
+//
+// Identification: src/include/recovery/log_reader.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <future>  // NOLINT
+#include <memory>
+
+#include "recovery/log_record.h"
+#include "storage/disk/disk_manager.h"
+
+namespace bustub {
+
+/**
+ * LogReader reads the log for recovery in large chunks instead of one log buffer at a time.
+ *
+ * The sequential scan uses two chunk buffers: while records are decoded from one of them, the next chunk is read into
+ * the other in the background. A record that straddles two chunks is decoded after its head is copied in front of the
+ * next chunk, so every record is contiguous in memory. Segment end markers are skipped transparently.
+ *
+ * ReadAt() serves the backward walk along prevLSN chains during undo. It loads a window that ends just after the
+ * requested record, so the earlier records of the same transaction are usually already in memory.
+ */
+class LogReader {
+ public:
+  /**
+   * @param disk_manager the log to read
+   * @param read_ahead_size the size of each read, at least LOG_BUFFER_SIZE
+   */
+  explicit LogReader(DiskManager *disk_manager, int read_ahead_size = LOG_READ_AHEAD_SIZE);
+
+  ~LogReader();
+
+  /** Moves the sequential scan to offset, which has to be the start of a record or of a segment. */
+  void Seek(int64_t offset);
+
+  /**
+   * Decodes the next record of the sequential scan, which starts at the beginning of the log unless Seek() was called.
+   * @param[out] log_record the record, its tuples point into the reader's buffer until the next call
+   * @param[out] data the serialized record, valid until the next call
+   * @param[out] offset the log offset of the record
+   * @return false at the end of the log
+   */
+  bool Next(LogRecord *log_record, const char **data, int64_t *offset);
+
+  /**
+   * Decodes the record at offset, independently of the sequential scan.
+   * @param offset the log offset of the record
+   * @param[out] log_record the record, its tuples point into the reader's buffer until the next call
+   * @return false if there is no complete record at offset
+   */
+  bool ReadAt(int64_t offset, LogRecord *log_record);
+
+ private:
+  /** Loads the chunk at chunk_offset_ into the current buffer and starts reading the one after it. */
+  bool LoadChunk();
+  /** Makes the prefetched chunk current, keeping the bytes from pos_ on in front of it. */
+  bool AdvanceChunk();
+  void StartPrefetch();
+  void CancelPrefetch();
+
+  DiskManager *disk_manager_;
+  const int read_ahead_size_;
+  const int segment_size_;
+
+  /**
+   * Each buffer has LOG_BUFFER_SIZE bytes of room for the head of a straddling record, followed by the chunk. pos_ and
+   * end_ index into buffers_[current_]; chunk_offset_ is the log offset of the byte at index LOG_BUFFER_SIZE.
+   */
+  std::unique_ptr<char[]> buffers_[2];
+  int current_{0};
+  int pos_{0};
+  int end_{0};
+  int64_t chunk_offset_{0};
+  bool loaded_{false};
+  /** Reads the chunk after the current one into the other buffer; its result is false beyond the end of the log. */
+  std::future<bool> prefetch_;
+
+  /** The random access window of ReadAt(). */
+  std::unique_ptr<char[]> window_;
+  int64_t window_offset_{0};
+  int window_size_{0};
+};
+
+}  // namespace bustub
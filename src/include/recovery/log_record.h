@@ -14,6 +14,8 @@
 
 #include <cassert>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
 #include "storage/table/tuple.h"
@@ -32,6 +34,20 @@ enum class LogRecordType {
   ABORT,
   /** Creating a new page in the table heap. */
   NEWPAGE,
+  /** An update that only logs the byte ranges in which the old and new tuple differ. */
+  DELTAUPDATE,
+  /** The start of a fuzzy checkpoint. */
+  BEGINCHECKPOINT,
+  /** The end of a fuzzy checkpoint, carrying the active transaction table and the dirty page table. */
+  ENDCHECKPOINT,
+  /** Inserting an entry into a B+ tree page; the entries behind it move up by one. */
+  BTREEINSERT,
+  /** Removing an entry from a B+ tree page; the entries behind it move down by one. */
+  BTREEDELETE,
+  /** Overwriting a byte range of a B+ tree page, e.g. with the image of a page that a split or merge rebuilt. */
+  BTREEPAGE,
+  /** Setting the root page id of a B+ tree in the header page. */
+  BTREEROOT,
 };
 
 /**
@@ -53,16 +69,43 @@ enum class LogRecordType {
  *-----------------------------------------------------------------------------------
  * | HEADER | tuple_rid | tuple_size | old_tuple_data | tuple_size | new_tuple_data |
  *-----------------------------------------------------------------------------------
+ * For delta update type log record, offsets are positions in the old tuple and ranges are in ascending order
+ *------------------------------------------------------------------------------------------------
+ * | HEADER | tuple_rid | old_size | new_size | range_count | range_1 | ... | range_n |
+ *------------------------------------------------------------------------------------------------
+ * where each range is
+ *------------------------------------------------------------------
+ * | offset | old_length | new_length | old_bytes | new_bytes |
+ *------------------------------------------------------------------
+ * For end checkpoint type log record, prevLSN holds the LSN of the matching begin checkpoint record
+ *-------------------------------------------------------------------------------------------------
+ * | HEADER | txn_count | (txn_id, last_lsn) * txn_count | page_count | (page_id, rec_lsn) * page_count |
+ *-------------------------------------------------------------------------------------------------
  * For new page type log record
- *--------------------------
- * | HEADER | prev_page_id |
- *--------------------------
+ *-------------------------------------
+ * | HEADER | prev_page_id | page_id |
+ *-------------------------------------
+ * For B+ tree type log records (btreeinsert, btreedelete, btreepage, btreeroot)
+ *------------------------------------------------------------
+ * | HEADER | page_id | offset | index | length | bytes(char[] array) |
+ *------------------------------------------------------------
+ * An insert or delete shifts the entry at index within the entry array that starts at offset; bytes is the entry, and
+ * length the entry size. A page record copies bytes to offset, index is unused. A root record sets page_id as the root
+ * of the index whose name is in bytes. B+ tree records are redo-only: they belong to no transaction and are never
+ * undone, a structure modification stays in place even if the transaction that caused it aborts.
+ *
+ * A log record never copies tuple data. The constructors keep views of the caller's tuples, so the tuples must stay
+ * alive until AppendLogRecord() returns; SerializeTo() then copies the bytes straight into the log buffer. Likewise,
+ * DeserializeFrom() leaves the tuples pointing into the buffer that the record was read from.
  */
 class LogRecord {
   friend class LogManager;
   friend class LogRecovery;
 
  public:
+  /** The size of the fields every log record starts with. */
+  static constexpr int HEADER_SIZE = 20;
+
   LogRecord() = default;
 
   // constructor for Transaction type(BEGIN/COMMIT/ABORT)
@@ -74,28 +117,44 @@ class LogRecord {
       : txn_id_(txn_id), prev_lsn_(prev_lsn), log_record_type_(log_record_type) {
     if (log_record_type == LogRecordType::INSERT) {
       insert_rid_ = rid;
-      insert_tuple_ = tuple;
+      insert_tuple_ = tuple.AsView();
     } else {
       assert(log_record_type == LogRecordType::APPLYDELETE || log_record_type == LogRecordType::MARKDELETE ||
              log_record_type == LogRecordType::ROLLBACKDELETE);
       delete_rid_ = rid;
-      delete_tuple_ = tuple;
+      delete_tuple_ = tuple.AsView();
     }
     // calculate log record size
     size_ = HEADER_SIZE + sizeof(RID) + sizeof(int32_t) + tuple.GetLength();
   }
 
-  // constructor for UPDATE type
+  // constructor for UPDATE/DELTAUPDATE type, DELTAUPDATE falls back to UPDATE if the delta is not smaller
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, const RID &update_rid,
             const Tuple &old_tuple, const Tuple &new_tuple)
       : txn_id_(txn_id),
         prev_lsn_(prev_lsn),
         log_record_type_(log_record_type),
         update_rid_(update_rid),
-        old_tuple_(old_tuple),
-        new_tuple_(new_tuple) {
+        old_tuple_(old_tuple.AsView()),
+        new_tuple_(new_tuple.AsView()) {
     // calculate log record size
     size_ = HEADER_SIZE + sizeof(RID) + old_tuple.GetLength() + new_tuple.GetLength() + 2 * sizeof(int32_t);
+    if (log_record_type == LogRecordType::DELTAUPDATE) {
+      ComputeDelta();
+    } else {
+      assert(log_record_type == LogRecordType::UPDATE);
+    }
+  }
+
+  // constructor for ENDCHECKPOINT type
+  LogRecord(lsn_t begin_checkpoint_lsn, std::vector<std::pair<txn_id_t, lsn_t>> active_txns,
+            std::vector<std::pair<page_id_t, lsn_t>> dirty_pages)
+      : prev_lsn_(begin_checkpoint_lsn),
+        log_record_type_(LogRecordType::ENDCHECKPOINT),
+        active_txns_(std::move(active_txns)),
+        dirty_pages_(std::move(dirty_pages)) {
+    size_ = HEADER_SIZE + 2 * sizeof(uint32_t) + active_txns_.size() * sizeof(std::pair<txn_id_t, lsn_t>) +
+            dirty_pages_.size() * sizeof(std::pair<page_id_t, lsn_t>);
   }
 
   // constructor for NEWPAGE type
@@ -110,8 +169,52 @@ class LogRecord {
     size_ = HEADER_SIZE + sizeof(page_id_t) * 2;
   }
 
+  // constructor for BTREEINSERT/BTREEDELETE/BTREEPAGE/BTREEROOT type
+  LogRecord(LogRecordType log_record_type, page_id_t page_id, uint32_t offset, uint32_t index, const char *bytes,
+            uint32_t length)
+      : log_record_type_(log_record_type),
+        btree_page_id_(page_id),
+        btree_offset_(offset),
+        btree_index_(index),
+        btree_length_(length),
+        btree_bytes_(bytes) {
+    assert(log_record_type == LogRecordType::BTREEINSERT || log_record_type == LogRecordType::BTREEDELETE ||
+           log_record_type == LogRecordType::BTREEPAGE || log_record_type == LogRecordType::BTREEROOT);
+    size_ = HEADER_SIZE + sizeof(page_id_t) + 3 * sizeof(uint32_t) + length;
+  }
+
   ~LogRecord() = default;
 
+  /**
+   * Writes the record into dest, which must have room for GetSize() bytes.
+   * @param dest the reserved space in the log buffer
+   */
+  void SerializeTo(char *dest) const;
+
+  /**
+   * Reads a record from src without copying any tuple data.
+   * @param src the start of the serialized record
+   * @param available the number of readable bytes at src
+   * @return false if src does not hold a complete record
+   */
+  bool DeserializeFrom(const char *src, int available);
+
+  /**
+   * Rebuilds one side of a DELTAUPDATE from the other.
+   * @param image the current tuple image: the old tuple when redoing, the new tuple when undoing
+   * @param redo true to produce the new tuple, false to produce the old one
+   * @return the reconstructed tuple
+   */
+  Tuple ApplyDelta(const Tuple &image, bool redo) const;
+
+  /** @return how many bytes this record saves over logging both full tuple images, 0 unless it is a DELTAUPDATE */
+  inline int32_t GetDeltaBytesSaved() const {
+    if (log_record_type_ != LogRecordType::DELTAUPDATE) {
+      return 0;
+    }
+    return HEADER_SIZE + sizeof(RID) + 2 * sizeof(int32_t) + delta_old_size_ + delta_new_size_ - size_;
+  }
+
   inline Tuple &GetDeleteTuple() { return delete_tuple_; }
 
   inline RID &GetDeleteRID() { return delete_rid_; }
@@ -128,6 +231,22 @@ class LogRecord {
 
   inline page_id_t GetNewPageRecord() { return prev_page_id_; }
 
+  inline page_id_t GetNewPageId() { return page_id_; }
+
+  inline page_id_t GetBTreePageId() { return btree_page_id_; }
+
+  inline uint32_t GetBTreeOffset() { return btree_offset_; }
+
+  inline uint32_t GetBTreeIndex() { return btree_index_; }
+
+  inline uint32_t GetBTreeLength() { return btree_length_; }
+
+  inline const char *GetBTreeBytes() { return btree_bytes_; }
+
+  inline std::vector<std::pair<txn_id_t, lsn_t>> &GetActiveTransactions() { return active_txns_; }
+
+  inline std::vector<std::pair<page_id_t, lsn_t>> &GetDirtyPages() { return dirty_pages_; }
+
   inline int32_t GetSize() { return size_; }
 
   inline lsn_t GetLSN() { return lsn_; }
@@ -173,10 +292,34 @@ class LogRecord {
   Tuple old_tuple_;
   Tuple new_tuple_;
 
+  // case3': for delta update operation, the bytes point into the tuples or into the buffer the record was read from
+  struct DeltaRange {
+    uint32_t offset_;
+    uint32_t old_length_;
+    uint32_t new_length_;
+    const char *old_bytes_;
+    const char *new_bytes_;
+  };
+  /** Fills delta_ranges_ from old_tuple_ and new_tuple_ and recomputes size_. */
+  void ComputeDelta();
+  uint32_t delta_old_size_{0};
+  uint32_t delta_new_size_{0};
+  std::vector<DeltaRange> delta_ranges_;
+
+  // case5: for end checkpoint, the active transaction table (txn id, last LSN) and dirty page table (page, recLSN)
+  std::vector<std::pair<txn_id_t, lsn_t>> active_txns_;
+  std::vector<std::pair<page_id_t, lsn_t>> dirty_pages_;
+
   // case4: for new page operation
   page_id_t prev_page_id_{INVALID_PAGE_ID};
   page_id_t page_id_{INVALID_PAGE_ID};
-  static const int HEADER_SIZE = 20;
+
+  // case6: for B+ tree operations, the bytes point into the caller's page or into the buffer the record was read from
+  page_id_t btree_page_id_{INVALID_PAGE_ID};
+  uint32_t btree_offset_{0};
+  uint32_t btree_index_{0};
+  uint32_t btree_length_{0};
+  const char *btree_bytes_{nullptr};
 };  // namespace bustub
 
 }  // namespace bustub
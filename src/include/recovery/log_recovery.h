@@ -13,45 +13,119 @@
 #pragma once
 
 #include <algorithm>
-#include <mutex>  // NOLINT
+#include <functional>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
 #include <unordered_map>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/lock_manager.h"
+#include "concurrency/transaction.h"
+#include "recovery/log_reader.h"
 #include "recovery/log_record.h"
+#include "storage/page/table_page.h"
 
 namespace bustub {
 
 /**
  * Read log file from disk, redo and undo.
+ *
+ * Redo reads the log once. While reading it builds the active transaction table and the LSN to offset mapping, and
+ * it hands every page-level record to the worker that owns the page (page id modulo the number of workers). Each
+ * worker replays its pages in LSN order, so the per-page order is kept while different pages are replayed in parallel.
+ * Undo rolls back the loser transactions concurrently, one transaction per worker at a time; they cannot conflict on
+ * a tuple because they held exclusive locks on everything they wrote. B+ tree records are replayed like any other page
+ * record but never undone.
+ *
+ * Instant restart is the alternative to Redo followed by Undo. It indexes the records by page and then replays a page
+ * only when it is first read into the buffer pool, so the database can serve queries before every page is recovered. A
+ * background thread recovers the pages nobody asked for.
  */
 class LogRecovery {
  public:
-  LogRecovery(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager)
-      : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager), offset_(0) {
-    log_buffer_ = new char[LOG_BUFFER_SIZE];
+  /**
+   * @param num_workers the number of redo/undo threads, 0 for one per hardware thread. It is capped by the buffer pool
+   * size since each worker keeps a page pinned.
+   */
+  LogRecovery(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, size_t num_workers = 0)
+      : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager) {
+    if (num_workers == 0) {
+      num_workers = std::thread::hardware_concurrency();
+    }
+    num_workers_ = std::max<size_t>(1, std::min(num_workers, buffer_pool_manager->GetPoolSize() / 2));
   }
 
   ~LogRecovery() {
-    delete[] log_buffer_;
-    log_buffer_ = nullptr;
+    if (background_recovery_ != nullptr) {
+      FinishInstantRestart();
+    }
   }
 
   void Redo();
   void Undo();
-  bool DeserializeLogRecord(const char *data, LogRecord *log_record);
+  bool DeserializeLogRecord(const char *data, int size, LogRecord *log_record);
+
+  /**
+   * Analyzes the log, installs on-demand redo in the buffer pool, rolls back the losers and starts recovering the
+   * remaining pages in the background. Afterwards every page that is fetched is up to date. None of the logged pages
+   * may be in the buffer pool yet.
+   */
+  void StartInstantRestart();
+  /** Waits until every page has been recovered and removes the buffer pool hook. */
+  void FinishInstantRestart();
+  /** @return the number of pages that still have records to replay */
+  size_t GetPendingPageCount();
 
  private:
-  DiskManager *disk_manager_ __attribute__((__unused__));
-  BufferPoolManager *buffer_pool_manager_ __attribute__((__unused__));
+  /** @return the page a page-level record modifies, or INVALID_PAGE_ID for transaction and checkpoint records */
+  static page_id_t GetRecordPageId(LogRecord *log_record);
+
+  /**
+   * Scans the whole log, builds active_txn_ and lsn_mapping_ and sets redo_lsn_.
+   * @param dispatch called for every page a record modifies, with the serialized record; a new page record is passed
+   * for both the new page and its predecessor
+   */
+  void Analyze(const std::function<void(page_id_t, const char *, int)> &dispatch);
+
+  /** Replays the records of one partition, each of them prefixed with the page id it is replayed on. */
+  void RedoPartition(const std::vector<char> &records, Transaction *txn);
+  /**
+   * Replays one record on a page the caller holds the write latch on. The page LSN decides whether it is needed.
+   * @return true if the page was changed
+   */
+  bool RedoOnPage(LogRecord *log_record, TablePage *page, page_id_t page_id, Transaction *txn);
+  /** Applies a B+ tree insert, delete or page record to the page data; the page LSN has been checked already. */
+  static void RedoBTreeRecord(LogRecord *log_record, char *data);
+
+  /** Buffer pool hook for instant restart: replays the pending records of a page that was just read from disk. */
+  bool RecoverPage(Page *page);
+  /** Removes and returns the pending records of a page. */
+  std::vector<char> TakePendingRecords(page_id_t page_id);
+  /** Replays the serialized records of one page that is write-latched by the caller. */
+  bool RedoPendingRecords(const std::vector<char> &records, TablePage *page, page_id_t page_id);
+  /** Body of the instant restart background thread. */
+  void RecoverRemainingPages();
+
+  /** Rolls back one loser transaction by following its prevLSN chain. */
+  void UndoTransaction(lsn_t last_lsn, LogReader *reader, Transaction *txn);
+  void UndoLogRecord(LogRecord *log_record, Transaction *txn);
+
+  DiskManager *disk_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+  size_t num_workers_;
 
   /** Maintain active transactions and its corresponding latest lsn. */
   std::unordered_map<txn_id_t, lsn_t> active_txn_;
   /** Mapping the log sequence number to log file offset for undos. */
-  std::unordered_map<lsn_t, int> lsn_mapping_;
+  std::unordered_map<lsn_t, int64_t> lsn_mapping_;
+  /** Records older than this are already reflected in the data pages. */
+  lsn_t redo_lsn_{0};
 
-  int offset_ __attribute__((__unused__));
-  char *log_buffer_;
+  /** Serialized records that still have to be replayed, per page, during instant restart. */
+  std::unordered_map<page_id_t, std::vector<char>> pending_pages_;
+  std::mutex pending_latch_;
+  std::thread *background_recovery_{nullptr};
 };
 
 }  // namespace bustub
@@ -15,7 +15,9 @@
 #include <atomic>
 #include <fstream>
 #include <future>  // NOLINT
+#include <mutex>   // NOLINT
 #include <string>
+#include <unordered_set>
 
 #include "common/config.h"
 
@@ -24,14 +26,25 @@ namespace bustub {
 /**
  * DiskManager takes care of the allocation and deallocation of pages within a database. It performs the reading and
  * writing of pages to and from disk, providing a logical file layer within the context of a database management system.
+ *
+ * The log is a sequence of fixed-size segment files (<name>.log.000000, <name>.log.000001, ...) that together form one
+ * logical address space: offset = segment number * segment size + position in the segment. Each write is kept in one
+ * segment, so a segment always starts with a record. A zero length word marks the end of the log, and LOG_SEGMENT_END
+ * marks that the log continues in the next segment. <name>.log itself is a small control file with the segment size,
+ * the first segment that is still needed and where the log ended at the last shutdown. Segments that a checkpoint no
+ * longer needs are renamed to future segment numbers and overwritten later instead of being deleted.
  */
 class DiskManager {
  public:
+  /** Length word that tells a log reader to continue at the start of the next segment. */
+  static constexpr int32_t LOG_SEGMENT_END = -1;
+
   /**
    * Creates a new disk manager that writes to the specified database file.
    * @param db_file the file name of the database file to write to
+   * @param log_segment_size size of a new log's segment files; an existing log keeps its own
    */
-  explicit DiskManager(const std::string &db_file);
+  explicit DiskManager(const std::string &db_file, int log_segment_size = LOG_SEGMENT_SIZE);
 
   ~DiskManager() = default;
 
@@ -56,19 +69,38 @@ class DiskManager {
 
   /**
    * Flush the entire log buffer into disk.
-   * @param log_data raw log data
-   * @param size size of log entry
+   * @param log_data raw log data, made of whole records
+   * @param size size of log entry, at most the segment size
+   * @return the log offset the data was written to; it starts a new segment if it does not fit into the current one
    */
-  void WriteLog(char *log_data, int size);
+  int64_t WriteLog(char *log_data, int size);
 
   /**
-   * Read a log entry from the log file.
+   * Read a log entry from the log file. The part of the range beyond the end of the log is filled with zeros.
    * @param[out] log_data output buffer
    * @param size size of the log entry
-   * @param offset offset of the log entry in the file
-   * @return true if the read was successful, false otherwise
+   * @param offset offset of the log entry in the log
+   * @return true if the read was successful, false if offset is outside the log
    */
-  bool ReadLog(char *log_data, int size, int offset);
+  bool ReadLog(char *log_data, int size, int64_t offset);
+
+  /**
+   * Recycles every log segment that lies entirely before offset.
+   * @param offset log offset of the oldest record that is still needed
+   */
+  void TruncateLog(int64_t offset);
+
+  /** @return the offset of the first log segment that is kept, where recovery starts reading */
+  int64_t GetLogStartOffset();
+
+  /** @return the offset just past the last log record */
+  int64_t GetLogEndOffset();
+
+  /** @return the size of each log segment */
+  inline int GetLogSegmentSize() const { return log_segment_size_; }
+
+  /** @return the number of log segments that were reused instead of created */
+  inline int GetNumRecycledLogSegments() const { return num_recycled_segments_; }
 
   /**
    * Allocate a page on disk.
@@ -77,7 +109,7 @@ class DiskManager {
   page_id_t AllocatePage();
 
   /**
-   * Deallocate a page on disk.
+   * Deallocate a page on disk. it reads as zeros from then on, until it is written again.
    * @param page_id id of the page to deallocate
    */
   void DeallocatePage(page_id_t page_id);
@@ -102,13 +134,38 @@ class DiskManager {
 
  private:
   int GetFileSize(const std::string &file_name);
-  // stream to write log file
+
+  std::string GetLogSegmentName(int64_t segment) const;
+  /** Makes segment the one that is written, starting at position. Creates and preallocates it if needed. */
+  void OpenLogSegment(int64_t segment, int position);
+  /** Reads from the log segments without checking the log bounds; missing segments read as zeros. */
+  void ReadLogSegments(char *log_data, int size, int64_t offset);
+  /** Follows the length words from offset to the end of the log. */
+  int64_t FindLogEnd(int64_t offset);
+  /** Writes the log control file. */
+  void WriteLogControl();
+
+  // stream to write the current log segment
   std::fstream log_io_;
+  // stream to read log segments, positioned on segment log_read_segment_
+  std::ifstream log_read_io_;
+  int64_t log_read_segment_{-1};
+  // name of the log control file, also the prefix of the segment files
   std::string log_name_;
+  int log_segment_size_;
+  // first segment that is needed, segment that is written, and the next write position inside it
+  int64_t log_start_segment_{0};
+  int64_t log_segment_{0};
+  int log_position_{0};
+  int num_recycled_segments_{0};
+  // protects the log state above
+  std::mutex log_latch_;
   // stream to write db file
   std::fstream db_io_;
   std::string file_name_;
   std::atomic<page_id_t> next_page_id_;
+  // pages that were deallocated and not written since, their old content must not be read back
+  std::unordered_set<page_id_t> deallocated_pages_;
   int num_flushes_;
   int num_writes_;
   bool flush_log_;
@@ -10,6 +10,8 @@
 //===----------------------------------------------------------------------===//
 #pragma once
 
+#include <atomic>
+#include <functional>
 #include <queue>
 #include <string>
 #include <vector>
@@ -17,9 +19,11 @@
 #include <time.h>
 
 #include "concurrency/transaction.h"
+#include "recovery/log_manager.h"
 #include "storage/index/index_iterator.h"
 #include "storage/page/b_plus_tree_internal_page.h"
 #include "storage/page/b_plus_tree_leaf_page.h"
+#include "storage/page/b_plus_tree_posting_page.h"
 #include "common/rwlatch.h"
 
 namespace bustub {
@@ -31,7 +35,8 @@ namespace bustub {
  *
  * Implementation of simple b+ tree data structure where internal pages direct
  * the search and leaf pages contain actual data.
- * (1) We only support unique key
+ * (1) Keys are unique, unless the tree is opened as non-unique: then a key can
+ *     have many values, kept in a posting list (see AddToPostingList())
  * (2) support insert & remove
  * (3) The structure should shrink and grow dynamically
  * (4) Implement index iterator for range scan
@@ -40,10 +45,21 @@ INDEX_TEMPLATE_ARGUMENTS
 class BPlusTree {
   using InternalPage = BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator>;
   using LeafPage = BPlusTreeLeafPage<KeyType, ValueType, KeyComparator>;
+  // reverse scans find the leaf before the current one from the root if a writer got in their way
+  friend INDEXITERATOR_TYPE;
 
  public:
+  // With a log manager, every change to a tree page is logged (when logging is enabled) so that redo restores the
+  // tree after a crash.
+  // With blink, the tree runs as a Lehman-Yao B-link tree (see InsertBLink()) instead of latch crabbing. A tree has
+  // to be opened in the same mode every time, pages are never merged in B-link mode.
+  // Without unique, a key can be inserted with many different values. The same goes for the mode.
   explicit BPlusTree(std::string name, BufferPoolManager *buffer_pool_manager, const KeyComparator &comparator,
-                     int leaf_max_size = LEAF_PAGE_SIZE, int internal_max_size = INTERNAL_PAGE_SIZE);
+                     int leaf_max_size = LEAF_PAGE_SIZE, int internal_max_size = INTERNAL_PAGE_SIZE,
+                     LogManager *log_manager = nullptr, bool blink = false, bool unique = true);
+
+  // Reads the root page id of an existing tree with this name from the header page, e.g. after recovery.
+  void LoadRootPageId();
 
   // Returns true if this B+ tree has no keys and values.
   bool IsEmpty() const;
@@ -51,15 +67,37 @@ class BPlusTree {
   // Insert a key-value pair into this B+ tree.
   bool Insert(const KeyType &key, const ValueType &value, Transaction *transaction = nullptr);
 
-  // Remove a key and its value from this B+ tree.
+  // Remove a key and its value from this B+ tree. all its values, if it has more than one.
   bool Remove(const KeyType &key, Transaction *transaction = nullptr);
 
-  // return the value associated with a given key
+  // Remove one value of a key, the key goes with its last value.
+  bool Remove(const KeyType &key, const ValueType &value, Transaction *transaction = nullptr);
+
+  // return the values associated with a given key
   bool GetValue(const KeyType &key, std::vector<ValueType> *result, Transaction *transaction = nullptr);
 
+  // GetValue() for many keys, result[i] gets the values of keys[i]. Keys in increasing order share the leaves they
+  // fall into, see MultiGet(). Returns the number of keys found.
+  size_t MultiGet(const std::vector<KeyType> &keys, std::vector<std::vector<ValueType>> *result,
+                  Transaction *transaction = nullptr);
+
+  // Insert() for many key-value pairs, which share leaves like the keys of MultiGet(). Returns the number inserted.
+  size_t InsertBatch(const std::vector<MappingType> &items, Transaction *transaction = nullptr);
+
+  // Build this (empty) B+ tree bottom-up from key-value pairs that source returns in increasing key order, with every
+  // page filled to fill_factor of its max size. Much cheaper than inserting them one by one, see BulkLoad().
+  bool BulkLoad(const std::function<bool(KeyType *, ValueType *)> &source, double fill_factor = 1.0,
+                Transaction *transaction = nullptr);
+
   // index iterator
   INDEXITERATOR_TYPE begin();
   INDEXITERATOR_TYPE Begin(const KeyType &key);
+  // Iterators over the pairs from low to high, either bound inclusive or not. They equal End() once ++ passes high
+  // or -- passes low, without touching the leaf beyond the bound. Begin() starts at the first pair of the range,
+  // RBegin() at the last one for a reverse scan, like rbegin() does at the last pair of the tree.
+  INDEXITERATOR_TYPE Begin(const KeyType &low, bool low_inclusive, const KeyType &high, bool high_inclusive);
+  INDEXITERATOR_TYPE RBegin(const KeyType &low, bool low_inclusive, const KeyType &high, bool high_inclusive);
+  INDEXITERATOR_TYPE rbegin();
   INDEXITERATOR_TYPE end();
   INDEXITERATOR_TYPE End();
   void Print(BufferPoolManager *bpm) {
@@ -77,6 +115,9 @@ class BPlusTree {
   // read data from file and insert one by one
   void InsertFromFile(const std::string &file_name, Transaction *transaction = nullptr);
 
+  // read data from file, sort it and bulk load it
+  void BulkLoadFromFile(const std::string &file_name, double fill_factor = 1.0, Transaction *transaction = nullptr);
+
   // read data from file and remove one by one
   void RemoveFromFile(const std::string &file_name, Transaction *transaction = nullptr);
   // expose for test purpose
@@ -89,6 +130,8 @@ class BPlusTree {
 
   bool InsertIntoLeaf(const KeyType &key, const ValueType &value, Transaction *transaction = nullptr);
 
+  bool RemoveKey(const KeyType &key, const ValueType *value, Transaction *transaction);
+
   void InsertIntoParent(BPlusTreePage *old_node, const KeyType &key, BPlusTreePage *new_node,
                         Transaction *transaction = nullptr);
 
@@ -110,28 +153,87 @@ class BPlusTree {
   void UpdateRootPageId();
 
   /* */
+  bool TryGetValueOptimistic(const KeyType &key, ValueType *value, bool *found);
+  bool FindLeafOptimistic(const KeyType &key, Page **leaf, uint64_t *version);
   Page* GetLeafPageOptimistic(bool isRead, const KeyType &key,  Transaction* txn);
   Page* GetLeafPagePessimistic(bool isInsert, const KeyType &key, Transaction* txn);
   Page* GetLeafPageOptimisticForIterator(const KeyType &key, int position);
+  Page* LatchRootPage(bool isRead);
   Page* FetchNeedPageFromBPM(page_id_t pid);
   Page* NewPageFromBPM(page_id_t& pid);
   template <typename N>
   void NewRootPage(N *left_node, N *right_node, Transaction *txn); 
   void ReleaseLatchAndDeletePage(Transaction* txn, bool isRead);
+  Page* GetLatchedPage(Transaction* txn, page_id_t pid);
+
+  /* B-link mode */
+  bool InsertBLink(const KeyType &key, const ValueType &value, Transaction *txn);
+  template <typename N>
+  void InsertIntoParentBLink(N *old_node, N *new_node, std::vector<page_id_t> *path, Transaction *txn);
+  bool RemoveBLink(const KeyType &key, const ValueType *value, Transaction *txn);
+  Page* FindLeafBLink(const KeyType &key, bool isRead, std::vector<page_id_t> *path);
+  page_id_t FindParentBLink(page_id_t child_id, const KeyType &key);
+  Page* MoveRight(Page* opt, const KeyType &key, bool isWrite);
+  page_id_t GetRightPageId(BPlusTreePage *node, const KeyType &key);
+
+  /* batched lookups and inserts */
+  bool LeafCovers(Page* leaf, const KeyType &key);
+  Page* NextLeafForBatch(Page* opt, const KeyType &key);
+
+  /* bottom-up bulk loading */
+  struct BulkLoadLevel {
+    Page *left = nullptr;   // full page, written out once the page right of it is full too
+    Page *right = nullptr;  // page being filled
+  };
+  template <typename N, typename V>
+  page_id_t BulkLoadAppend(std::vector<BulkLoadLevel> *levels, size_t level, const KeyType &key, const V &value,
+                           double fill_factor, Transaction *txn);
+  template <typename N>
+  void BulkLoadClose(std::vector<BulkLoadLevel> *levels, size_t level, Page *page, double fill_factor,
+                     Transaction *txn);
+  template <typename N>
+  Page *BulkLoadFinishLevel(std::vector<BulkLoadLevel> *levels, size_t level, double fill_factor, Transaction *txn);
+  void BulkLoadAbort(std::vector<BulkLoadLevel> *levels);
+  int BulkLoadFill(const BPlusTreePage *node, double fill_factor) const;
+
+  /* posting lists of non-unique keys, called while the leaf of the key is write latched (read latched to read) */
+  bool IsPostingList(const ValueType &value) const;
+  bool AddToPostingList(Page* leaf, int index, const ValueType &value);
+  bool RemoveFromPostingList(Page* leaf, int index, const ValueType &value);
+  ValueType NewPostingList(std::vector<ValueType> *values);
+  void ReadPostingList(const ValueType &list, std::vector<ValueType> *result);
+  void DeletePostingList(const ValueType &list);
+  Page* FetchPostingPage(page_id_t pid, bool isRead);
+
+  /* write-ahead logging of tree pages, called while the page is write latched. no-ops unless logging is enabled. */
+  void LogEntry(LogRecordType type, Page* page, int index);
+  void LogLeafHeader(Page* page);
+  void LogPageImage(Page* page);
+  void LogPageRange(Page* page, uint32_t offset, uint32_t length);
+  void LogPostingPage(Page* page, int from);
+  void LogParentPageId(page_id_t pid, Transaction* txn);
+  void LogChildrenParentPageId(InternalPage* node, int from, int to, Transaction* txn);
+  void SetPrevLeafPageId(const LeafRelink &relink);
   /* Debug Routines for FREE!! */
   void ToGraph(BPlusTreePage *page, BufferPoolManager *bpm, std::ofstream &out) const;
 
   void ToString(BPlusTreePage *page, BufferPoolManager *bpm) const;
 
   uint32_t getCurrentThreadId();
+  // point lookups that conflict with writers this often fall back to read latches
+  static constexpr int OPTIMISTIC_READ_ATTEMPTS = 8;
   // member variable
   std::string index_name_;
-  page_id_t root_page_id_;
+  std::atomic<page_id_t> root_page_id_;
   BufferPoolManager *buffer_pool_manager_;
   KeyComparator comparator_;
   int leaf_max_size_;
   int internal_max_size_;
-  mutable ReaderWriterLatch treelatch;
+  // write latched while root_page_id_ may change, see GetLeafPageOptimistic() for the latch protocol
+  mutable ReaderWriterLatch root_latch_;
+  LogManager *log_manager_;
+  bool blink_;
+  bool unique_;
 };
 
 }  // namespace bustub
@@ -25,7 +25,9 @@ namespace bustub {
 INDEX_TEMPLATE_ARGUMENTS
 class BPlusTreeIndex : public Index {
  public:
-  BPlusTreeIndex(IndexMetadata *metadata, BufferPoolManager *buffer_pool_manager);
+  // Without unique, a key can have many RIDs, e.g. for a secondary index on a column with few distinct values.
+  BPlusTreeIndex(IndexMetadata *metadata, BufferPoolManager *buffer_pool_manager, LogManager *log_manager = nullptr,
+                 bool unique = true);
 
   void InsertEntry(const Tuple &key, RID rid, Transaction *transaction) override;
 
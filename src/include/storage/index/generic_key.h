@@ -12,8 +12,10 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cstring>
 
+#include "common/exception.h"
 #include "storage/table/tuple.h"
 #include "type/value.h"
 
@@ -25,39 +27,45 @@ namespace bustub {
  * This key type uses an fixed length array to hold data for indexing
  * purposes, the actual size of which is specified and instantiated
  * with a template argument.
+ *
+ * The key columns are stored in a byte-comparable form, so that comparing two
+ * keys is a memcmp over the whole array:
+ * - integers (and booleans) are big-endian with the sign bit flipped,
+ * - timestamps are big-endian,
+ * - decimals are big-endian, negative ones with all bits flipped, the others
+ *   with the sign bit flipped,
+ * - varchars are their bytes followed by a 0 byte (null varchars are empty).
+ * Null integers and decimals are the smallest values of their type, so they
+ * sort first. Keys longer than KeySize are cut off, the rest is zero filled.
  */
 template <size_t KeySize>
 class GenericKey {
  public:
-  inline void SetFromKey(const Tuple &tuple) {
+  inline void SetFromKey(const Tuple &tuple, Schema *key_schema) {
     // intialize to 0
     memset(data_, 0, KeySize);
-    memcpy(data_, tuple.GetData(), tuple.GetLength());
+    uint32_t pos = 0;
+    for (uint32_t i = 0; i < key_schema->GetColumnCount() && pos < KeySize; i++) {
+      pos = AppendValue(tuple.GetValue(key_schema, i), pos);
+    }
   }
 
   // NOTE: for test purpose only
+  // stores key as a single bigint column, KeySize has to be at least 8
   inline void SetFromInteger(int64_t key) {
     memset(data_, 0, KeySize);
-    memcpy(data_, &key, sizeof(int64_t));
-  }
-
-  inline Value ToValue(Schema *schema, uint32_t column_idx) const {
-    const char *data_ptr;
-    const auto &col = schema->GetColumn(column_idx);
-    const TypeId column_type = col.GetType();
-    const bool is_inlined = col.IsInlined();
-    if (is_inlined) {
-      data_ptr = (data_ + col.GetOffset());
-    } else {
-      int32_t offset = *reinterpret_cast<int32_t *>(const_cast<char *>(data_ + col.GetOffset()));
-      data_ptr = (data_ + offset);
-    }
-    return Value::DeserializeFrom(data_ptr, column_type);
+    AppendBigEndian(static_cast<uint64_t>(key) ^ SIGN_BIT, sizeof(int64_t), 0);
   }
 
   // NOTE: for test purpose only
   // interpret the first 8 bytes as int64_t from data vector
-  inline int64_t ToString() const { return *reinterpret_cast<int64_t *>(const_cast<char *>(data_)); }
+  inline int64_t ToString() const {
+    uint64_t bits = 0;
+    for (size_t i = 0; i < sizeof(int64_t); i++) {
+      bits = (bits << 8) | (i < KeySize ? static_cast<uint8_t>(data_[i]) : 0);
+    }
+    return static_cast<int64_t>(bits ^ SIGN_BIT);
+  }
 
   // NOTE: for test purpose only
   // interpret the first 8 bytes as int64_t from data vector
@@ -68,30 +76,70 @@ class GenericKey {
 
   // actual location of data, extends past the end.
   char data_[KeySize];
+
+ private:
+  static constexpr uint64_t SIGN_BIT = 1ULL << 63;
+
+  // append value at pos in byte-comparable form, returns the position after it
+  inline uint32_t AppendValue(const Value &value, uint32_t pos) {
+    switch (value.GetTypeId()) {
+      case TypeId::BOOLEAN:
+      case TypeId::TINYINT:
+        return AppendSigned(value.GetAs<int8_t>(), pos);
+      case TypeId::SMALLINT:
+        return AppendSigned(value.GetAs<int16_t>(), pos);
+      case TypeId::INTEGER:
+        return AppendSigned(value.GetAs<int32_t>(), pos);
+      case TypeId::BIGINT:
+        return AppendSigned(value.GetAs<int64_t>(), pos);
+      case TypeId::TIMESTAMP:
+        return AppendBigEndian(value.GetAs<uint64_t>(), sizeof(uint64_t), pos);
+      case TypeId::DECIMAL: {
+        double decimal = value.GetAs<double>();
+        uint64_t bits;
+        memcpy(&bits, &decimal, sizeof(bits));
+        bits = (bits & SIGN_BIT) != 0 ? ~bits : bits | SIGN_BIT;
+        return AppendBigEndian(bits, sizeof(uint64_t), pos);
+      }
+      case TypeId::VARCHAR: {
+        uint32_t length = value.IsNull() ? 0 : strnlen(value.GetData(), value.GetLength());
+        uint32_t copy = std::min<uint32_t>(length, KeySize - pos);
+        if (copy > 0) {
+          memcpy(data_ + pos, value.GetData(), copy);
+        }
+        // the terminator is already there from the memset
+        return std::min<uint32_t>(pos + length + 1, KeySize);
+      }
+      default:
+        throw Exception(ExceptionType::UNKNOWN_TYPE, "unsupported key column type");
+    }
+  }
+
+  template <typename T>
+  inline uint32_t AppendSigned(T value, uint32_t pos) {
+    uint64_t bits = static_cast<uint64_t>(static_cast<int64_t>(value)) ^ (1ULL << (8 * sizeof(T) - 1));
+    return AppendBigEndian(bits, sizeof(T), pos);
+  }
+
+  // append the lowest size bytes of bits, most significant first
+  inline uint32_t AppendBigEndian(uint64_t bits, uint32_t size, uint32_t pos) {
+    for (uint32_t i = 0; i < size && pos < KeySize; i++, pos++) {
+      data_[pos] = static_cast<char>(bits >> (8 * (size - 1 - i)));
+    }
+    return pos;
+  }
 };
 
 /**
  * Function object returns true if lhs < rhs, used for trees
+ * Keys are byte-comparable (see GenericKey), so this is a memcmp.
  */
 template <size_t KeySize>
 class GenericComparator {
  public:
   inline int operator()(const GenericKey<KeySize> &lhs, const GenericKey<KeySize> &rhs) const {
-    uint32_t column_count = key_schema_->GetColumnCount();
-
-    for (uint32_t i = 0; i < column_count; i++) {
-      Value lhs_value = (lhs.ToValue(key_schema_, i));
-      Value rhs_value = (rhs.ToValue(key_schema_, i));
-
-      if (lhs_value.CompareLessThan(rhs_value) == CmpBool::CmpTrue) {
-        return -1;
-      }
-      if (lhs_value.CompareGreaterThan(rhs_value) == CmpBool::CmpTrue) {
-        return 1;
-      }
-    }
-    // equals
-    return 0;
+    int cmp = memcmp(lhs.data_, rhs.data_, KeySize);
+    return (cmp > 0) - (cmp < 0);
   }
 
   GenericComparator(const GenericComparator &other) : key_schema_{other.key_schema_} {}
@@ -100,7 +148,7 @@ class GenericComparator {
   explicit GenericComparator(Schema *key_schema) : key_schema_(key_schema) {}
 
  private:
-  Schema *key_schema_;
+  [[maybe_unused]] Schema *key_schema_;
 };
 
 }  // namespace bustub
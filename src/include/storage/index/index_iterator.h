@@ -13,18 +13,38 @@
  * For range scan of b+ tree
  */
 #pragma once
+#include <vector>
+
 #include "storage/page/b_plus_tree_leaf_page.h"
 
 namespace bustub {
 
 #define INDEXITERATOR_TYPE IndexIterator<KeyType, ValueType, KeyComparator>
 
+INDEX_TEMPLATE_ARGUMENTS
+class BPlusTree;
+
+/**
+ * An iterator holds the read latch of its leaf. ++ follows the right links of
+ * the leaves, -- their left links (see BPlusTreeLeafPage). An iterator from
+ * BPlusTree::Begin(low, high) or RBegin(low, high) equals End() once it passes
+ * either bound, and checks the bounds of a leaf against it before it moves on to
+ * the next leaf, so the leaf after the range is not touched.
+ */
 INDEX_TEMPLATE_ARGUMENTS
 class IndexIterator {
+  friend class BPlusTree<KeyType, ValueType, KeyComparator>;
+
  public:
   // you may define your own constructor based on your member variables
   IndexIterator();
-  IndexIterator(Page* page, int idx, BufferPoolManager* _bpm);
+  // without unique, a key with a posting list yields one pair for every value of the list
+  IndexIterator(Page* page, int idx, BufferPoolManager* _bpm, bool unique = true,
+                BPlusTree<KeyType, ValueType, KeyComparator> *_tree = nullptr);
+  // the latch goes with the iterator, it cannot be copied
+  IndexIterator(IndexIterator &&itr) noexcept;
+  IndexIterator(const IndexIterator &itr) = delete;
+  IndexIterator &operator=(const IndexIterator &itr) = delete;
   ~IndexIterator();
 
   bool isEnd();
@@ -33,6 +53,9 @@ class IndexIterator {
 
   IndexIterator &operator++();
 
+  // a reverse scan from BPlusTree::rbegin() or RBegin(), End() stays End()
+  IndexIterator &operator--();
+
   bool operator==(const IndexIterator &itr) const;
 
   bool operator!=(const IndexIterator &itr) const;
@@ -42,6 +65,26 @@ class IndexIterator {
     int current_index;
     Page* current_page;
     BufferPoolManager* bpm;
+    // the current pair, put back together from its prefix compressed slot
+    MappingType current_item;
+    bool unique_keys = true;
+    // the values of the current key if it has a posting list, read while its leaf is latched
+    std::vector<ValueType> postings;
+    size_t posting_index = 0;
+    void ReadPostings();
+    // the tree for its comparator, and to find the leaf before the current one again from the root
+    BPlusTree<KeyType, ValueType, KeyComparator> *tree = nullptr;
+    bool has_low_bound = false;
+    bool low_inclusive = true;
+    KeyType low_bound{};
+    bool has_high_bound = false;
+    bool high_inclusive = true;
+    KeyType high_bound{};
+    void SetRange(const KeyType *low, bool low_incl, const KeyType *high, bool high_incl, bool reverse);
+    void StepForward();
+    void StepBackward();
+    bool InRange();
+    void SetEnd();
 };
 
 }  // namespace bustub
@@ -12,13 +12,15 @@
 
 #include <queue>
 
+#include "storage/page/b_plus_tree_key_search.h"
 #include "storage/page/b_plus_tree_page.h"
 
 namespace bustub {
 
 #define B_PLUS_TREE_INTERNAL_PAGE_TYPE BPlusTreeInternalPage<KeyType, ValueType, KeyComparator>
-#define INTERNAL_PAGE_HEADER_SIZE 24
-#define INTERNAL_PAGE_SIZE ((PAGE_SIZE - INTERNAL_PAGE_HEADER_SIZE) / (sizeof(MappingType)))
+#define INTERNAL_PAGE_HEADER_SIZE (36 + 2 * sizeof(KeyType))
+// one slot is kept free: a full page takes one more entry before it is split
+#define INTERNAL_PAGE_SIZE ((PAGE_SIZE - INTERNAL_PAGE_HEADER_SIZE) / (sizeof(KeyType) + sizeof(ValueType)) - 1)
 /**
  * Store n indexed keys and n+1 child pointers (page_id) within internal page.
  * Pointer PAGE_ID(i) points to a subtree in which all keys K satisfy:
@@ -31,6 +33,21 @@ namespace bustub {
  *  --------------------------------------------------------------------------
  * | HEADER | KEY(1)+PAGE_ID(1) | KEY(2)+PAGE_ID(2) | ... | KEY(n)+PAGE_ID(n) |
  *  --------------------------------------------------------------------------
+ *
+ * Header format (size in byte, 36 bytes + 2 * key size in total):
+ *  ---------------------------------------------------------------------
+ * | BPlusTreePage header (28) | NextPageId (4) | PrefixSize (4) |
+ *  ---------------------------------------------------------------------
+ *  ------------------------------------------------------------------
+ * | LowKey (key size) | HighKey (key size) |
+ *  ------------------------------------------------------------------
+ *
+ * Like leaf pages, every page has a right link to its right sibling on the same
+ * level (B-link tree). HighKey is the separator between the page and its right
+ * sibling, all keys K of the page satisfy K < HighKey. the rightmost page of a
+ * level has no right link and no upper bound. splits keep both up to date.
+ * LowKey is the separator in the parent, keys are prefix compressed between
+ * LowKey and HighKey like in BPlusTreeLeafPage.
  */
 INDEX_TEMPLATE_ARGUMENTS
 class BPlusTreeInternalPage : public BPlusTreePage {
@@ -44,7 +61,19 @@ class BPlusTreeInternalPage : public BPlusTreePage {
   ValueType ValueAt(int index) const;
 
   ValueType Lookup(const KeyType &key, const KeyComparator &comparator) const;
+
+  page_id_t GetNextPageId() const;
+  void SetNextPageId(page_id_t next_page_id);
+  KeyType GetLowKey() const;
+  void SetLowKey(const KeyType &low_key);
+  KeyType GetHighKey() const;
+  void SetHighKey(const KeyType &high_key);
+  bool IsBeyondHighKey(const KeyType &key, const KeyComparator &comparator) const;
+  int GetPrefixSize() const;
+  int GetEntrySize() const;
+  int GetMergedMaxSize(const BPlusTreeInternalPage *sibling) const;
   void PopulateNewRoot(const ValueType &old_value, const KeyType &new_key, const ValueType &new_value);
+  void Append(const KeyType &new_key, const ValueType &new_value);
   int InsertNodeAfter(const ValueType &old_value, const KeyType &new_key, const ValueType &new_value, const KeyComparator &comparator);
   void Remove(int index);
   ValueType RemoveAndReturnOnlyChild();
@@ -56,12 +85,24 @@ class BPlusTreeInternalPage : public BPlusTreePage {
                         BufferPoolManager *buffer_pool_manager);
   void MoveLastToFrontOf(BPlusTreeInternalPage *recipient, const KeyType &middle_key,
                          BufferPoolManager *buffer_pool_manager);
+  void MoveLastNToFrontOf(BPlusTreeInternalPage *recipient, int n, BufferPoolManager *buffer_pool_manager);
 
  private:
-  void CopyNFrom(MappingType *items, int size, BufferPoolManager *buffer_pool_manager);
+  static int MaxSizeFor(int prefix_size);
+  KeySlots<KeyType> Slots(int *size) const;
+  char *SlotAt(int index);
+  const char *SlotAt(int index) const;
+  MappingType GetItem(int index) const;
+  void SetItem(int index, const KeyType &key, const ValueType &value);
+  void UpdatePrefix(const KeyType &old_low_key);
+  void CopyNFrom(const BPlusTreeInternalPage *page, int from, int size, BufferPoolManager *buffer_pool_manager);
   void CopyLastFrom(const MappingType &pair, BufferPoolManager *buffer_pool_manager);
   void CopyFirstFrom(const MappingType &pair, BufferPoolManager *buffer_pool_manager);
   void ResetParentIdForMovePage(page_id_t pid, page_id_t parentid, BufferPoolManager *buffer_pool_manager);
-  MappingType array[0];
+  page_id_t next_page_id_;
+  int prefix_size_;
+  KeyType low_key_;
+  KeyType high_key_;
+  char slots_[0];
 };
 }  // namespace bustub
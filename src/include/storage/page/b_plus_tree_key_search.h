@@ -0,0 +1,231 @@
+//===----------------------------------------------------------------------===//
+//
+//                         CMU-DB Project (15-445/645)
+//                         ***DO NO SHARE PUBLICLY***
+//
+// Identification: src/include/page/b_plus_tree_key_search.h
+//
+// Copyright (c) 2018, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "common/config.h"
+#include "storage/index/generic_key.h"
+
+namespace bustub {
+
+/**
+ * The sorted keys of a B+ tree page. Slot i starts at slots + i * stride with
+ * the key's bytes from prefix_size on, the bytes before are the same for all
+ * keys of the page and are taken from prefix (see BPlusTreeLeafPage).
+ */
+template <typename KeyType>
+struct KeySlots {
+  const char *slots;
+  size_t stride;
+  const KeyType *prefix;
+  size_t prefix_size;
+};
+
+/**
+ * Where a key stored at its actual length is: offset is from the start of the
+ * page, size is the number of key bytes after the prefix. the value follows them.
+ */
+struct KeyCell {
+  uint16_t offset;
+  uint16_t size;
+};
+
+/**
+ * The sorted keys of a B+ tree page that stores them at their actual length.
+ * Slot i at slots + i * sizeof(KeyCell) is the KeyCell of key i, key bytes past
+ * the prefix and the cell are zero (see BPlusTreeLeafPage).
+ */
+template <typename KeyType>
+struct KeyCells {
+  const char *page;
+  const char *slots;
+  const KeyType *prefix;
+  size_t prefix_size;
+
+  /** The cell of key i, kept within the page for readers that do not latch it. */
+  KeyCell At(int i) const {
+    KeyCell cell;
+    memcpy(&cell, slots + i * sizeof(KeyCell), sizeof(KeyCell));
+    cell.size = std::min<uint16_t>(cell.size, sizeof(KeyType) - prefix_size);
+    cell.offset = std::min<uint16_t>(cell.offset, PAGE_SIZE - cell.size);
+    return cell;
+  }
+};
+
+/**
+ * Search for a key in the slots of a B+ tree page.
+ * LowerBound() returns the first index in [begin, end) whose key is >= key,
+ * UpperBound() the first index whose key is > key, end if there is none.
+ *
+ * The primary template is a binary search with the comparator, on the slot
+ * keys put back together with the prefix. The page code picks a specialization
+ * through the key and comparator types.
+ */
+template <typename KeyType, typename KeyComparator>
+struct KeySearch {
+  static int LowerBound(const KeySlots<KeyType> &slots, int begin, int end, const KeyType &key,
+                        const KeyComparator &comparator) {
+    return Search<false>(slots, begin, end, key, comparator);
+  }
+
+  static int UpperBound(const KeySlots<KeyType> &slots, int begin, int end, const KeyType &key,
+                        const KeyComparator &comparator) {
+    return Search<true>(slots, begin, end, key, comparator);
+  }
+
+  static int LowerBound(const KeyCells<KeyType> &cells, int begin, int end, const KeyType &key,
+                        const KeyComparator &comparator) {
+    return Search<false>(cells, begin, end, key, comparator);
+  }
+
+  static int UpperBound(const KeyCells<KeyType> &cells, int begin, int end, const KeyType &key,
+                        const KeyComparator &comparator) {
+    return Search<true>(cells, begin, end, key, comparator);
+  }
+
+ private:
+  template <bool upper>
+  static int Search(const KeySlots<KeyType> &slots, int begin, int end, const KeyType &key,
+                    const KeyComparator &comparator) {
+    // only the bytes after the prefix change from one slot to the next
+    KeyType slot_key = *slots.prefix;
+    char *suffix = reinterpret_cast<char *>(&slot_key) + slots.prefix_size;
+    size_t suffix_size = sizeof(KeyType) - slots.prefix_size;
+    while (begin < end) {
+      int mid = begin + (end - begin) / 2;
+      memcpy(suffix, slots.slots + mid * slots.stride, suffix_size);
+      int cmp = comparator(slot_key, key);
+      if (upper ? cmp <= 0 : cmp < 0) {
+        begin = mid + 1;
+      } else {
+        end = mid;
+      }
+    }
+    return begin;
+  }
+
+  template <bool upper>
+  static int Search(const KeyCells<KeyType> &cells, int begin, int end, const KeyType &key,
+                    const KeyComparator &comparator) {
+    KeyType cell_key = *cells.prefix;
+    char *suffix = reinterpret_cast<char *>(&cell_key) + cells.prefix_size;
+    size_t suffix_size = sizeof(KeyType) - cells.prefix_size;
+    while (begin < end) {
+      int mid = begin + (end - begin) / 2;
+      KeyCell cell = cells.At(mid);
+      memcpy(suffix, cells.page + cell.offset, cell.size);
+      memset(suffix + cell.size, 0, suffix_size - cell.size);
+      int cmp = comparator(cell_key, key);
+      if (upper ? cmp <= 0 : cmp < 0) {
+        begin = mid + 1;
+      } else {
+        end = mid;
+      }
+    }
+    return begin;
+  }
+};
+
+/**
+ * 8 byte generic keys are big-endian and byte-comparable (see GenericKey), so
+ * they are compared as unsigned integers instead of through the comparator. A
+ * slot key is read as the 8 bytes that end with it, the bytes in front of the
+ * slot are replaced by the prefix.
+ * The binary search narrows the range down to SCAN_SIZE entries without
+ * branching on the keys, those are then counted. With AVX2 four keys are
+ * gathered out of the slots and compared at once.
+ */
+template <>
+struct KeySearch<GenericKey<8>, GenericComparator<8>> {
+  static constexpr int SCAN_SIZE = 8;
+
+  static int LowerBound(const KeySlots<GenericKey<8>> &slots, int begin, int end, const GenericKey<8> &key,
+                        const GenericComparator<8> & /*comparator*/) {
+    return Search<false>(slots, begin, end, Load(key.data_));
+  }
+
+  static int UpperBound(const KeySlots<GenericKey<8>> &slots, int begin, int end, const GenericKey<8> &key,
+                        const GenericComparator<8> & /*comparator*/) {
+    return Search<true>(slots, begin, end, Load(key.data_));
+  }
+
+ private:
+  // the 8 bytes at data as a big-endian integer
+  static inline uint64_t Load(const char *data) {
+    uint64_t bits;
+    memcpy(&bits, data, sizeof(bits));
+    return __builtin_bswap64(bits);
+  }
+
+  // does a key with these bits come before the position searched for
+  template <bool upper>
+  static inline bool Before(uint64_t bits, uint64_t target) {
+    return upper ? bits <= target : bits < target;
+  }
+
+  template <bool upper>
+  static int Search(const KeySlots<GenericKey<8>> &slots, int begin, int end, uint64_t target) {
+    size_t suffix_size = sizeof(GenericKey<8>) - slots.prefix_size;
+    uint64_t mask = suffix_size == sizeof(uint64_t) ? ~0ULL : (1ULL << (8 * suffix_size)) - 1;
+    uint64_t prefix = Load(slots.prefix->data_) & ~mask;
+    // the 8 bytes read for slot i start at ends + i * stride
+    const char *ends = slots.slots + suffix_size - sizeof(uint64_t);
+    size_t stride = slots.stride;
+
+    // the position searched for is in [first, first + size]
+    int first = begin;
+    int size = end - begin;
+    while (size > SCAN_SIZE) {
+      int half = size / 2;
+      uint64_t bits = prefix | (Load(ends + (first + half) * stride) & mask);
+      first = Before<upper>(bits, target) ? first + half : first;
+      size -= half;
+    }
+
+    // count the keys in [first, first + size) that come before the position searched for
+    int count = 0;
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+    const __m256i bswap = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1,
+                                           0, 15, 14, 13, 12, 11, 10, 9, 8);
+    const __m256i offsets = _mm256_setr_epi64x(0, stride, 2 * stride, 3 * stride);
+    const __m256i mask_bits = _mm256_set1_epi64x(static_cast<int64_t>(mask));
+    const __m256i prefix_bits = _mm256_set1_epi64x(static_cast<int64_t>(prefix));
+    // unsigned compare as signed compare of the values with the sign bit flipped
+    const __m256i signed_target = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<int64_t>(target)), sign);
+    for (; i + 4 <= size; i += 4) {
+      __m256i keys = _mm256_i64gather_epi64(reinterpret_cast<const long long *>(ends + (first + i) * stride),  // NOLINT
+                                            offsets, 1);
+      keys = _mm256_or_si256(_mm256_and_si256(_mm256_shuffle_epi8(keys, bswap), mask_bits), prefix_bits);
+      keys = _mm256_xor_si256(keys, sign);
+      __m256i after = upper ? _mm256_cmpgt_epi64(keys, signed_target)
+                            : _mm256_or_si256(_mm256_cmpgt_epi64(keys, signed_target),
+                                              _mm256_cmpeq_epi64(keys, signed_target));
+      count += 4 - __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(after)));
+    }
+#endif
+    for (; i < size; i++) {
+      uint64_t bits = prefix | (Load(ends + (first + i) * stride) & mask);
+      count += Before<upper>(bits, target) ? 1 : 0;
+    }
+    return first + count;
+  }
+};
+
+}  // namespace bustub
@@ -13,13 +13,15 @@
 #include <utility>
 #include <vector>
 
+#include "storage/page/b_plus_tree_key_search.h"
 #include "storage/page/b_plus_tree_page.h"
 
 namespace bustub {
 
 #define B_PLUS_TREE_LEAF_PAGE_TYPE BPlusTreeLeafPage<KeyType, ValueType, KeyComparator>
-#define LEAF_PAGE_HEADER_SIZE 28
-#define LEAF_PAGE_SIZE ((PAGE_SIZE - LEAF_PAGE_HEADER_SIZE) / sizeof(MappingType))
+#define LEAF_PAGE_HEADER_SIZE (56 + 2 * sizeof(KeyType))
+// one slot is kept free: a full page takes one more entry before it is split
+#define LEAF_PAGE_SIZE ((PAGE_SIZE - LEAF_PAGE_HEADER_SIZE) / (sizeof(KeyType) + sizeof(ValueType)) - 1)
 
 /**
  * Store indexed key and record id(record id = page id combined with slot id,
@@ -31,29 +33,93 @@ namespace bustub {
  * | HEADER | KEY(1) + RID(1) | KEY(2) + RID(2) | ... | KEY(n) + RID(n)
  *  ----------------------------------------------------------------------
  *
- *  Header format (size in byte, 28 bytes in total):
+ *  Header format (size in byte, 56 bytes + 2 * key size in total):
  *  ---------------------------------------------------------------------
- * | PageType (4) | LSN (4) | CurrentSize (4) | MaxSize (4) |
+ * | BPlusTreePage header (28) | NextPageId (4) | PrevPageId (4) |
  *  ---------------------------------------------------------------------
- *  -----------------------------------------------
- * | ParentPageId (4) | PageId (4) | NextPageId (4)
- *  -----------------------------------------------
+ *  ---------------------------------------------------------------------
+ * | PrefixSize (4) | SizeLimit (4) | UseCells (4) | CellsOffset (4) | CellsSize (4) |
+ *  ---------------------------------------------------------------------
+ *  ------------------------------------------------------------------
+ * | LowKey (key size) | HighKey (key size) |
+ *  ------------------------------------------------------------------
+ *
+ * NextPageId is the right link of a B-link tree and HighKey bounds the keys of
+ * the page from above, see BPlusTreeInternalPage. LowKey bounds them from below,
+ * it is the separator in the parent (all zero, the smallest key, for the first
+ * page of a level). PrevPageId links back to the page on the left, for reverse
+ * scans (see IndexIterator). it is only a hint: splits and merges on the left
+ * move it after they let go of their latches (see BPlusTree::SetPrevLeafPageId()),
+ * so it may point at a page that was split since, or merged away.
+ *
+ * Keys are prefix compressed: all keys that can go into the page lie between
+ * LowKey and HighKey, so they share the first PrefixSize bytes of the two. KEY(i)
+ * only stores the bytes after those, the page's slots are sizeof(KeyType) -
+ * PrefixSize + sizeof(ValueType) bytes long and the page holds more of them.
+ * The prefix changes with LowKey and HighKey only: splits make it longer, merges
+ * and redistributions can make it shorter. This relies on keys comparing byte by
+ * byte, like GenericKey does.
+ *
+ * Pages with keys longer than 8 bytes (VARIABLE_KEYS) can store them at their
+ * actual length instead (UseCells), in a slotted page:
+ *  ----------------------------------------------------------------------
+ * | HEADER | SLOT(1) | ... | SLOT(n) | free | CELL(k) ... CELL(1) |
+ *  ----------------------------------------------------------------------
+ * SLOT(i) is a KeyCell, the offset and the key size of a cell. the cell is the
+ * key without the prefix and without the zero bytes at its end (short varchars
+ * end in those), followed by the RID. cells are taken from the end of the page
+ * downwards (CellsOffset is the lowest one), removing a pair only frees its
+ * slot: its cell is dead until the cells are moved together (MakeRoomFor).
+ * CellsSize is the size of the cells in use.
+ * The max size of such a page is the number of pairs it holds now plus the
+ * number of the longest possible pairs that still fit, minus the free one,
+ * so it changes with every insert and remove. like the prefix this keeps the
+ * tree counting pairs.
+ * Cells pay off for keys that end in zeros, not for keys that only have a few
+ * bytes after the prefix: a KeyCell can be more than they save. so a page picks
+ * the layout that takes less room whenever it is rebuilt, i.e. when its prefix
+ * changes or pairs are moved into it (Rebuild). 8 byte keys always use fixed
+ * slots, they cannot get much shorter and the search over fixed slots is
+ * faster (see KeySearch).
+ *
+ * SizeLimit is the max size the page was set up with if that is less than a
+ * page with keys of full length holds, 0 if the page is used as a whole.
  */
 INDEX_TEMPLATE_ARGUMENTS
 class BPlusTreeLeafPage : public BPlusTreePage {
  public:
+  static constexpr bool VARIABLE_KEYS = sizeof(KeyType) > 8;
+  static constexpr uint32_t OFFSET_PREV_PAGE_ID = 32;
+
   // After creating a new leaf page from buffer pool, must call initialize
   // method to set default values
   void Init(page_id_t page_id, page_id_t parent_id = INVALID_PAGE_ID, int max_size = LEAF_PAGE_SIZE);
   // helper methods
   page_id_t GetNextPageId() const;
   void SetNextPageId(page_id_t next_page_id);
+  page_id_t GetPrevPageId() const;
+  void SetPrevPageId(page_id_t prev_page_id);
+  KeyType GetLowKey() const;
+  void SetLowKey(const KeyType &low_key);
+  KeyType GetHighKey() const;
+  void SetHighKey(const KeyType &high_key);
+  bool IsBeyondHighKey(const KeyType &key, const KeyComparator &comparator) const;
+  int GetPrefixSize() const;
+  bool UsesCells() const;
+  int GetEntrySize() const;
+  int GetMergedMaxSize(const BPlusTreeLeafPage *sibling) const;
+  int GetCellsOffset() const;
+  KeyCell GetCell(int index) const;
   KeyType KeyAt(int index) const;
   int KeyIndex(const KeyType &key, const KeyComparator &comparator) const;
-  const MappingType &GetItem(int index);
+  MappingType GetItem(int index) const;
+  int ValueOffset(int index) const;
+  void SetValueAt(int index, const ValueType &value);
 
   // insert and delete methods
   int Insert(const KeyType &key, const ValueType &value, const KeyComparator &comparator);
+  void Append(const KeyType &key, const ValueType &value);
+  bool MakeRoomFor(const KeyType &key);
   bool Lookup(const KeyType &key, ValueType *value, const KeyComparator &comparator) const;
   int RemoveAndDeleteRecord(const KeyType &key, const KeyComparator &comparator);
 
@@ -62,16 +128,42 @@ class BPlusTreeLeafPage : public BPlusTreePage {
   void MoveAllTo(BPlusTreeLeafPage *recipient, const KeyType &middle_key, BufferPoolManager *buffer_pool_manager);
   void MoveFirstToEndOf(BPlusTreeLeafPage *recipient, const KeyType &middle_key, BufferPoolManager *buffer_pool_manager);
   void MoveLastToFrontOf(BPlusTreeLeafPage *recipient, const KeyType &middle_key, BufferPoolManager *buffer_pool_manager);
+  void MoveLastNToFrontOf(BPlusTreeLeafPage *recipient, int n, BufferPoolManager *buffer_pool_manager);
 
   // help function 
   int LookUpTheKey(const KeyType &key, const KeyComparator &comparator) const;
   
  private:
-  void CopyNFrom(MappingType *items, int size);
+  static int MaxSizeFor(int prefix_size, bool cells = false);
+  static bool PreferCells(int size, int cells_size, int prefix_size);
+  static int CellKeySize(const KeyType &key, int prefix_size);
+  int FreeSize() const;
+  int LowerBound(const KeyType &key, const KeyComparator &comparator, int *size) const;
+  KeySlots<KeyType> Slots(int *size) const;
+  KeyCells<KeyType> Cells(int *size) const;
+  char *SlotAt(int index);
+  const char *SlotAt(int index) const;
+  KeyType DecodeKey(int index, const KeyType &prefix) const;
+  ValueType ValueAt(int index) const;
+  void InsertItem(int index, const KeyType &key, const ValueType &value);
+  void RemoveItems(int index, int n);
+  void Compact();
+  void Rebuild(const std::vector<MappingType> &items);
+  void UpdateMaxSize();
+  void UpdatePrefix(const KeyType &old_low_key);
+  void CopyNFrom(const BPlusTreeLeafPage *page, int from, int size);
   void CopyLastFrom(const MappingType &item);
   void CopyFirstFrom(const MappingType &item);
   //int LookUpTheKey(const KeyType &key, const KeyComparator &comparator) const;
   page_id_t next_page_id_;
-  MappingType array[0];
+  page_id_t prev_page_id_;
+  int prefix_size_;
+  int size_limit_;
+  int use_cells_;
+  int cells_offset_;
+  int cells_size_;
+  KeyType low_key_;
+  KeyType high_key_;
+  char slots_[0];
 };
 }  // namespace bustub
@@ -13,6 +13,7 @@
 #include <cassert>
 #include <climits>
 #include <cstdlib>
+#include <cstring>
 #include <string>
 
 #include "buffer/buffer_pool_manager.h"
@@ -25,23 +26,29 @@ namespace bustub {
 #define INDEX_TEMPLATE_ARGUMENTS template <typename KeyType, typename ValueType, typename KeyComparator>
 
 // define page type enum
-enum class IndexPageType { INVALID_INDEX_PAGE = 0, LEAF_PAGE, INTERNAL_PAGE };
+enum class IndexPageType { INVALID_INDEX_PAGE = 0, LEAF_PAGE, INTERNAL_PAGE, POSTING_PAGE };
 
 /**
- * Both internal and leaf page are inherited from this page.
+ * Internal, leaf and posting list pages are inherited from this page.
  *
  * It actually serves as a header part for each B+ tree page and
  * contains information shared by both leaf page and internal page.
  *
- * Header format (size in byte, 24 bytes in total):
+ * Header format (size in byte, 28 bytes in total):
  * ----------------------------------------------------------------------------
  * | PageType (4) | LSN (4) | CurrentSize (4) | MaxSize (4) |
  * ----------------------------------------------------------------------------
- * | ParentPageId (4) | PageId(4) |
+ * | ParentPageId (4) | PageId(4) | MinSize (4) |
  * ----------------------------------------------------------------------------
+ *
+ * MaxSize can grow when the page stores its keys prefix compressed (see
+ * BPlusTreeLeafPage), MinSize stays half of the max size the page started with.
  */
 class BPlusTreePage {
  public:
+  /** Where ParentPageId lives in the header, for logging a change of the parent alone. */
+  static constexpr uint32_t OFFSET_PARENT_PAGE_ID = 16;
+
   bool IsLeafPage() const;
   bool IsRootPage() const;
   void SetPageType(IndexPageType page_type);
@@ -53,6 +60,7 @@ class BPlusTreePage {
   int GetMaxSize() const;
   void SetMaxSize(int max_size);
   int GetMinSize() const;
+  void SetMinSize(int min_size);
   bool IsSafeToInsert();
   bool IsSafeToRemove();
 
@@ -64,6 +72,12 @@ class BPlusTreePage {
 
   void SetLSN(lsn_t lsn = INVALID_LSN);
 
+ protected:
+  // key & value slots with the keys prefix compressed, see BPlusTreeLeafPage
+  static size_t CommonPrefixSize(const char *lhs, const char *rhs, size_t key_size);
+  static void ResizeSlots(char *slots, int size, size_t key_size, size_t value_size, const char *prefix,
+                          size_t old_prefix_size, size_t new_prefix_size);
+
  private:
   // member variable, attributes that both internal and leaf page share
   IndexPageType page_type_;
@@ -72,6 +86,7 @@ class BPlusTreePage {
   int max_size_;
   page_id_t parent_page_id_;
   page_id_t page_id_;
+  int min_size_;
 };
 
 }  // namespace bustub
@@ -0,0 +1,76 @@
+//===----------------------------------------------------------------------===//
+//
+//                         CMU-DB Project (15-445/645)
+//                         ***DO NO SHARE PUBLICLY***
+//
+// Identification: src/include/page/b_plus_tree_posting_page.h
+//
+// Copyright (c) 2018, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <vector>
+
+#include "common/rid.h"
+#include "storage/page/b_plus_tree_page.h"
+
+namespace bustub {
+
+#define POSTING_PAGE_HEADER_SIZE 36
+
+/**
+ * The RIDs of one key of a non-unique B+ tree that has more than one row for
+ * it (see BPlusTree). The leaf pair of the key holds RID(first page of the
+ * list, POSTING_LIST_SLOT) instead of a RID then.
+ *
+ * Posting page format (RIDs are stored in increasing order of SortKey()):
+ *  ----------------------------------------------------------------------
+ * | HEADER | VARINT(RID(1)) | VARINT(RID(2) - RID(1)) | ... | VARINT(RID(n) - RID(n-1))
+ *  ----------------------------------------------------------------------
+ *
+ *  Header format (size in byte, 36 bytes in total):
+ *  ---------------------------------------------------------------------
+ * | BPlusTreePage header (28) | NextPageId (4) | DataSize (4) |
+ *  ---------------------------------------------------------------------
+ *
+ * RIDs are delta encoded: every RID but the first is stored as its distance to
+ * the one before, 7 bits a byte. rows of a table that sit close together take
+ * a byte or two each, instead of a key and a RID per row in the leaves.
+ * A list that does not fit into one page goes on in the page NextPageId links
+ * to, every page holds the RIDs from its first one up to the first one of the
+ * next page, and starts over with a full RID. CurrentSize is the number of RIDs
+ * in the page, DataSize the number of bytes they take.
+ */
+class BPlusTreePostingPage : public BPlusTreePage {
+ public:
+  /** The slot number of a leaf value that stands for a posting list. */
+  static constexpr uint32_t POSTING_LIST_SLOT = UINT32_MAX;
+  /** The most an insert can add to the data: a new varint, and the one after it gets as long again. */
+  static constexpr int MAX_INSERT_GROWTH = 20;
+
+  /** The order of RIDs in a posting list. */
+  static uint64_t SortKey(const RID &rid) { return static_cast<uint64_t>(rid.Get()); }
+
+  void Init(page_id_t page_id);
+  page_id_t GetNextPageId() const;
+  void SetNextPageId(page_id_t next_page_id);
+  int GetUsedSize() const;
+  bool HasRoomForInsert() const;
+  RID GetFirstRid() const;
+  void GetRids(std::vector<RID> *result) const;
+
+  int Insert(const RID &rid);
+  int Remove(const RID &rid);
+  int SetRids(const RID *rids, int size);
+  void MoveHalfTo(BPlusTreePostingPage *recipient);
+
+ private:
+  static int EncodeVarint(uint64_t value, char *out);
+  static int DecodeVarint(const char *in, const char *end, uint64_t *value);
+  page_id_t next_page_id_;
+  int data_size_;
+  char data_[0];
+};
+
+}  // namespace bustub
@@ -12,6 +12,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstring>
 #include <iostream>
 
@@ -48,11 +49,19 @@ class Page {
   /** @return true if the page in memory has been modified from the page on disk, false otherwise */
   inline bool IsDirty() { return is_dirty_; }
 
-  /** Acquire the page write latch. */
-  inline void WLatch() { rwlatch_.WLock(); }
+  /** Acquire the page write latch. The page version is odd while the write latch is held. */
+  inline void WLatch() {
+    rwlatch_.WLock();
+    version_.fetch_add(1, std::memory_order_relaxed);
+    // Keep the writes to the page behind the version change.
+    std::atomic_thread_fence(std::memory_order_release);
+  }
 
   /** Release the page write latch. */
-  inline void WUnlatch() { rwlatch_.WUnlock(); }
+  inline void WUnlatch() {
+    version_.fetch_add(1, std::memory_order_release);
+    rwlatch_.WUnlock();
+  }
 
   /** Acquire the page read latch. */
   inline void RLatch() { rwlatch_.RLock(); }
@@ -60,11 +69,36 @@ class Page {
   /** Release the page read latch. */
   inline void RUnlatch() { rwlatch_.RUnlock(); }
 
+  /**
+   * Optimistic reads read the page without its latch: they take the version first, and whatever they read is only
+   * valid if ValidateVersion() succeeds afterwards. The page must stay pinned in between.
+   * @return the page version, odd while the page is write latched
+   */
+  inline uint64_t GetVersion() { return version_.load(std::memory_order_acquire); }
+
+  /** @return true if the page was not write latched since GetVersion() returned version */
+  inline bool ValidateVersion(uint64_t version) {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return (version & 1) == 0 && version_.load(std::memory_order_relaxed) == version;
+  }
+
   /** @return the page LSN. */
   inline lsn_t GetLSN() { return *reinterpret_cast<lsn_t *>(GetData() + OFFSET_LSN); }
 
-  /** Sets the page LSN. */
-  inline void SetLSN(lsn_t lsn) { memcpy(GetData() + OFFSET_LSN, &lsn, sizeof(lsn_t)); }
+  /** Sets the page LSN. The first LSN since the page was last written out also becomes its recLSN. */
+  inline void SetLSN(lsn_t lsn) {
+    memcpy(GetData() + OFFSET_LSN, &lsn, sizeof(lsn_t));
+    SetRecLSN(lsn);
+  }
+
+  /** Notes that the record at lsn dirtied the page. Pages without an LSN field, like the header page, only use this. */
+  inline void SetRecLSN(lsn_t lsn) {
+    lsn_t invalid = INVALID_LSN;
+    rec_lsn_.compare_exchange_strong(invalid, lsn);
+  }
+
+  /** @return the LSN of the first log record that dirtied the page since it was last written out, or INVALID_LSN */
+  inline lsn_t GetRecLSN() { return rec_lsn_; }
 
  protected:
   static_assert(sizeof(page_id_t) == 4);
@@ -86,8 +120,12 @@ class Page {
   int pin_count_ = 0;
   /** True if the page is dirty, i.e. it is different from its corresponding page on disk. */
   bool is_dirty_ = false;
+  /** The LSN from which redo has to start for this page, reset by the buffer pool manager when it writes the page. */
+  std::atomic<lsn_t> rec_lsn_{INVALID_LSN};
   /** Page latch. */
   ReaderWriterLatch rwlatch_;
+  /** Bumped when the write latch is taken and when it is released. */
+  std::atomic<uint64_t> version_{0};
 };
 
 }  // namespace bustub
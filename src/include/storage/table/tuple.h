@@ -63,6 +63,12 @@ class Tuple {
   // deserialize tuple data(deep copy)
   void DeserializeFrom(const char *storage);
 
+  // deserialize tuple data as a view into storage(no copy), storage must outlive the tuple
+  void DeserializeViewFrom(const char *storage);
+
+  // return a tuple that shares this tuple's data(no copy), this tuple must outlive the view
+  Tuple AsView() const;
+
   // return RID of current tuple
   inline RID GetRid() const { return rid_; }
 
@@ -12,6 +12,11 @@
 
 #include "recovery/log_manager.h"
 
+#include <algorithm>
+#include <chrono>  // NOLINT
+
+#include "common/exception.h"
+
 namespace bustub {
 /*
  * set enable_logging = true
@@ -22,33 +27,207 @@ namespace bustub {
  *
  * This thread runs forever until system shutdown/StopFlushThread
  */
-void LogManager::RunFlushThread() {}
+void LogManager::RunFlushThread() {
+  std::lock_guard<std::mutex> guard(latch_);
+  if (flush_thread_running_) {
+    return;
+  }
+  enable_logging = true;
+  flush_thread_running_ = true;
+  flush_thread_ = new std::thread([this] {
+    std::unique_lock<std::mutex> lock(latch_);
+    while (flush_thread_running_) {
+      cv_.wait_for(lock, log_timeout, [this] { return flush_requested_ || !flush_thread_running_; });
+      bool switch_buffer = switch_requested_;
+      flush_requested_ = false;
+      switch_requested_ = false;
+      lock.unlock();
+      FlushLogBuffer(switch_buffer);
+      lock.lock();
+    }
+  });
+}
 
 /*
  * Stop and join the flush thread, set enable_logging = false
  */
-void LogManager::StopFlushThread() {}
+void LogManager::StopFlushThread() {
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    if (!flush_thread_running_) {
+      return;
+    }
+    enable_logging = false;
+    flush_thread_running_ = false;
+    cv_.notify_one();
+    append_cv_.notify_all();
+    flush_cv_.notify_all();
+  }
+  flush_thread_->join();
+  delete flush_thread_;
+  flush_thread_ = nullptr;
+  // Whatever was appended after the thread's last round still has to reach the disk.
+  FlushLogBuffer(false);
+}
 
 /*
  * append a log record into log buffer
  * you MUST set the log record's lsn within this method
  * @return: lsn that is assigned to this log record
  *
- *
- * example below
- * // First, serialize the must have fields(20 bytes in total)
- * log_record.lsn_ = next_lsn_++;
- * memcpy(log_buffer_ + offset_, &log_record, 20);
- * int pos = offset_ + 20;
- *
- * if (log_record.log_record_type_ == LogRecordType::INSERT) {
- *    memcpy(log_buffer_ + pos, &log_record.insert_rid_, sizeof(RID));
- *    pos += sizeof(RID);
- *    // we have provided serialize function for tuple class
- *    log_record.insert_tuple_.SerializeTo(log_buffer_ + pos);
- *  }
- *
+ * The LSN and the buffer range are reserved together with one CAS, so buffer order always matches LSN order. The
+ * record is then serialized without holding any latch and marked complete in the completion ring.
+ * If the record does not fit, the writer asks for a buffer switch and waits for it.
  */
-lsn_t LogManager::AppendLogRecord(LogRecord *log_record) { return INVALID_LSN; }
+lsn_t LogManager::AppendLogRecord(LogRecord *log_record) {
+  const auto size = static_cast<uint32_t>(log_record->size_);
+  if (log_record->size_ <= 0 || size > static_cast<uint32_t>(LOG_BUFFER_SIZE)) {
+    throw Exception(ExceptionType::OUT_OF_RANGE, "log record does not fit in the log buffer");
+  }
+
+  uint64_t state = reserve_state_.load();
+  while (true) {
+    if (StateOffset(state) + size > static_cast<uint32_t>(LOG_BUFFER_SIZE)) {
+      std::unique_lock<std::mutex> lock(latch_);
+      if (!flush_thread_running_) {
+        lock.unlock();
+        FlushLogBuffer(true);
+      } else {
+        flush_requested_ = true;
+        switch_requested_ = true;
+        cv_.notify_one();
+        append_cv_.wait(lock, [&] {
+          return StateOffset(reserve_state_.load()) + size <= static_cast<uint32_t>(LOG_BUFFER_SIZE) ||
+                 !flush_thread_running_;
+        });
+      }
+      state = reserve_state_.load();
+      continue;
+    }
+    uint64_t reserved = PackState(StateLSN(state) + 1, StateBuffer(state), StateOffset(state) + size);
+    if (reserve_state_.compare_exchange_weak(state, reserved)) {
+      break;
+    }
+  }
+
+  const lsn_t lsn = StateLSN(state);
+  const uint32_t buffer = StateBuffer(state);
+  const uint32_t offset = StateOffset(state);
+  log_record->lsn_ = lsn;
+  // The buffer is not reused before this record is on disk, so nobody else touches [offset, offset + size).
+  log_record->SerializeTo(log_buffers_[buffer] + offset);
+  completion_ring_[lsn % COMPLETION_RING_SIZE].store(PackState(lsn, buffer, offset + size), std::memory_order_release);
+  if (log_record->log_record_type_ == LogRecordType::DELTAUPDATE) {
+    delta_bytes_saved_.fetch_add(log_record->GetDeltaBytesSaved(), std::memory_order_relaxed);
+  }
+  return lsn;
+}
+
+void LogManager::Flush(lsn_t lsn) {
+  // Pages that were never logged (e.g. the header page) carry no meaningful LSN.
+  lsn = std::min(lsn, GetNextLSN() - 1);
+  while (persistent_lsn_ < lsn) {
+    std::unique_lock<std::mutex> lock(latch_);
+    if (!flush_thread_running_) {
+      lock.unlock();
+      FlushLogBuffer(false);
+      if (persistent_lsn_ < lsn) {
+        // An earlier record is still being serialized by another writer.
+        std::this_thread::yield();
+      }
+      continue;
+    }
+    flush_requested_ = true;
+    cv_.notify_one();
+    // Woken up either by a flush round or by StopFlushThread; the loop re-checks which one it was.
+    flush_cv_.wait(lock, [&] { return persistent_lsn_ >= lsn || !flush_thread_running_; });
+  }
+}
+
+void LogManager::FlushLogBuffer(bool switch_buffer) {
+  std::lock_guard<std::mutex> flush_guard(flush_latch_);
+  WriteCompletedPrefix();
+
+  uint64_t state = reserve_state_.load();
+  if (switch_buffer && StateOffset(state) > 0) {
+    // The other buffer may still hold records that are being serialized; it can only be reused once they are on disk.
+    while (flush_buffer_ != StateBuffer(state)) {
+      std::this_thread::yield();
+      WriteCompletedPrefix();
+      state = reserve_state_.load();
+    }
+    {
+      // Switch under latch_ so that a writer cannot miss the wakeup between checking for room and going to sleep.
+      std::lock_guard<std::mutex> guard(latch_);
+      // Only the flusher changes the buffer index, so the CAS can only fail because of new reservations.
+      while (!reserve_state_.compare_exchange_weak(state, PackState(StateLSN(state), StateBuffer(state) ^ 1, 0))) {
+      }
+    }
+    append_cv_.notify_all();
+  }
+}
+
+void LogManager::WriteCompletedPrefix() {
+  uint32_t end = flush_offset_;
+  lsn_t first_lsn = flush_lsn_;
+  while (true) {
+    uint64_t entry = completion_ring_[flush_lsn_ % COMPLETION_RING_SIZE].load(std::memory_order_acquire);
+    if (StateLSN(entry) != flush_lsn_) {
+      // Not complete yet, or not even reserved. In the latter case the active buffer may have been switched while the
+      // old one was already fully written, and the next record will start at the beginning of the new buffer.
+      uint64_t state = reserve_state_.load();
+      if (StateLSN(state) == flush_lsn_ && StateBuffer(state) != flush_buffer_) {
+        WriteLogRange(end, first_lsn);
+        flush_buffer_ = StateBuffer(state);
+        flush_offset_ = end = 0;
+      }
+      break;
+    }
+    if (StateBuffer(entry) != flush_buffer_) {
+      // Every record of the old buffer is complete; finish it and continue in the other one.
+      WriteLogRange(end, first_lsn);
+      flush_buffer_ = StateBuffer(entry);
+      flush_offset_ = end = 0;
+      first_lsn = flush_lsn_;
+    }
+    end = StateOffset(entry);
+    flush_lsn_++;
+  }
+  WriteLogRange(end, first_lsn);
+  flush_offset_ = end;
+
+  {
+    std::lock_guard<std::mutex> guard(latch_);
+    if (flush_lsn_ - 1 > persistent_lsn_) {
+      persistent_lsn_ = flush_lsn_ - 1;
+    }
+  }
+  flush_cv_.notify_all();
+}
+
+void LogManager::WriteLogRange(uint32_t end, lsn_t first_lsn) {
+  if (end <= flush_offset_) {
+    return;
+  }
+  auto start = std::chrono::steady_clock::now();
+  int64_t offset =
+      disk_manager_->WriteLog(log_buffers_[flush_buffer_] + flush_offset_, static_cast<int>(end - flush_offset_));
+  log_sync_latency_.Record(std::chrono::steady_clock::now() - start);
+  int segment_size = disk_manager_->GetLogSegmentSize();
+  if (segment_starts_.empty() || segment_starts_.back().second / segment_size != offset / segment_size) {
+    segment_starts_.emplace_back(first_lsn, offset);
+  }
+}
+
+void LogManager::TruncateLog(lsn_t lsn) {
+  std::lock_guard<std::mutex> flush_guard(flush_latch_);
+  // Keep the newest segment that starts at or before lsn; everything in front of it is no longer needed.
+  while (segment_starts_.size() > 1 && segment_starts_[1].first <= lsn) {
+    segment_starts_.pop_front();
+  }
+  if (!segment_starts_.empty() && segment_starts_.front().first <= lsn) {
+    disk_manager_->TruncateLog(segment_starts_.front().second);
+  }
+}
 
 }  // namespace bustub
@@ -0,0 +1,151 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_reader.cpp
+//
+// Identification: src/recovery/log_reader.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "recovery/log_reader.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace bustub {
+
+LogReader::LogReader(DiskManager *disk_manager, int read_ahead_size)
+    : disk_manager_(disk_manager),
+      read_ahead_size_(std::max(read_ahead_size, LOG_BUFFER_SIZE)),
+      segment_size_(disk_manager->GetLogSegmentSize()),
+      chunk_offset_(disk_manager->GetLogStartOffset()) {}
+
+LogReader::~LogReader() { CancelPrefetch(); }
+
+void LogReader::Seek(int64_t offset) {
+  CancelPrefetch();
+  chunk_offset_ = offset;
+  loaded_ = false;
+}
+
+bool LogReader::Next(LogRecord *log_record, const char **data, int64_t *offset) {
+  if (!loaded_ && !LoadChunk()) {
+    return false;
+  }
+  while (true) {
+    int64_t position = chunk_offset_ + (pos_ - LOG_BUFFER_SIZE);
+    int segment_space = segment_size_ - static_cast<int>(position % segment_size_);
+    const char *next = buffers_[current_].get() + pos_;
+    int available = end_ - pos_;
+    if (segment_space < static_cast<int>(sizeof(int32_t)) ||
+        (available >= static_cast<int>(sizeof(int32_t)) &&
+         *reinterpret_cast<const int32_t *>(next) == DiskManager::LOG_SEGMENT_END)) {
+      // The rest of this segment is unused, the log goes on at the start of the next one.
+      if (segment_space <= available) {
+        pos_ += segment_space;
+        continue;
+      }
+      Seek(position + segment_space);
+      if (!LoadChunk()) {
+        return false;
+      }
+      continue;
+    }
+
+    if (log_record->DeserializeFrom(next, available)) {
+      *data = next;
+      *offset = position;
+      pos_ += log_record->GetSize();
+      return true;
+    }
+    if (available >= static_cast<int>(sizeof(int32_t))) {
+      // Short reads are padded with zeros, so a zero size is the end of the log. A size that fits into what is left of
+      // the chunk but still does not decode is not a record either.
+      int32_t size = *reinterpret_cast<const int32_t *>(next);
+      if (size < LogRecord::HEADER_SIZE || size > LOG_BUFFER_SIZE || size <= available) {
+        return false;
+      }
+    }
+    // The record straddles the end of the chunk.
+    if (!AdvanceChunk()) {
+      return false;
+    }
+  }
+}
+
+bool LogReader::ReadAt(int64_t offset, LogRecord *log_record) {
+  if (window_ == nullptr) {
+    window_.reset(new char[read_ahead_size_]);
+  }
+  int64_t window_end = window_offset_ + window_size_;
+  bool hit = offset >= window_offset_ && offset + LogRecord::HEADER_SIZE <= window_end &&
+             offset + *reinterpret_cast<const int32_t *>(window_.get() + (offset - window_offset_)) <= window_end;
+  if (!hit) {
+    // Undo walks backwards, so the window ends at the latest place the record can end and reaches back from there.
+    int64_t start = std::max(disk_manager_->GetLogStartOffset(), offset + LOG_BUFFER_SIZE - read_ahead_size_);
+    if (offset < start) {
+      return false;
+    }
+    window_size_ = static_cast<int>(offset + LOG_BUFFER_SIZE - start);
+    if (!disk_manager_->ReadLog(window_.get(), window_size_, start)) {
+      window_size_ = 0;
+      return false;
+    }
+    window_offset_ = start;
+    window_end = window_offset_ + window_size_;
+  }
+  return log_record->DeserializeFrom(window_.get() + (offset - window_offset_), static_cast<int>(window_end - offset));
+}
+
+bool LogReader::LoadChunk() {
+  CancelPrefetch();
+  if (buffers_[0] == nullptr) {
+    buffers_[0].reset(new char[LOG_BUFFER_SIZE + read_ahead_size_]);
+    buffers_[1].reset(new char[LOG_BUFFER_SIZE + read_ahead_size_]);
+  }
+  current_ = 0;
+  if (!disk_manager_->ReadLog(buffers_[current_].get() + LOG_BUFFER_SIZE, read_ahead_size_, chunk_offset_)) {
+    return false;
+  }
+  pos_ = LOG_BUFFER_SIZE;
+  end_ = LOG_BUFFER_SIZE + read_ahead_size_;
+  loaded_ = true;
+  StartPrefetch();
+  return true;
+}
+
+bool LogReader::AdvanceChunk() {
+  if (!prefetch_.valid() || !prefetch_.get()) {
+    return false;
+  }
+  // Put the head of the straddling record right in front of the chunk that holds its tail.
+  int head = end_ - pos_;
+  char *next = buffers_[current_ ^ 1].get();
+  memcpy(next + LOG_BUFFER_SIZE - head, buffers_[current_].get() + pos_, head);
+  current_ ^= 1;
+  pos_ = LOG_BUFFER_SIZE - head;
+  end_ = LOG_BUFFER_SIZE + read_ahead_size_;
+  chunk_offset_ += read_ahead_size_;
+  StartPrefetch();
+  return true;
+}
+
+void LogReader::StartPrefetch() {
+  char *destination = buffers_[current_ ^ 1].get() + LOG_BUFFER_SIZE;
+  int64_t next_offset = chunk_offset_ + read_ahead_size_;
+  prefetch_ = std::async(std::launch::async, [this, destination, next_offset] {
+    return disk_manager_->ReadLog(destination, read_ahead_size_, next_offset);
+  });
+}
+
+void LogReader::CancelPrefetch() {
+  if (prefetch_.valid()) {
+    prefetch_.wait();
+    prefetch_ = std::future<bool>();
+  }
+}
+
+}  // namespace bustub
@@ -0,0 +1,285 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_record.cpp
+//
+// Identification: src/recovery/log_record.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "recovery/log_record.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace bustub {
+
+void LogRecord::SerializeTo(char *dest) const {
+  // The five header fields are laid out at the start of the object in serialization order.
+  memcpy(dest, this, HEADER_SIZE);
+  int pos = HEADER_SIZE;
+
+  switch (log_record_type_) {
+    case LogRecordType::INSERT:
+      memcpy(dest + pos, &insert_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      insert_tuple_.SerializeTo(dest + pos);
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      memcpy(dest + pos, &delete_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      delete_tuple_.SerializeTo(dest + pos);
+      break;
+    case LogRecordType::UPDATE:
+      memcpy(dest + pos, &update_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      old_tuple_.SerializeTo(dest + pos);
+      pos += sizeof(int32_t) + old_tuple_.GetLength();
+      new_tuple_.SerializeTo(dest + pos);
+      break;
+    case LogRecordType::DELTAUPDATE: {
+      memcpy(dest + pos, &update_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      uint32_t header[3] = {delta_old_size_, delta_new_size_, static_cast<uint32_t>(delta_ranges_.size())};
+      memcpy(dest + pos, header, sizeof(header));
+      pos += sizeof(header);
+      for (const auto &range : delta_ranges_) {
+        uint32_t range_header[3] = {range.offset_, range.old_length_, range.new_length_};
+        memcpy(dest + pos, range_header, sizeof(range_header));
+        pos += sizeof(range_header);
+        memcpy(dest + pos, range.old_bytes_, range.old_length_);
+        pos += range.old_length_;
+        memcpy(dest + pos, range.new_bytes_, range.new_length_);
+        pos += range.new_length_;
+      }
+      break;
+    }
+    case LogRecordType::ENDCHECKPOINT: {
+      auto txn_count = static_cast<uint32_t>(active_txns_.size());
+      memcpy(dest + pos, &txn_count, sizeof(uint32_t));
+      pos += sizeof(uint32_t);
+      memcpy(dest + pos, active_txns_.data(), txn_count * sizeof(std::pair<txn_id_t, lsn_t>));
+      pos += txn_count * sizeof(std::pair<txn_id_t, lsn_t>);
+      auto page_count = static_cast<uint32_t>(dirty_pages_.size());
+      memcpy(dest + pos, &page_count, sizeof(uint32_t));
+      pos += sizeof(uint32_t);
+      memcpy(dest + pos, dirty_pages_.data(), page_count * sizeof(std::pair<page_id_t, lsn_t>));
+      break;
+    }
+    case LogRecordType::NEWPAGE:
+      memcpy(dest + pos, &prev_page_id_, sizeof(page_id_t));
+      pos += sizeof(page_id_t);
+      memcpy(dest + pos, &page_id_, sizeof(page_id_t));
+      break;
+    case LogRecordType::BTREEINSERT:
+    case LogRecordType::BTREEDELETE:
+    case LogRecordType::BTREEPAGE:
+    case LogRecordType::BTREEROOT: {
+      memcpy(dest + pos, &btree_page_id_, sizeof(page_id_t));
+      pos += sizeof(page_id_t);
+      uint32_t header[3] = {btree_offset_, btree_index_, btree_length_};
+      memcpy(dest + pos, header, sizeof(header));
+      pos += sizeof(header);
+      memcpy(dest + pos, btree_bytes_, btree_length_);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+bool LogRecord::DeserializeFrom(const char *src, int available) {
+  if (available < HEADER_SIZE) {
+    return false;
+  }
+  int32_t size = *reinterpret_cast<const int32_t *>(src);
+  if (size < HEADER_SIZE || size > available) {
+    return false;
+  }
+  memcpy(static_cast<void *>(this), src, HEADER_SIZE);
+  int pos = HEADER_SIZE;
+
+  switch (log_record_type_) {
+    case LogRecordType::INSERT:
+      insert_rid_ = *reinterpret_cast<const RID *>(src + pos);
+      pos += sizeof(RID);
+      insert_tuple_.DeserializeViewFrom(src + pos);
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      delete_rid_ = *reinterpret_cast<const RID *>(src + pos);
+      pos += sizeof(RID);
+      delete_tuple_.DeserializeViewFrom(src + pos);
+      break;
+    case LogRecordType::UPDATE:
+      update_rid_ = *reinterpret_cast<const RID *>(src + pos);
+      pos += sizeof(RID);
+      old_tuple_.DeserializeViewFrom(src + pos);
+      pos += sizeof(int32_t) + old_tuple_.GetLength();
+      new_tuple_.DeserializeViewFrom(src + pos);
+      break;
+    case LogRecordType::DELTAUPDATE: {
+      update_rid_ = *reinterpret_cast<const RID *>(src + pos);
+      pos += sizeof(RID);
+      const auto *header = reinterpret_cast<const uint32_t *>(src + pos);
+      delta_old_size_ = header[0];
+      delta_new_size_ = header[1];
+      uint32_t range_count = header[2];
+      pos += 3 * sizeof(uint32_t);
+      delta_ranges_.clear();
+      delta_ranges_.reserve(range_count);
+      for (uint32_t i = 0; i < range_count; i++) {
+        const auto *range_header = reinterpret_cast<const uint32_t *>(src + pos);
+        pos += 3 * sizeof(uint32_t);
+        DeltaRange range{range_header[0], range_header[1], range_header[2], src + pos, src + pos + range_header[1]};
+        pos += range.old_length_ + range.new_length_;
+        if (pos > size) {
+          return false;
+        }
+        delta_ranges_.push_back(range);
+      }
+      break;
+    }
+    case LogRecordType::ENDCHECKPOINT: {
+      uint32_t txn_count = *reinterpret_cast<const uint32_t *>(src + pos);
+      pos += sizeof(uint32_t);
+      if (pos + txn_count * sizeof(std::pair<txn_id_t, lsn_t>) + sizeof(uint32_t) > static_cast<size_t>(size)) {
+        return false;
+      }
+      const auto *txns = reinterpret_cast<const std::pair<txn_id_t, lsn_t> *>(src + pos);
+      active_txns_.assign(txns, txns + txn_count);
+      pos += txn_count * sizeof(std::pair<txn_id_t, lsn_t>);
+      uint32_t page_count = *reinterpret_cast<const uint32_t *>(src + pos);
+      pos += sizeof(uint32_t);
+      if (pos + page_count * sizeof(std::pair<page_id_t, lsn_t>) > static_cast<size_t>(size)) {
+        return false;
+      }
+      const auto *pages = reinterpret_cast<const std::pair<page_id_t, lsn_t> *>(src + pos);
+      dirty_pages_.assign(pages, pages + page_count);
+      break;
+    }
+    case LogRecordType::NEWPAGE:
+      prev_page_id_ = *reinterpret_cast<const page_id_t *>(src + pos);
+      pos += sizeof(page_id_t);
+      page_id_ = *reinterpret_cast<const page_id_t *>(src + pos);
+      break;
+    case LogRecordType::BTREEINSERT:
+    case LogRecordType::BTREEDELETE:
+    case LogRecordType::BTREEPAGE:
+    case LogRecordType::BTREEROOT: {
+      btree_page_id_ = *reinterpret_cast<const page_id_t *>(src + pos);
+      pos += sizeof(page_id_t);
+      const auto *header = reinterpret_cast<const uint32_t *>(src + pos);
+      btree_offset_ = header[0];
+      btree_index_ = header[1];
+      btree_length_ = header[2];
+      pos += 3 * sizeof(uint32_t);
+      if (pos + btree_length_ > static_cast<uint32_t>(size)) {
+        return false;
+      }
+      btree_bytes_ = src + pos;
+      break;
+    }
+    default:
+      break;
+  }
+  return true;
+}
+
+Tuple LogRecord::ApplyDelta(const Tuple &image, bool redo) const {
+  assert(log_record_type_ == LogRecordType::DELTAUPDATE);
+  assert(image.GetLength() == (redo ? delta_old_size_ : delta_new_size_));
+  const uint32_t result_size = redo ? delta_new_size_ : delta_old_size_;
+  // Laid out as a serialized tuple so that the result can be deserialized in one copy.
+  std::vector<char> result(sizeof(int32_t) + result_size);
+  memcpy(result.data(), &result_size, sizeof(int32_t));
+
+  const char *in = image.GetData();
+  char *out = result.data() + sizeof(int32_t);
+  uint32_t in_pos = 0;
+  // Offsets are positions in the old tuple; in the new tuple they are shifted by the size change of earlier ranges.
+  int64_t shift = 0;
+  for (const auto &range : delta_ranges_) {
+    uint32_t start = redo ? range.offset_ : static_cast<uint32_t>(range.offset_ + shift);
+    memcpy(out, in + in_pos, start - in_pos);
+    out += start - in_pos;
+    uint32_t length = redo ? range.new_length_ : range.old_length_;
+    memcpy(out, redo ? range.new_bytes_ : range.old_bytes_, length);
+    out += length;
+    in_pos = start + (redo ? range.old_length_ : range.new_length_);
+    shift += static_cast<int64_t>(range.new_length_) - range.old_length_;
+  }
+  memcpy(out, in + in_pos, image.GetLength() - in_pos);
+
+  Tuple tuple;
+  tuple.DeserializeFrom(result.data());
+  return tuple;
+}
+
+void LogRecord::ComputeDelta() {
+  // A range costs three integers, so equal runs shorter than that are cheaper to log as part of a range.
+  const uint32_t merge_gap = 3 * sizeof(uint32_t);
+  const char *old_data = old_tuple_.GetData();
+  const char *new_data = new_tuple_.GetData();
+  delta_old_size_ = old_tuple_.GetLength();
+  delta_new_size_ = new_tuple_.GetLength();
+  delta_ranges_.clear();
+
+  uint32_t common = std::min(delta_old_size_, delta_new_size_);
+  uint32_t prefix = 0;
+  while (prefix < common && old_data[prefix] == new_data[prefix]) {
+    prefix++;
+  }
+  uint32_t suffix = 0;
+  while (suffix < common - prefix &&
+         old_data[delta_old_size_ - 1 - suffix] == new_data[delta_new_size_ - 1 - suffix]) {
+    suffix++;
+  }
+  uint32_t old_end = delta_old_size_ - suffix;
+  uint32_t new_end = delta_new_size_ - suffix;
+
+  if (old_end - prefix != new_end - prefix) {
+    // The tuple changed size, so the bytes in between cannot be lined up; log them as one range.
+    delta_ranges_.push_back({prefix, old_end - prefix, new_end - prefix, old_data + prefix, new_data + prefix});
+  } else {
+    uint32_t i = prefix;
+    while (i < old_end) {
+      uint32_t start = i;
+      uint32_t last_diff = i;
+      // Extend the range while the next difference is within merge_gap bytes.
+      while (i < old_end && i - last_diff <= merge_gap) {
+        if (old_data[i] != new_data[i]) {
+          last_diff = i;
+        }
+        i++;
+      }
+      uint32_t length = last_diff + 1 - start;
+      delta_ranges_.push_back({start, length, length, old_data + start, new_data + start});
+      // Skip to the next difference.
+      i = last_diff + 1;
+      while (i < old_end && old_data[i] == new_data[i]) {
+        i++;
+      }
+    }
+  }
+
+  int32_t delta_size = HEADER_SIZE + sizeof(RID) + 3 * sizeof(uint32_t);
+  for (const auto &range : delta_ranges_) {
+    delta_size += 3 * sizeof(uint32_t) + range.old_length_ + range.new_length_;
+  }
+  if (delta_size >= size_) {
+    log_record_type_ = LogRecordType::UPDATE;
+    delta_ranges_.clear();
+    return;
+  }
+  size_ = delta_size;
+}
+
+}  // namespace bustub
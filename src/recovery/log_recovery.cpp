@@ -12,7 +12,15 @@
 
 #include "recovery/log_recovery.h"
 
-#include "storage/page/table_page.h"
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "storage/page/b_plus_tree_page.h"
+#include "storage/page/header_page.h"
 
 namespace bustub {
 /*
@@ -20,7 +28,82 @@ namespace bustub {
  * @return: true means deserialize succeed, otherwise can't deserialize cause
  * incomplete log record
  */
-bool LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record) { return false; }
+bool LogRecovery::DeserializeLogRecord(const char *data, int size, LogRecord *log_record) {
+  return log_record->DeserializeFrom(data, size);
+}
+
+page_id_t LogRecovery::GetRecordPageId(LogRecord *log_record) {
+  switch (log_record->GetLogRecordType()) {
+    case LogRecordType::INSERT:
+      return log_record->GetInsertRID().GetPageId();
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      return log_record->GetDeleteRID().GetPageId();
+    case LogRecordType::UPDATE:
+    case LogRecordType::DELTAUPDATE:
+      return log_record->GetUpdateRID().GetPageId();
+    case LogRecordType::NEWPAGE:
+      return log_record->GetNewPageId();
+    case LogRecordType::BTREEINSERT:
+    case LogRecordType::BTREEDELETE:
+    case LogRecordType::BTREEPAGE:
+      return log_record->GetBTreePageId();
+    case LogRecordType::BTREEROOT:
+      return HEADER_PAGE_ID;
+    default:
+      return INVALID_PAGE_ID;
+  }
+}
+
+void LogRecovery::Analyze(const std::function<void(page_id_t, const char *, int)> &dispatch) {
+  active_txn_.clear();
+  lsn_mapping_.clear();
+  redo_lsn_ = 0;
+
+  LogReader reader(disk_manager_);
+  LogRecord log_record;
+  const char *data;
+  int64_t offset;
+  while (reader.Next(&log_record, &data, &offset)) {
+    lsn_t lsn = log_record.GetLSN();
+    lsn_mapping_[lsn] = offset;
+
+    switch (log_record.GetLogRecordType()) {
+      case LogRecordType::BEGINCHECKPOINT:
+      case LogRecordType::BTREEINSERT:
+      case LogRecordType::BTREEDELETE:
+      case LogRecordType::BTREEPAGE:
+      case LogRecordType::BTREEROOT:
+        break;
+      case LogRecordType::ENDCHECKPOINT:
+        // Everything older than the checkpoint's oldest recLSN is already in the data pages.
+        redo_lsn_ = log_record.GetPrevLSN();
+        for (auto &entry : log_record.GetDirtyPages()) {
+          redo_lsn_ = std::min(redo_lsn_, entry.second);
+        }
+        break;
+      case LogRecordType::COMMIT:
+      case LogRecordType::ABORT:
+        active_txn_.erase(log_record.GetTxnId());
+        break;
+      default:
+        active_txn_[log_record.GetTxnId()] = lsn;
+        break;
+    }
+
+    page_id_t page_id = GetRecordPageId(&log_record);
+    if (page_id == INVALID_PAGE_ID) {
+      continue;
+    }
+    dispatch(page_id, data, log_record.GetSize());
+    // A new page is also linked into its predecessor.
+    page_id_t prev_page_id = log_record.GetNewPageRecord();
+    if (log_record.GetLogRecordType() == LogRecordType::NEWPAGE && prev_page_id != INVALID_PAGE_ID) {
+      dispatch(prev_page_id, data, log_record.GetSize());
+    }
+  }
+}
 
 /*
  *redo phase on TABLE PAGE level(table/table_page.h)
@@ -29,12 +112,316 @@ bool LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record)
  *LSN with log_record's sequence number, and also build active_txn_ table &
  *lsn_mapping_ table
  */
-void LogRecovery::Redo() {}
+void LogRecovery::Redo() {
+  BUSTUB_ASSERT(!enable_logging, "Recovery has to finish before logging is turned on.");
+
+  // Analysis: one sequential scan that also splits the page-level records by page.
+  std::vector<std::vector<char>> partitions(num_workers_);
+  Analyze([&](page_id_t page_id, const char *data, int size) {
+    auto &partition = partitions[page_id % num_workers_];
+    auto *id = reinterpret_cast<const char *>(&page_id);
+    partition.insert(partition.end(), id, id + sizeof(page_id_t));
+    partition.insert(partition.end(), data, data + size);
+  });
+
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < num_workers_; i++) {
+    workers.emplace_back([&, i] {
+      Transaction txn(INVALID_TXN_ID);
+      RedoPartition(partitions[i], &txn);
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+void LogRecovery::RedoPartition(const std::vector<char> &records, Transaction *txn) {
+  LogRecord log_record;
+  size_t pos = 0;
+  while (pos < records.size()) {
+    page_id_t page_id = *reinterpret_cast<const page_id_t *>(records.data() + pos);
+    pos += sizeof(page_id_t);
+    DeserializeLogRecord(records.data() + pos, records.size() - pos, &log_record);
+    pos += log_record.GetSize();
+    if (log_record.GetLSN() < redo_lsn_) {
+      continue;
+    }
+    auto *page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+    page->WLatch();
+    bool dirty = RedoOnPage(&log_record, page, page_id, txn);
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page_id, dirty);
+  }
+}
+
+bool LogRecovery::RedoOnPage(LogRecord *log_record, TablePage *page, page_id_t page_id, Transaction *txn) {
+  lsn_t lsn = log_record->GetLSN();
+
+  if (log_record->GetLogRecordType() == LogRecordType::NEWPAGE && page_id != log_record->GetNewPageId()) {
+    // The link is not covered by the predecessor's LSN, but setting it again is harmless.
+    if (page->GetNextPageId() == log_record->GetNewPageId()) {
+      return false;
+    }
+    page->SetNextPageId(log_record->GetNewPageId());
+    return true;
+  }
+  if (log_record->GetLogRecordType() == LogRecordType::BTREEROOT) {
+    // The header page has no LSN, but the root records are replayed in order and the last one wins.
+    auto *header_page = reinterpret_cast<HeaderPage *>(static_cast<Page *>(page));
+    std::string index_name(log_record->GetBTreeBytes(), log_record->GetBTreeLength());
+    page_id_t root_page_id;
+    if (header_page->GetRootId(index_name, &root_page_id) && root_page_id == log_record->GetBTreePageId()) {
+      return false;
+    }
+    if (!header_page->InsertRecord(index_name, log_record->GetBTreePageId())) {
+      header_page->UpdateRecord(index_name, log_record->GetBTreePageId());
+    }
+    return true;
+  }
+  if (page->GetLSN() >= lsn) {
+    return false;
+  }
+
+  switch (log_record->GetLogRecordType()) {
+    case LogRecordType::NEWPAGE:
+      page->Init(page_id, PAGE_SIZE, log_record->GetNewPageRecord(), nullptr, txn);
+      break;
+    case LogRecordType::INSERT: {
+      RID rid;
+      page->InsertTuple(log_record->GetInsertTuple(), &rid, txn, nullptr, nullptr);
+      BUSTUB_ASSERT(rid == log_record->GetInsertRID(), "Redo has to reproduce the logged slot.");
+      break;
+    }
+    case LogRecordType::MARKDELETE:
+      page->MarkDelete(log_record->GetDeleteRID(), txn, nullptr, nullptr);
+      break;
+    case LogRecordType::APPLYDELETE:
+      page->ApplyDelete(log_record->GetDeleteRID(), txn, nullptr);
+      break;
+    case LogRecordType::ROLLBACKDELETE:
+      page->RollbackDelete(log_record->GetDeleteRID(), txn, nullptr);
+      break;
+    case LogRecordType::UPDATE: {
+      Tuple old_tuple;
+      page->UpdateTuple(log_record->GetUpdateTuple(), &old_tuple, log_record->GetUpdateRID(), txn, nullptr, nullptr);
+      break;
+    }
+    case LogRecordType::DELTAUPDATE: {
+      Tuple old_tuple;
+      if (page->GetTuple(log_record->GetUpdateRID(), &old_tuple, txn, nullptr)) {
+        Tuple new_tuple = log_record->ApplyDelta(old_tuple, true);
+        page->UpdateTuple(new_tuple, &old_tuple, log_record->GetUpdateRID(), txn, nullptr, nullptr);
+      }
+      break;
+    }
+    case LogRecordType::BTREEINSERT:
+    case LogRecordType::BTREEDELETE:
+    case LogRecordType::BTREEPAGE:
+      RedoBTreeRecord(log_record, page->GetData());
+      break;
+    default:
+      break;
+  }
+  page->SetLSN(lsn);
+  return true;
+}
+
+void LogRecovery::RedoBTreeRecord(LogRecord *log_record, char *data) {
+  if (log_record->GetLogRecordType() == LogRecordType::BTREEPAGE) {
+    memcpy(data + log_record->GetBTreeOffset(), log_record->GetBTreeBytes(), log_record->GetBTreeLength());
+    return;
+  }
+  auto *node = reinterpret_cast<BPlusTreePage *>(data);
+  char *array = data + log_record->GetBTreeOffset();
+  const uint32_t entry_size = log_record->GetBTreeLength();
+  const uint32_t index = log_record->GetBTreeIndex();
+  const auto size = static_cast<uint32_t>(node->GetSize());
+  if (log_record->GetLogRecordType() == LogRecordType::BTREEINSERT) {
+    memmove(array + (index + 1) * entry_size, array + index * entry_size, (size - index) * entry_size);
+    memcpy(array + index * entry_size, log_record->GetBTreeBytes(), entry_size);
+    node->IncreaseSize(1);
+  } else {
+    memmove(array + index * entry_size, array + (index + 1) * entry_size, (size - index - 1) * entry_size);
+    node->IncreaseSize(-1);
+  }
+}
+
+void LogRecovery::StartInstantRestart() {
+  BUSTUB_ASSERT(!enable_logging, "Recovery has to finish before logging is turned on.");
+  BUSTUB_ASSERT(background_recovery_ == nullptr, "Instant restart is already running.");
+  {
+    std::lock_guard<std::mutex> guard(pending_latch_);
+    pending_pages_.clear();
+    Analyze([&](page_id_t page_id, const char *data, int size) {
+      auto &records = pending_pages_[page_id];
+      records.insert(records.end(), data, data + size);
+    });
+  }
+
+  buffer_pool_manager_->SetPageLoadHook([this](Page *page) { return RecoverPage(page); });
+  background_recovery_ = new std::thread([this] { RecoverRemainingPages(); });
+  // The losers' pages are recovered on demand when undo fetches them.
+  Undo();
+}
+
+void LogRecovery::FinishInstantRestart() {
+  if (background_recovery_ == nullptr) {
+    return;
+  }
+  background_recovery_->join();
+  delete background_recovery_;
+  background_recovery_ = nullptr;
+  buffer_pool_manager_->SetPageLoadHook(nullptr);
+}
+
+size_t LogRecovery::GetPendingPageCount() {
+  std::lock_guard<std::mutex> guard(pending_latch_);
+  return pending_pages_.size();
+}
+
+bool LogRecovery::RecoverPage(Page *page) {
+  page_id_t page_id = page->GetPageId();
+  std::vector<char> records = TakePendingRecords(page_id);
+  return RedoPendingRecords(records, reinterpret_cast<TablePage *>(page), page_id);
+}
+
+std::vector<char> LogRecovery::TakePendingRecords(page_id_t page_id) {
+  std::lock_guard<std::mutex> guard(pending_latch_);
+  auto it = pending_pages_.find(page_id);
+  if (it == pending_pages_.end()) {
+    return {};
+  }
+  std::vector<char> records = std::move(it->second);
+  pending_pages_.erase(it);
+  return records;
+}
+
+bool LogRecovery::RedoPendingRecords(const std::vector<char> &records, TablePage *page, page_id_t page_id) {
+  Transaction txn(INVALID_TXN_ID);
+  LogRecord log_record;
+  bool dirty = false;
+  size_t pos = 0;
+  while (pos < records.size()) {
+    DeserializeLogRecord(records.data() + pos, records.size() - pos, &log_record);
+    pos += log_record.GetSize();
+    if (log_record.GetLSN() >= redo_lsn_) {
+      dirty |= RedoOnPage(&log_record, page, page_id, &txn);
+    }
+  }
+  return dirty;
+}
+
+void LogRecovery::RecoverRemainingPages() {
+  while (true) {
+    page_id_t page_id;
+    {
+      std::lock_guard<std::mutex> guard(pending_latch_);
+      if (pending_pages_.empty()) {
+        return;
+      }
+      page_id = pending_pages_.begin()->first;
+    }
+    // Fetching the page runs the hook, unless a query beat us to it.
+    Page *page = buffer_pool_manager_->FetchPage(page_id);
+    if (page == nullptr) {
+      // Every frame is pinned by someone else; try again once they are done.
+      std::this_thread::yield();
+      continue;
+    }
+    page->WLatch();
+    // Only left over if the page was resident already, which StartInstantRestart rules out; stay safe regardless.
+    bool dirty = RedoPendingRecords(TakePendingRecords(page_id), reinterpret_cast<TablePage *>(page), page_id);
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page_id, dirty);
+  }
+}
 
 /*
  *undo phase on TABLE PAGE level(table/table_page.h)
  *iterate through active txn map and undo each operation
  */
-void LogRecovery::Undo() {}
+void LogRecovery::Undo() {
+  std::vector<lsn_t> losers;
+  losers.reserve(active_txn_.size());
+  for (auto &entry : active_txn_) {
+    losers.push_back(entry.second);
+  }
+
+  std::atomic<size_t> next_loser{0};
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < std::min(num_workers_, losers.size()); i++) {
+    workers.emplace_back([&] {
+      Transaction txn(INVALID_TXN_ID);
+      LogReader reader(disk_manager_);
+      for (size_t loser = next_loser++; loser < losers.size(); loser = next_loser++) {
+        UndoTransaction(losers[loser], &reader, &txn);
+      }
+    });
+  }
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  active_txn_.clear();
+}
+
+void LogRecovery::UndoTransaction(lsn_t last_lsn, LogReader *reader, Transaction *txn) {
+  LogRecord log_record;
+  lsn_t lsn = last_lsn;
+  while (lsn != INVALID_LSN) {
+    auto it = lsn_mapping_.find(lsn);
+    if (it == lsn_mapping_.end() || !reader->ReadAt(it->second, &log_record)) {
+      break;
+    }
+    UndoLogRecord(&log_record, txn);
+    lsn = log_record.GetPrevLSN();
+  }
+}
+
+void LogRecovery::UndoLogRecord(LogRecord *log_record, Transaction *txn) {
+  page_id_t page_id = GetRecordPageId(log_record);
+  if (page_id == INVALID_PAGE_ID || log_record->GetLogRecordType() == LogRecordType::NEWPAGE) {
+    return;
+  }
+
+  auto *page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+  page->WLatch();
+  switch (log_record->GetLogRecordType()) {
+    case LogRecordType::INSERT: {
+      // The insert may already have been rolled back by an abort that did not finish.
+      Tuple tuple;
+      if (page->GetTuple(log_record->GetInsertRID(), &tuple, txn, nullptr)) {
+        page->ApplyDelete(log_record->GetInsertRID(), txn, nullptr);
+      }
+      break;
+    }
+    case LogRecordType::MARKDELETE:
+      page->RollbackDelete(log_record->GetDeleteRID(), txn, nullptr);
+      break;
+    case LogRecordType::ROLLBACKDELETE:
+      page->MarkDelete(log_record->GetDeleteRID(), txn, nullptr, nullptr);
+      break;
+    case LogRecordType::APPLYDELETE:
+      // A loser only applies deletes while rolling back its own inserts, which the INSERT case above undoes as well.
+      break;
+    case LogRecordType::UPDATE: {
+      Tuple new_tuple;
+      page->UpdateTuple(log_record->GetOriginalTuple(), &new_tuple, log_record->GetUpdateRID(), txn, nullptr, nullptr);
+      break;
+    }
+    case LogRecordType::DELTAUPDATE: {
+      Tuple new_tuple;
+      if (page->GetTuple(log_record->GetUpdateRID(), &new_tuple, txn, nullptr)) {
+        Tuple old_tuple = log_record->ApplyDelta(new_tuple, false);
+        page->UpdateTuple(old_tuple, &new_tuple, log_record->GetUpdateRID(), txn, nullptr, nullptr);
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id, true);
+}
 
 }  // namespace bustub
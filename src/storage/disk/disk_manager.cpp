@@ -11,11 +11,14 @@
 //===----------------------------------------------------------------------===//
 
 #include <sys/stat.h>
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
 #include <cstring>
 #include <iostream>
 #include <string>
 #include <thread>  // NOLINT
+#include <vector>
 
 #include "common/exception.h"
 #include "common/logger.h"
@@ -29,7 +32,7 @@ static char *buffer_used;
  * Constructor: open/create a single database file & log file
  * @input db_file: database file name
  */
-DiskManager::DiskManager(const std::string &db_file)
+DiskManager::DiskManager(const std::string &db_file, int log_segment_size)
     : file_name_(db_file), next_page_id_(0), num_flushes_(0), num_writes_(0), flush_log_(false), flush_log_f_(nullptr) {
   std::string::size_type n = file_name_.rfind('.');
   if (n == std::string::npos) {
@@ -37,20 +40,26 @@ DiskManager::DiskManager(const std::string &db_file)
     return;
   }
   log_name_ = file_name_.substr(0, n) + ".log";
+  log_segment_size_ = std::max(log_segment_size, LOG_BUFFER_SIZE);
 
-  log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
-  // directory or file does not exist
-  if (!log_io_.is_open()) {
-    log_io_.clear();
-    // create a new file
-    log_io_.open(log_name_, std::ios::binary | std::ios::trunc | std::ios::app | std::ios::out);
-    log_io_.close();
-    // reopen with original mode
-    log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
-    if (!log_io_.is_open()) {
-      throw Exception("can't open dblog file");
+  std::ifstream control(log_name_, std::ios::binary);
+  int64_t log_end = 0;
+  if (control.is_open()) {
+    int64_t header[3];
+    control.read(reinterpret_cast<char *>(header), sizeof(header));
+    if (control.gcount() != sizeof(header)) {
+      throw Exception("can't read dblog control file");
     }
+    log_segment_size_ = static_cast<int>(header[0]);
+    log_start_segment_ = header[1];
+    log_end = FindLogEnd(std::max(header[2], log_start_segment_ * log_segment_size_));
+  } else {
+    // A new log. Segment files left over from an earlier log are reused like recycled ones; the end marker that
+    // OpenLogSegment writes hides their old content.
+    log_start_segment_ = 0;
   }
+  OpenLogSegment(log_end / log_segment_size_, static_cast<int>(log_end % log_segment_size_));
+  WriteLogControl();
 
   db_io_.open(db_file, std::ios::binary | std::ios::in | std::ios::out);
   // directory or file does not exist
@@ -73,7 +82,13 @@ DiskManager::DiskManager(const std::string &db_file)
  */
 void DiskManager::ShutDown() {
   db_io_.close();
+  std::lock_guard<std::mutex> guard(log_latch_);
+  if (log_io_.is_open()) {
+    // Remember the end of the log, so that the next start does not have to search for it.
+    WriteLogControl();
+  }
   log_io_.close();
+  log_read_io_.close();
 }
 
 /**
@@ -83,6 +98,7 @@ void DiskManager::WritePage(page_id_t page_id, const char *page_data) {
   size_t offset = static_cast<size_t>(page_id) * PAGE_SIZE;
   // set write cursor to offset
   num_writes_ += 1;
+  deallocated_pages_.erase(page_id);
   db_io_.seekp(offset);
   db_io_.write(page_data, PAGE_SIZE);
   // check for I/O error
@@ -99,10 +115,17 @@ void DiskManager::WritePage(page_id_t page_id, const char *page_data) {
  */
 void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
   int offset = page_id * PAGE_SIZE;
+  if (deallocated_pages_.count(page_id) > 0) {
+    // ids are not handed out again, a stale id must not find what the page held before
+    memset(page_data, 0, PAGE_SIZE);
+    return;
+  }
   // check if read beyond file length
   if (offset > GetFileSize(file_name_)) {
     LOG_DEBUG("I/O error reading past end of file");
     // std::cerr << "I/O error while reading" << std::endl;
+    // the page was allocated but never written, e.g. before a crash
+    memset(page_data, 0, PAGE_SIZE);
   } else {
     // set read cursor to offset
     db_io_.seekp(offset);
@@ -126,13 +149,17 @@ void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
  * Write the contents of the log into disk file
  * Only return when sync is done, and only perform sequence write
  */
-void DiskManager::WriteLog(char *log_data, int size) {
+int64_t DiskManager::WriteLog(char *log_data, int size) {
   // enforce swap log buffer
   assert(log_data != buffer_used);
   buffer_used = log_data;
 
+  std::lock_guard<std::mutex> guard(log_latch_);
   if (size == 0) {  // no effect on num_flushes_ if log buffer is empty
-    return;
+    return log_segment_ * log_segment_size_ + log_position_;
+  }
+  if (size > log_segment_size_) {
+    throw Exception(ExceptionType::OUT_OF_RANGE, "log write is larger than a log segment");
   }
 
   flush_log_ = true;
@@ -142,18 +169,41 @@ void DiskManager::WriteLog(char *log_data, int size) {
     assert(flush_log_f_->wait_for(std::chrono::seconds(10)) == std::future_status::ready);
   }
 
+  if (size > log_segment_size_ - log_position_) {
+    // Records never straddle segments, so a reader can start at any segment. The new segment gets its end of log
+    // marker before the old one points to it.
+    std::fstream old_segment = std::move(log_io_);
+    int old_position = log_position_;
+    OpenLogSegment(log_segment_ + 1, 0);
+    old_segment.seekp(old_position);
+    old_segment.write(reinterpret_cast<const char *>(&LOG_SEGMENT_END), sizeof(int32_t));
+    old_segment.flush();
+  }
+
   num_flushes_ += 1;
-  // sequence write
+  int64_t offset = log_segment_ * log_segment_size_ + log_position_;
+  // sequence write, followed by the end of log marker that the next write overwrites
+  log_io_.seekp(log_position_);
   log_io_.write(log_data, size);
+  log_position_ += size;
+  static const int32_t end_of_log = 0;
+  if (log_segment_size_ - log_position_ >= static_cast<int>(sizeof(int32_t))) {
+    log_io_.write(reinterpret_cast<const char *>(&end_of_log), sizeof(int32_t));
+  }
 
   // check for I/O error
   if (log_io_.bad()) {
     LOG_DEBUG("I/O error while writing log");
-    return;
+    return offset;
   }
   // needs to flush to keep disk file in sync
   log_io_.flush();
+  if (log_segment_size_ - log_position_ < static_cast<int>(sizeof(int32_t))) {
+    // No room left for a marker, move on now so the end of the log is always marked.
+    OpenLogSegment(log_segment_ + 1, 0);
+  }
   flush_log_ = false;
+  return offset;
 }
 
 /**
@@ -161,29 +211,157 @@ void DiskManager::WriteLog(char *log_data, int size) {
  * Always read from the beginning and perform sequence read
  * @return: false means already reach the end
  */
-bool DiskManager::ReadLog(char *log_data, int size, int offset) {
-  if (offset >= GetFileSize(log_name_)) {
-    // LOG_DEBUG("end of log file");
-    // LOG_DEBUG("file size is %d", GetFileSize(log_name_));
-    return false;
-  }
-  log_io_.seekp(offset);
-  log_io_.read(log_data, size);
-
-  if (log_io_.bad()) {
-    LOG_DEBUG("I/O error while reading log");
+bool DiskManager::ReadLog(char *log_data, int size, int64_t offset) {
+  std::lock_guard<std::mutex> guard(log_latch_);
+  int64_t log_end = log_segment_ * log_segment_size_ + log_position_;
+  if (offset < log_start_segment_ * log_segment_size_ || offset >= log_end) {
     return false;
   }
+  int read_count = static_cast<int>(std::min<int64_t>(size, log_end - offset));
+  ReadLogSegments(log_data, read_count, offset);
   // if log file ends before reading "size"
-  int read_count = log_io_.gcount();
   if (read_count < size) {
-    log_io_.clear();
     memset(log_data + read_count, 0, size - read_count);
   }
-
   return true;
 }
 
+void DiskManager::TruncateLog(int64_t offset) {
+  std::lock_guard<std::mutex> guard(log_latch_);
+  int64_t new_start = std::min(offset / log_segment_size_, log_segment_);
+  if (new_start <= log_start_segment_) {
+    return;
+  }
+  int64_t old_start = log_start_segment_;
+  log_start_segment_ = new_start;
+  // The control file goes first: a crash in between must not leave it pointing to a renamed segment.
+  WriteLogControl();
+  if (log_read_segment_ < new_start) {
+    log_read_io_.close();
+    log_read_segment_ = -1;
+  }
+
+  int64_t spare = log_segment_ + 1;
+  while (GetFileSize(GetLogSegmentName(spare)) >= 0) {
+    spare++;
+  }
+  for (int64_t segment = old_start; segment < new_start; segment++) {
+    std::string name = GetLogSegmentName(segment);
+    bool keep = spare - log_segment_ <= MAX_SPARE_LOG_SEGMENTS;
+    if (keep && std::rename(name.c_str(), GetLogSegmentName(spare).c_str()) == 0) {
+      spare++;
+    } else {
+      std::remove(name.c_str());
+    }
+  }
+}
+
+int64_t DiskManager::GetLogStartOffset() {
+  std::lock_guard<std::mutex> guard(log_latch_);
+  return log_start_segment_ * log_segment_size_;
+}
+
+int64_t DiskManager::GetLogEndOffset() {
+  std::lock_guard<std::mutex> guard(log_latch_);
+  return log_segment_ * log_segment_size_ + log_position_;
+}
+
+std::string DiskManager::GetLogSegmentName(int64_t segment) const {
+  char suffix[32];
+  snprintf(suffix, sizeof(suffix), ".%06ld", static_cast<long>(segment));  // NOLINT
+  return log_name_ + suffix;
+}
+
+void DiskManager::OpenLogSegment(int64_t segment, int position) {
+  std::string name = GetLogSegmentName(segment);
+  log_io_.close();
+  if (GetFileSize(name) < 0) {
+    // Write the whole file once, so that later log writes do not have to extend it.
+    std::ofstream create(name, std::ios::binary | std::ios::trunc);
+    std::vector<char> zeros(PAGE_SIZE, 0);
+    for (int written = 0; written < log_segment_size_; written += PAGE_SIZE) {
+      create.write(zeros.data(), std::min(PAGE_SIZE, log_segment_size_ - written));
+    }
+  } else if (position == 0) {
+    num_recycled_segments_++;
+  }
+  log_io_.open(name, std::ios::binary | std::ios::in | std::ios::out);
+  if (!log_io_.is_open()) {
+    throw Exception("can't open dblog file");
+  }
+  log_segment_ = segment;
+  log_position_ = position;
+  if (log_segment_size_ - position >= static_cast<int>(sizeof(int32_t))) {
+    // A reused segment still holds old records; they must not look like a continuation of the log.
+    static const int32_t end_of_log = 0;
+    log_io_.seekp(position);
+    log_io_.write(reinterpret_cast<const char *>(&end_of_log), sizeof(int32_t));
+    log_io_.flush();
+  }
+}
+
+void DiskManager::ReadLogSegments(char *log_data, int size, int64_t offset) {
+  while (size > 0) {
+    int64_t segment = offset / log_segment_size_;
+    int position = static_cast<int>(offset % log_segment_size_);
+    int count = std::min(size, log_segment_size_ - position);
+    if (segment != log_read_segment_) {
+      log_read_io_.close();
+      log_read_io_.clear();
+      log_read_io_.open(GetLogSegmentName(segment), std::ios::binary);
+      log_read_segment_ = segment;
+    }
+    int read_count = 0;
+    if (log_read_io_.is_open()) {
+      log_read_io_.clear();
+      log_read_io_.seekg(position);
+      log_read_io_.read(log_data, count);
+      read_count = static_cast<int>(log_read_io_.gcount());
+      if (log_read_io_.bad()) {
+        LOG_DEBUG("I/O error while reading log");
+      }
+    }
+    memset(log_data + read_count, 0, count - read_count);
+    log_data += count;
+    offset += count;
+    size -= count;
+  }
+}
+
+int64_t DiskManager::FindLogEnd(int64_t offset) {
+  while (true) {
+    int64_t segment = offset / log_segment_size_;
+    int position = static_cast<int>(offset % log_segment_size_);
+    int32_t length = 0;
+    if (log_segment_size_ - position >= static_cast<int>(sizeof(int32_t))) {
+      if (GetFileSize(GetLogSegmentName(segment)) < 0) {
+        return offset;
+      }
+      ReadLogSegments(reinterpret_cast<char *>(&length), sizeof(int32_t), offset);
+    } else {
+      length = LOG_SEGMENT_END;
+    }
+    if (length == LOG_SEGMENT_END) {
+      offset = (segment + 1) * log_segment_size_;
+    } else if (length <= 0 || length > log_segment_size_ - position) {
+      return offset;
+    } else {
+      offset += length;
+    }
+  }
+}
+
+void DiskManager::WriteLogControl() {
+  int64_t header[3] = {log_segment_size_, log_start_segment_, log_segment_ * log_segment_size_ + log_position_};
+  std::string temp_name = log_name_ + ".tmp";
+  {
+    std::ofstream control(temp_name, std::ios::binary | std::ios::trunc);
+    control.write(reinterpret_cast<const char *>(header), sizeof(header));
+  }
+  // rename replaces the old control file atomically
+  std::rename(temp_name.c_str(), log_name_.c_str());
+}
+
 /**
  * Allocate new page (operations like create index/table)
  * For now just keep an increasing counter
@@ -193,9 +371,9 @@ page_id_t DiskManager::AllocatePage() { return next_page_id_++; }
 /**
  * Deallocate page (operations like drop index/table)
  * Need bitmap in header page for tracking pages
- * This does not actually need to do anything for now.
+ * For now the space is not reused, the page only reads as zeros from here on.
  */
-void DiskManager::DeallocatePage(__attribute__((unused)) page_id_t page_id) {}
+void DiskManager::DeallocatePage(page_id_t page_id) { deallocated_pages_.insert(page_id); }
 
 /**
  * Returns number of flushes made so far
@@ -9,6 +9,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <string>
 
 #include <thread>
@@ -23,14 +24,18 @@
 namespace bustub {
 INDEX_TEMPLATE_ARGUMENTS
 BPLUSTREE_TYPE::BPlusTree(std::string name, BufferPoolManager *buffer_pool_manager, const KeyComparator &comparator,
-                          int leaf_max_size, int internal_max_size)
+                          int leaf_max_size, int internal_max_size, LogManager *log_manager, bool blink, bool unique)
     : index_name_(std::move(name)),
       root_page_id_(HEADER_PAGE_ID),
       buffer_pool_manager_(buffer_pool_manager),
       comparator_(comparator),
       leaf_max_size_(leaf_max_size),
-      internal_max_size_(internal_max_size) {
-          LOG_INFO("[BPlusTree] leaf_max_size = %d, internal_max_size = %d.\n", leaf_max_size, internal_max_size);
+      internal_max_size_(internal_max_size),
+      log_manager_(log_manager),
+      blink_(blink),
+      unique_(unique) {
+          LOG_INFO("[BPlusTree] leaf_max_size = %d, internal_max_size = %d, unique = %d.\n", leaf_max_size,
+                   internal_max_size, unique);
       }
 
 /*
@@ -38,82 +43,171 @@ BPLUSTREE_TYPE::BPlusTree(std::string name, BufferPoolManager *buffer_pool_manag
  */
 INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::IsEmpty() const {
-    bool ret = false;
-    treelatch.RLock();
-    if(root_page_id_ == HEADER_PAGE_ID) ret = true;
-    treelatch.RUnlock();
-    return ret;
+    return root_page_id_ == HEADER_PAGE_ID;
 }
 /*****************************************************************************
  * SEARCH
  *****************************************************************************/
 /*
- * Return the only value that associated with input key
+ * Return the values that associated with input key, the only one unless the
+ * tree is non-unique
  * This method is used for point query
  * @return : true means key exists
  */
 INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::GetValue(const KeyType &key, std::vector<ValueType> *result, Transaction *transaction) {
-    uint32_t tid = getCurrentThreadId();
-    
-    LOG_INFO("[%u-GetValue] Start.\n", tid);
-    bool ret = false;
-    Page* page = GetLeafPageOptimistic(true, key, transaction);
-    if (page != nullptr) {
-        LeafPage* opt_page = reinterpret_cast<LeafPage*>(page->GetData());
-        ValueType value;
-        ret = opt_page->Lookup(key, &value, comparator_);
-        if (ret) {
-            LOG_INFO("[%u-GetValue] Get value successfully.\n", tid);
-            result->push_back(value);
-        } else {
-            LOG_INFO("[%u-GetValue] no get needed value.\n", tid);
+    ValueType value;
+    bool found = false;
+    int attempt = 0;
+    while (attempt < OPTIMISTIC_READ_ATTEMPTS && !TryGetValueOptimistic(key, &value, &found)) {
+        std::this_thread::yield();
+        attempt++;
+    }
+    // a posting list is read under the read latch of its leaf, it is freed while the leaf is write latched.
+    bool posting_list = found && IsPostingList(value);
+    if (attempt == OPTIMISTIC_READ_ATTEMPTS || posting_list) {
+        // keeps running into writers, wait for them on the latches instead.
+        LOG_INFO("[%u-GetValue] optimistic lookup failed or a posting list. read latch the path.\n",
+                 getCurrentThreadId());
+        Page* page = blink_ ? FindLeafBLink(key, true, nullptr) : GetLeafPageOptimistic(true, key, transaction);
+        found = page != nullptr && reinterpret_cast<LeafPage*>(page->GetData())->Lookup(key, &value, comparator_);
+        posting_list = found && IsPostingList(value);
+        if (posting_list) ReadPostingList(value, result);
+        if (blink_ && page != nullptr) buffer_pool_manager_->UnpinPage(page->GetPageId(), false, LatchType::READ);
+        if (!blink_) ReleaseLatchAndDeletePage(transaction, true);
+    }
+    if (found && !posting_list) result->push_back(value);
+    return found;
+}
+
+/*
+ * Optimistic lock coupling: the path is read without latching it, each page is
+ * validated against its version (see Page::GetVersion()) before the child read
+ * from it is used, and the parent once more after the child version is taken, so
+ * the child was still the right one. nothing shared is written except the pins.
+ * in B-link mode the right link is followed instead if the key moved right.
+ * @return : false if a writer got in the way and the lookup has to be restarted
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::TryGetValueOptimistic(const KeyType &key, ValueType *value, bool *found) {
+    Page* opt = nullptr;
+    uint64_t version = 0;
+    if (!FindLeafOptimistic(key, &opt, &version)) return false;
+    *found = false;
+    if (opt == nullptr) return true;
+    *found = reinterpret_cast<LeafPage*>(opt->GetData())->Lookup(key, value, comparator_);
+    bool valid = opt->ValidateVersion(version);
+    buffer_pool_manager_->UnpinPage(opt->GetPageId(), false);
+    return valid;
+}
+
+/*
+ * Descend to the leaf of key the optimistic way, see TryGetValueOptimistic().
+ * what is read from the leaf has to be validated against *version before use.
+ * @return : false if a writer got in the way. otherwise *leaf is the leaf, pinned
+ * and not latched, or nullptr for an empty tree
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::FindLeafOptimistic(const KeyType &key, Page **leaf, uint64_t *version) {
+    *leaf = nullptr;
+    page_id_t page_id = root_page_id_;
+    if (page_id == HEADER_PAGE_ID) return true;
+    Page* opt = buffer_pool_manager_->FetchPage(page_id);
+    if (opt == nullptr) return false;
+    uint64_t current_version = opt->GetVersion();
+    // the root page id only changes while the old root is write latched, see LatchRootPage().
+    if ((current_version & 1) != 0 || page_id != root_page_id_) {
+        buffer_pool_manager_->UnpinPage(page_id, false);
+        return false;
+    }
+
+    while (true) {
+        BPlusTreePage* current_page = reinterpret_cast<BPlusTreePage*>(opt->GetData());
+        page_id_t next_id = blink_ ? GetRightPageId(current_page, key) : INVALID_PAGE_ID;
+        if (next_id == INVALID_PAGE_ID && current_page->IsLeafPage()) {
+            *leaf = opt;
+            *version = current_version;
+            return true;
+        }
+        if (next_id == INVALID_PAGE_ID) next_id = reinterpret_cast<InternalPage*>(current_page)->Lookup(key, comparator_);
+        Page* next_page = nullptr;
+        uint64_t next_version = 0;
+        if (opt->ValidateVersion(current_version)) {
+            next_page = buffer_pool_manager_->FetchPage(next_id);
+            if (next_page != nullptr) next_version = next_page->GetVersion();
+        }
+        bool valid = next_page != nullptr && opt->ValidateVersion(current_version);
+        buffer_pool_manager_->UnpinPage(page_id, false);
+        if (!valid) {
+            if (next_page != nullptr) buffer_pool_manager_->UnpinPage(next_id, false);
+            return false;
         }
+        opt = next_page;
+        page_id = next_id;
+        current_version = next_version;
     }
-    ReleaseLatchAndDeletePage(transaction, true);
-    return ret;
 }
 
+/*
+ * Latch crabbing. root_latch_ only guards changes of root_page_id_, it is the one
+ * tree-wide latch and only writers that may change the root take it:
+ * - optimistic (readers, and writers on the first try): no root latch, the root
+ *   page is found by LatchRootPage(). internal pages are read latched and released
+ *   as soon as the next page down is latched, only the leaf is write latched for
+ *   a writer.
+ * - pessimistic (writers whose leaf turned out to be unsafe): the root latch and
+ *   every page are write latched, everything above a page is released as soon as
+ *   that page is safe, so the root latch is only held while the root may change.
+ */
 INDEX_TEMPLATE_ARGUMENTS
 Page* BPLUSTREE_TYPE::GetLeafPageOptimistic(bool isRead, const KeyType &key, Transaction* txn) {
     uint32_t tid = getCurrentThreadId();
     LOG_INFO("[%u-GetLeafPageOptimistic] start.\n", tid);
 
-    //LOG_INFO("[GetLeafPageOptimistic] start.\n");
-    treelatch.RLock();
-    txn->SetTreeLatch(true);
-
-    page_id_t current_page_id = root_page_id_;
-    Page* ret = nullptr;
-    if (current_page_id == HEADER_PAGE_ID) {
-        //LOG_INFO("[GetLeafPageOptimistic] empty tree. release and return.\n");
-        LOG_INFO("[%u-GetLeafPageOptimistic] empty tree. release and return.\n", tid);
-        ReleaseLatchAndDeletePage(txn, true);
-        return ret;
+    Page* opt = LatchRootPage(isRead);
+    if (opt == nullptr) {
+        LOG_INFO("[%u-GetLeafPageOptimistic] empty tree. return.\n", tid);
+        return nullptr;
     }
-
-    while (current_page_id != HEADER_PAGE_ID) {
-        //LOG_INFO("[GetLeafPageOptimistic] current page id = %d\n", current_page_id);
-        Page* opt = FetchNeedPageFromBPM(current_page_id);
-        BPlusTreePage* current_page = reinterpret_cast<BPlusTreePage*>(opt->GetData());
-        if (current_page->IsLeafPage()) {
-            if(isRead) opt->RLatch();
-            else opt->WLatch();
-            ret = opt;
-            LOG_INFO("[%u-GetLeafPageOptimistic] Get page successfully. Page id = %d\n", tid, current_page_id);
-            current_page_id = HEADER_PAGE_ID;
-            //LOG_INFO("[GetLeafPageOptimistic] Get page successfully. Page id = %d\n", current_page_id);
-        } else {
-            opt->RLatch();
-            InternalPage* current_internal_page = reinterpret_cast<InternalPage*>(current_page);
-            current_page_id = current_internal_page->Lookup(key, comparator_);
-            //LOG_INFO("[GetLeafPageOptimistic] internal. get next page %d done.\n", current_page_id);
-            LOG_INFO("[%u-GetLeafPageOptimistic] internal. next page id = %d.\n", tid, current_page_id);
-        }
+    txn->AddIntoPageSet(opt);
+
+    BPlusTreePage* current_page = reinterpret_cast<BPlusTreePage*>(opt->GetData());
+    while (!current_page->IsLeafPage()) {
+        InternalPage* current_internal_page = reinterpret_cast<InternalPage*>(current_page);
+        page_id_t current_page_id = current_internal_page->Lookup(key, comparator_);
+        LOG_INFO("[%u-GetLeafPageOptimistic] internal. next page id = %d.\n", tid, current_page_id);
+        // the parent is read latched, so the child cannot be split, merged or deleted before it is latched.
+        opt = FetchNeedPageFromBPM(current_page_id);
+        current_page = reinterpret_cast<BPlusTreePage*>(opt->GetData());
+        if (!isRead && current_page->IsLeafPage()) opt->WLatch();
+        else opt->RLatch();
         ReleaseLatchAndDeletePage(txn, true);
         txn->AddIntoPageSet(opt);
     }
-    return ret;
+    LOG_INFO("[%u-GetLeafPageOptimistic] Get page successfully. Page id = %d\n", tid, current_page->GetPageId());
+    return opt;
+}
+
+/*
+ * Fetch and latch the root page without the root latch, nullptr for an empty tree.
+ * the root page id is only changed while the old root is write latched, so the
+ * page is the root if the id still points to it once the latch is held. otherwise
+ * the root changed in between and it is tried again. the root is read latched,
+ * unless it is a leaf and isRead is false.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+Page* BPLUSTREE_TYPE::LatchRootPage(bool isRead) {
+    while (true) {
+        page_id_t root_page_id = root_page_id_;
+        if (root_page_id == HEADER_PAGE_ID) return nullptr;
+        Page* opt = FetchNeedPageFromBPM(root_page_id);
+        bool write = !isRead && reinterpret_cast<BPlusTreePage*>(opt->GetData())->IsLeafPage();
+        if (write) opt->WLatch();
+        else opt->RLatch();
+        BPlusTreePage* root_page = reinterpret_cast<BPlusTreePage*>(opt->GetData());
+        if (root_page_id == root_page_id_ && write == (!isRead && root_page->IsLeafPage())) return opt;
+        buffer_pool_manager_->UnpinPage(root_page_id, false, write ? LatchType::WRITE : LatchType::READ);
+    }
 }
 
 INDEX_TEMPLATE_ARGUMENTS
@@ -122,7 +216,7 @@ Page* BPLUSTREE_TYPE::GetLeafPagePessimistic(bool isInsert, const KeyType &key,
     LOG_INFO("[%u-GetLeafPagePessimistic] start.\n", tid);
 
     //LOG_INFO("[GetLeafPagePessimistic] start.\n");
-    treelatch.WLock();
+    root_latch_.WLock();
     txn->SetTreeLatch(true);
 
     page_id_t current_page_id = root_page_id_;
@@ -163,15 +257,15 @@ void BPLUSTREE_TYPE::ReleaseLatchAndDeletePage(Transaction* txn, bool isRead) {
     std::shared_ptr<std::deque<Page *>> page_set = txn->GetPageSet();
     std::shared_ptr<std::deque<Page *>> release_page_set = txn->GetReleasePageSet();
     std::shared_ptr<std::unordered_set<page_id_t>> deleted_page_set = txn->GetDeletedPageSet();    
-    LOG_INFO("[%u-LatchInfo] treelatch %u, page set %lu, release set %lu, delete set %lu\n", 
+    LOG_INFO("[%u-LatchInfo] root latch %u, page set %lu, release set %lu, delete set %lu\n", 
                                 tid, txn->GetTreeLatch(), page_set->size(), release_page_set->size(), deleted_page_set->size());
 
     //LOG_INFO("[ReleaseLatchAndDeletePage] start to release.\n");
     if (txn->GetTreeLatch()) {
-        //LOG_INFO("[ReleaseLatchAndDeletePage] had tree latch. release tree latch.\n");
-        LOG_INFO("[%u-ReleaseLatchAndDeletePage] had tree latch. release tree latch.\n", tid);
-        if (isRead) treelatch.RUnlock();
-        else treelatch.WUnlock();
+        //LOG_INFO("[ReleaseLatchAndDeletePage] had root latch. release root latch.\n");
+        LOG_INFO("[%u-ReleaseLatchAndDeletePage] had root latch. release root latch.\n", tid);
+        if (isRead) root_latch_.RUnlock();
+        else root_latch_.WUnlock();
         txn->SetTreeLatch(false);
     }
 
@@ -188,6 +282,13 @@ void BPLUSTREE_TYPE::ReleaseLatchAndDeletePage(Transaction* txn, bool isRead) {
         release_page_set->pop_front();
     }
 
+    // before the pages are deleted, so that left links that point at them are moved first
+    std::shared_ptr<std::deque<LeafRelink>> leaf_relink_set = txn->GetLeafRelinkSet();
+    while (!leaf_relink_set->empty()) {
+        SetPrevLeafPageId(leaf_relink_set->front());
+        leaf_relink_set->pop_front();
+    }
+
     //LOG_INFO("[ReleaseLatchAndDeletePage] delete page in  DeletePageSet.\n");
     for (auto it = deleted_page_set->begin(); it != deleted_page_set->end(); ++it) {
         buffer_pool_manager_->DeletePage(*it, LatchType::WRITE);
@@ -225,6 +326,360 @@ Page* BPLUSTREE_TYPE::NewPageFromBPM(page_id_t& pid) {
     return ret;
 }
 
+/*
+ * Find a page that this txn holds the write latch on, nullptr if it holds none.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+Page* BPLUSTREE_TYPE::GetLatchedPage(Transaction* txn, page_id_t pid) {
+    for (Page* opt : *txn->GetPageSet()) {
+        if (opt->GetPageId() == pid) return opt;
+    }
+    for (Page* opt : *txn->GetReleasePageSet()) {
+        if (opt->GetPageId() == pid) return opt;
+    }
+    return nullptr;
+}
+
+/*****************************************************************************
+ * LOGGING
+ *****************************************************************************/
+/*
+ * Every change to a tree page is logged before the page is unlatched, and the page
+ * lsn is set to the record, so redo replays a record only if the page missed it.
+ * Plain inserts and deletes log the one entry (LogEntry). Splits, merges and
+ * redistributions rebuild whole pages, those log the page image (LogPageImage),
+ * and the children that got a new parent log that alone (LogParentPageId).
+ * Leaf pages that use cells log the cell of an insert too, and the header,
+ * which holds their max size.
+ */
+
+/*
+ * Log inserting the entry at index (call after the insert) or removing it (call
+ * before the remove, the entry is still there, LogLeafHeader after it).
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::LogEntry(LogRecordType type, Page* page, int index) {
+    if (!enable_logging || log_manager_ == nullptr) return;
+    BPlusTreePage* node = reinterpret_cast<BPlusTreePage*>(page->GetData());
+    bool cells = node->IsLeafPage() && reinterpret_cast<LeafPage*>(node)->UsesCells();
+    if (cells && type == LogRecordType::BTREEINSERT) {
+        KeyCell cell = reinterpret_cast<LeafPage*>(node)->GetCell(index);
+        LogPageRange(page, cell.offset, cell.size + sizeof(ValueType));
+    }
+    uint32_t offset = node->IsLeafPage() ? LEAF_PAGE_HEADER_SIZE : INTERNAL_PAGE_HEADER_SIZE;
+    uint32_t entry_size = node->IsLeafPage() ? reinterpret_cast<LeafPage*>(node)->GetEntrySize()
+                                             : reinterpret_cast<InternalPage*>(node)->GetEntrySize();
+    LogRecord log_record(type, node->GetPageId(), offset, index, page->GetData() + offset + index * entry_size, entry_size);
+    page->SetLSN(log_manager_->AppendLogRecord(&log_record));
+    if (cells && type == LogRecordType::BTREEINSERT) LogLeafHeader(page);
+}
+
+/*
+ * Log the header of a leaf page that uses cells after an entry went in or out,
+ * replaying the entry alone leaves its max size and its cells behind.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::LogLeafHeader(Page* page) {
+    if (reinterpret_cast<LeafPage*>(page->GetData())->UsesCells()) LogPageRange(page, 0, LEAF_PAGE_HEADER_SIZE);
+}
+
+/*
+ * Log the header and the used entries of a page, and the cells of a leaf page
+ * that uses them. the rest of the page is garbage.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::LogPageImage(Page* page) {
+    BPlusTreePage* node = reinterpret_cast<BPlusTreePage*>(page->GetData());
+    uint32_t length = node->IsLeafPage()
+                          ? LEAF_PAGE_HEADER_SIZE + node->GetSize() * reinterpret_cast<LeafPage*>(node)->GetEntrySize()
+                          : INTERNAL_PAGE_HEADER_SIZE + node->GetSize() * reinterpret_cast<InternalPage*>(node)->GetEntrySize();
+    LogPageRange(page, 0, length);
+    if (node->IsLeafPage() && reinterpret_cast<LeafPage*>(node)->GetCellsOffset() < PAGE_SIZE) {
+        uint32_t cells_offset = reinterpret_cast<LeafPage*>(node)->GetCellsOffset();
+        LogPageRange(page, cells_offset, PAGE_SIZE - cells_offset);
+    }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::LogPageRange(Page* page, uint32_t offset, uint32_t length) {
+    if (!enable_logging || log_manager_ == nullptr) return;
+    BPlusTreePage* node = reinterpret_cast<BPlusTreePage*>(page->GetData());
+    LogRecord log_record(LogRecordType::BTREEPAGE, node->GetPageId(), offset, 0, page->GetData() + offset, length);
+    page->SetLSN(log_manager_->AppendLogRecord(&log_record));
+}
+
+/*
+ * Log the parent page id of a page whose parent was changed by the page code
+ * (ResetParentIdForMovePage) or by AdjustRoot. pages this txn does not hold are
+ * latched for the record, so that their lsn cannot go backwards.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::LogParentPageId(page_id_t pid, Transaction* txn) {
+    if (!enable_logging || log_manager_ == nullptr) return;
+    Page* opt = GetLatchedPage(txn, pid);
+    if (opt != nullptr) {
+        LogPageRange(opt, BPlusTreePage::OFFSET_PARENT_PAGE_ID, sizeof(page_id_t));
+        return;
+    }
+    opt = FetchNeedPageFromBPM(pid);
+    opt->WLatch();
+    LogPageRange(opt, BPlusTreePage::OFFSET_PARENT_PAGE_ID, sizeof(page_id_t));
+    buffer_pool_manager_->UnpinPage(pid, true, LatchType::WRITE);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::LogChildrenParentPageId(InternalPage* node, int from, int to, Transaction* txn) {
+    for (int i = from; i < to; i++) {
+        LogParentPageId(node->ValueAt(i), txn);
+    }
+}
+
+/*
+ * Log the header of a posting page and its data from offset from on, the bytes
+ * before that did not change.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::LogPostingPage(Page* page, int from) {
+    LogPageRange(page, 0, POSTING_PAGE_HEADER_SIZE);
+    int used_size = reinterpret_cast<BPlusTreePostingPage*>(page->GetData())->GetUsedSize();
+    from = std::max(from, POSTING_PAGE_HEADER_SIZE);
+    if (from < used_size) LogPageRange(page, from, used_size - from);
+}
+
+/*
+ * Point the left link of a leaf away from the page that was split or merged
+ * away on its left. this runs after the latches of the split or merge are let
+ * go: the leaf is right of the pages it latched, and a writer that holds it may
+ * wait for them, see CoalesceOrRedistribute(). so others got in between, the
+ * link is only moved if it still points where the split or merge found it, and
+ * a reverse scan checks where it leads (see IndexIterator::StepBackward()).
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::SetPrevLeafPageId(const LeafRelink &relink) {
+    if (relink.page_id == INVALID_PAGE_ID) return;
+    Page* opt = FetchNeedPageFromBPM(relink.page_id);
+    opt->WLatch();
+    LeafPage* leaf_page = reinterpret_cast<LeafPage*>(opt->GetData());
+    // the leaf may be gone by now, merged pages are no leaves anymore
+    bool changed = leaf_page->IsLeafPage() && leaf_page->GetPrevPageId() == relink.old_prev;
+    if (changed) {
+        leaf_page->SetPrevPageId(relink.new_prev);
+        LogPageRange(opt, LeafPage::OFFSET_PREV_PAGE_ID, sizeof(page_id_t));
+    }
+    buffer_pool_manager_->UnpinPage(relink.page_id, changed, LatchType::WRITE);
+}
+
+/*****************************************************************************
+ * NON-UNIQUE KEYS
+ *****************************************************************************/
+/*
+ * A key of a non-unique tree still has one pair in the leaves. with one value
+ * the value is in the pair, with more the pair holds RID(first page of a
+ * posting list, POSTING_LIST_SLOT), see BPlusTreePostingPage. a posting list
+ * belongs to its pair: it is only read while the leaf is read latched and only
+ * changed while the leaf is write latched, so splits and merges of the leaves
+ * move the pair and never touch the list, and its pages are latched one after
+ * the other from the first one without any deadlock.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::IsPostingList(const ValueType &value) const {
+    return !unique_ && value.GetSlotNum() == BPlusTreePostingPage::POSTING_LIST_SLOT;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+Page* BPLUSTREE_TYPE::FetchPostingPage(page_id_t pid, bool isRead) {
+    Page* opt = FetchNeedPageFromBPM(pid);
+    if (isRead) opt->RLatch();
+    else opt->WLatch();
+    return opt;
+}
+
+/*
+ * Add value to the key at index of the leaf, which has a value already. the
+ * second value moves both of them to a new posting list. otherwise value goes
+ * to the page of the list whose range takes it, which is split first if it
+ * may not have room.
+ * @return: false if the key has value already
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::AddToPostingList(Page* leaf, int index, const ValueType &value) {
+    LeafPage* leaf_page = reinterpret_cast<LeafPage*>(leaf->GetData());
+    ValueType current = leaf_page->GetItem(index).second;
+    if (!IsPostingList(current)) {
+        if (current == value) return false;
+        std::vector<ValueType> values{current, value};
+        leaf_page->SetValueAt(index, NewPostingList(&values));
+        LogPageRange(leaf, leaf_page->ValueOffset(index), sizeof(ValueType));
+        return true;
+    }
+
+    uint64_t target = BPlusTreePostingPage::SortKey(value);
+    Page* opt = FetchPostingPage(current.GetPageId(), false);
+    auto posting_page = reinterpret_cast<BPlusTreePostingPage*>(opt->GetData());
+    while (posting_page->GetNextPageId() != INVALID_PAGE_ID) {
+        Page* next = FetchPostingPage(posting_page->GetNextPageId(), false);
+        auto next_page = reinterpret_cast<BPlusTreePostingPage*>(next->GetData());
+        if (BPlusTreePostingPage::SortKey(next_page->GetFirstRid()) > target) {
+            buffer_pool_manager_->UnpinPage(next->GetPageId(), false, LatchType::WRITE);
+            break;
+        }
+        buffer_pool_manager_->UnpinPage(opt->GetPageId(), false, LatchType::WRITE);
+        opt = next;
+        posting_page = next_page;
+    }
+
+    bool dirty = false;
+    if (!posting_page->HasRoomForInsert()) {
+        page_id_t new_page_id;
+        Page* new_opt = NewPageFromBPM(new_page_id);
+        auto new_page = reinterpret_cast<BPlusTreePostingPage*>(new_opt->GetData());
+        new_page->Init(new_page_id);
+        posting_page->MoveHalfTo(new_page);
+        LogPostingPage(opt, 0);
+        LogPostingPage(new_opt, 0);
+        if (BPlusTreePostingPage::SortKey(new_page->GetFirstRid()) <= target) {
+            std::swap(opt, new_opt);
+            posting_page = new_page;
+        }
+        buffer_pool_manager_->UnpinPage(new_opt->GetPageId(), true, LatchType::WRITE);
+        dirty = true;
+    }
+    int changed = posting_page->Insert(value);
+    if (changed != -1) LogPostingPage(opt, changed);
+    buffer_pool_manager_->UnpinPage(opt->GetPageId(), dirty || changed != -1, LatchType::WRITE);
+    return changed != -1;
+}
+
+/*
+ * Remove value from the posting list of the key at index of the leaf. a page
+ * that runs empty is unlinked and deleted, the first page takes over the page
+ * after it instead, as the leaf points to it. a list down to one value is
+ * deleted and the value goes back into the leaf.
+ * @return: false if value is not in the list
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::RemoveFromPostingList(Page* leaf, int index, const ValueType &value) {
+    LeafPage* leaf_page = reinterpret_cast<LeafPage*>(leaf->GetData());
+    ValueType list = leaf_page->GetItem(index).second;
+    uint64_t target = BPlusTreePostingPage::SortKey(value);
+    Page* prev = nullptr;
+    Page* opt = FetchPostingPage(list.GetPageId(), false);
+    auto posting_page = reinterpret_cast<BPlusTreePostingPage*>(opt->GetData());
+    while (posting_page->GetNextPageId() != INVALID_PAGE_ID) {
+        Page* next = FetchPostingPage(posting_page->GetNextPageId(), false);
+        auto next_page = reinterpret_cast<BPlusTreePostingPage*>(next->GetData());
+        if (BPlusTreePostingPage::SortKey(next_page->GetFirstRid()) > target) {
+            buffer_pool_manager_->UnpinPage(next->GetPageId(), false, LatchType::WRITE);
+            break;
+        }
+        if (prev != nullptr) buffer_pool_manager_->UnpinPage(prev->GetPageId(), false, LatchType::WRITE);
+        prev = opt;
+        opt = next;
+        posting_page = next_page;
+    }
+
+    int changed = posting_page->Remove(value);
+    bool prev_dirty = false;
+    if (changed != -1 && posting_page->GetSize() > 0) {
+        LogPostingPage(opt, changed);
+    } else if (changed != -1 && prev != nullptr) {
+        auto prev_page = reinterpret_cast<BPlusTreePostingPage*>(prev->GetData());
+        prev_page->SetNextPageId(posting_page->GetNextPageId());
+        LogPostingPage(prev, prev_page->GetUsedSize());
+        prev_dirty = true;
+        buffer_pool_manager_->DeletePage(opt->GetPageId(), LatchType::WRITE);
+        opt = nullptr;
+    } else if (changed != -1) {
+        // lists of one value are not kept, so there is a page after this one.
+        assert(posting_page->GetNextPageId() != INVALID_PAGE_ID);
+        Page* next = FetchPostingPage(posting_page->GetNextPageId(), false);
+        auto next_page = reinterpret_cast<BPlusTreePostingPage*>(next->GetData());
+        std::vector<RID> rids;
+        next_page->GetRids(&rids);
+        posting_page->SetRids(rids.data(), static_cast<int>(rids.size()));
+        posting_page->SetNextPageId(next_page->GetNextPageId());
+        LogPostingPage(opt, 0);
+        buffer_pool_manager_->DeletePage(next->GetPageId(), LatchType::WRITE);
+    }
+    if (prev != nullptr) buffer_pool_manager_->UnpinPage(prev->GetPageId(), prev_dirty, LatchType::WRITE);
+    if (opt != nullptr) buffer_pool_manager_->UnpinPage(opt->GetPageId(), changed != -1, LatchType::WRITE);
+    if (changed == -1) return false;
+
+    opt = FetchPostingPage(list.GetPageId(), false);
+    posting_page = reinterpret_cast<BPlusTreePostingPage*>(opt->GetData());
+    if (posting_page->GetSize() == 1 && posting_page->GetNextPageId() == INVALID_PAGE_ID) {
+        leaf_page->SetValueAt(index, posting_page->GetFirstRid());
+        LogPageRange(leaf, leaf_page->ValueOffset(index), sizeof(ValueType));
+        buffer_pool_manager_->DeletePage(opt->GetPageId(), LatchType::WRITE);
+    } else {
+        buffer_pool_manager_->UnpinPage(opt->GetPageId(), false, LatchType::WRITE);
+    }
+    return true;
+}
+
+/*
+ * Write values to a new posting list, as many to a page as fit.
+ * @return: the leaf value that stands for the list, the value itself if all
+ * values are the same
+ */
+INDEX_TEMPLATE_ARGUMENTS
+ValueType BPLUSTREE_TYPE::NewPostingList(std::vector<ValueType> *values) {
+    std::sort(values->begin(), values->end(), [](const ValueType &lhs, const ValueType &rhs) {
+        return BPlusTreePostingPage::SortKey(lhs) < BPlusTreePostingPage::SortKey(rhs);
+    });
+    values->erase(std::unique(values->begin(), values->end()), values->end());
+    if (values->size() == 1) return values->front();
+
+    page_id_t first_page_id = INVALID_PAGE_ID;
+    Page* last = nullptr;
+    size_t done = 0;
+    while (done < values->size()) {
+        page_id_t page_id;
+        Page* opt = NewPageFromBPM(page_id);
+        auto posting_page = reinterpret_cast<BPlusTreePostingPage*>(opt->GetData());
+        posting_page->Init(page_id);
+        done += posting_page->SetRids(values->data() + done, static_cast<int>(values->size() - done));
+        if (last != nullptr) {
+            reinterpret_cast<BPlusTreePostingPage*>(last->GetData())->SetNextPageId(page_id);
+            LogPostingPage(last, 0);
+            buffer_pool_manager_->UnpinPage(last->GetPageId(), true, LatchType::WRITE);
+        } else {
+            first_page_id = page_id;
+        }
+        last = opt;
+    }
+    LogPostingPage(last, 0);
+    buffer_pool_manager_->UnpinPage(last->GetPageId(), true, LatchType::WRITE);
+    LOG_INFO("[NewPostingList] %zu values from page %d on.\n", values->size(), first_page_id);
+    return ValueType(first_page_id, BPlusTreePostingPage::POSTING_LIST_SLOT);
+}
+
+/*
+ * Append the values of the posting list to result, in order.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::ReadPostingList(const ValueType &list, std::vector<ValueType> *result) {
+    page_id_t page_id = list.GetPageId();
+    while (page_id != INVALID_PAGE_ID) {
+        Page* opt = FetchPostingPage(page_id, true);
+        auto posting_page = reinterpret_cast<BPlusTreePostingPage*>(opt->GetData());
+        posting_page->GetRids(result);
+        page_id = posting_page->GetNextPageId();
+        buffer_pool_manager_->UnpinPage(opt->GetPageId(), false, LatchType::READ);
+    }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::DeletePostingList(const ValueType &list) {
+    page_id_t page_id = list.GetPageId();
+    while (page_id != INVALID_PAGE_ID) {
+        Page* opt = FetchPostingPage(page_id, false);
+        page_id_t next_page_id = reinterpret_cast<BPlusTreePostingPage*>(opt->GetData())->GetNextPageId();
+        buffer_pool_manager_->DeletePage(page_id, LatchType::WRITE);
+        page_id = next_page_id;
+    }
+}
+
 /*****************************************************************************
  * INSERTION
  *****************************************************************************/
@@ -239,6 +694,7 @@ INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value, Transaction *transaction) { 
     uint32_t tid = getCurrentThreadId();
     LOG_INFO("[%u-Insert] Start.\n", tid);
+    if (blink_) return InsertBLink(key, value, transaction);
 
     //LOG_INFO("[Insert] Start.\n");
     bool ret = true, usePessimistic = false;
@@ -287,9 +743,10 @@ void BPLUSTREE_TYPE::StartNewTree(const KeyType &key, const ValueType &value, Tr
     LeafPage* opt_page = reinterpret_cast<LeafPage*>(page->GetData());
     opt_page->Init(root_page_id, HEADER_PAGE_ID, leaf_max_size_);
     opt_page->Insert(key, value, comparator_);
+    LogPageImage(page);
     LOG_INFO("[StartNewTree] init opt_page_id = %d, opt_page_parent_id = %d\n", opt_page->GetPageId(), opt_page->GetParentPageId());
     root_page_id_ = root_page_id;
-    LOG_INFO("[StartNewTree] root_page_id = %d, root_page_id_ = %d\n", root_page_id, root_page_id_);
+    LOG_INFO("[StartNewTree] root_page_id = %d\n", root_page_id);
     UpdateRootPageId();
 }
 
@@ -311,15 +768,20 @@ bool BPLUSTREE_TYPE::InsertIntoLeaf(const KeyType &key, const ValueType &value,
 
     LeafPage* leaf_page = reinterpret_cast<LeafPage*>(opt->GetData());
     LOG_INFO("[%u-InsertIntoLeaf] current opt page id = %d.", tid, leaf_page->GetPageId());
-    ValueType v;
-    bool ret = !(leaf_page->Lookup(key, &v, comparator_));
-    if (ret) {
+    int position = leaf_page->LookUpTheKey(key, comparator_);
+    bool ret = position == -1;
+    if (!ret && !unique_) {
+        LOG_INFO("[%u-InsertIntoLeaf] key exists. add the value to its posting list.\n", tid);
+        ret = AddToPostingList(opt, position, value);
+    } else if (ret) {
+        if (leaf_page->MakeRoomFor(key)) LogPageImage(opt);
         if (leaf_page->Insert(key, value, comparator_) > leaf_page->GetMaxSize()) {
             LOG_INFO("[%u-InsertIntoLeaf] split.\n", tid);
             LeafPage* new_page = Split(leaf_page, transaction);
             assert(new_page->IsLeafPage());
-            new_page->SetNextPageId(leaf_page->GetNextPageId());
-            leaf_page->SetNextPageId(new_page->GetPageId());
+            LogPageImage(opt);
+            LogPageImage(GetLatchedPage(transaction, new_page->GetPageId()));
+            transaction->AddIntoLeafRelinkSet({new_page->GetNextPageId(), leaf_page->GetPageId(), new_page->GetPageId()});
 
             if (leaf_page->IsRootPage()) {
                 LOG_INFO("[%u-InsertIntoLeaf] root page. add a new root page.\n", tid);
@@ -328,6 +790,8 @@ bool BPLUSTREE_TYPE::InsertIntoLeaf(const KeyType &key, const ValueType &value,
                 LOG_INFO("[%u-InsertIntoLeaf] insert into parent.\n", tid);
                 InsertIntoParent(leaf_page, new_page->KeyAt(0), new_page, transaction);
             }
+        } else {
+            LogEntry(LogRecordType::BTREEINSERT, opt, leaf_page->KeyIndex(key, comparator_));
         }
     } else {
         LOG_INFO("[%u-InsertIntoLeaf] duplicated key. skip.\n", tid);
@@ -347,10 +811,13 @@ void BPLUSTREE_TYPE::NewRootPage(N *left_node, N *right_node, Transaction *txn){
     root_node->Init(new_root_id, HEADER_PAGE_ID, internal_max_size_);
     LOG_INFO("[NewRootPage] [left_id, right_id] = [%d, %d]\n", left_node->GetPageId(), right_node->GetPageId());
     root_node->PopulateNewRoot(left_node->GetPageId(), right_node->KeyAt(0), right_node->GetPageId());
+    left_node->SetParentPageId(new_root_id);
+    right_node->SetParentPageId(new_root_id);
+    LogPageImage(new_root_page);
+    LogParentPageId(left_node->GetPageId(), txn);
+    LogParentPageId(right_node->GetPageId(), txn);
     root_page_id_ = new_root_id;
-    left_node->SetParentPageId(root_page_id_);
-    right_node->SetParentPageId(root_page_id_);
-    LOG_INFO("[NewRootPage] root_page_id_ = %d\n", root_page_id_);
+    LOG_INFO("[NewRootPage] root_page_id_ = %d\n", new_root_id);
     UpdateRootPageId();
 }
 
@@ -373,6 +840,7 @@ N *BPLUSTREE_TYPE::Split(N *node, Transaction *txn) {
     N* new_node = reinterpret_cast<N*>(new_page->GetData());
     int initsize = node->IsLeafPage() ? leaf_max_size_ : internal_max_size_;
     new_node->Init(page_id, node->GetParentPageId(), initsize);
+    // the new page goes right of node on the same level, it takes over node's upper bound
     node->MoveHalfTo(new_node, buffer_pool_manager_);
     LOG_INFO("[%u-Split] origin page id = %d, page size = %d; new page id = %d, page size = %d\n",
                 tid, node->GetPageId(), node->GetSize(), new_node->GetPageId(), new_node->GetSize());
@@ -407,6 +875,9 @@ void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node, const KeyType &ke
         LOG_INFO("[%u-InsertIntoParent] split.\n", tid);
         InternalPage* new_page = Split(internal_page, transaction);
         assert(!new_page->IsLeafPage());
+        LogPageImage(opt);
+        LogPageImage(GetLatchedPage(transaction, new_page->GetPageId()));
+        LogChildrenParentPageId(new_page, 0, new_page->GetSize(), transaction);
         if (internal_page->IsRootPage()) {
             LOG_INFO("[%u-InsertIntoParent] is root page. add a new root page.\n", tid);
             NewRootPage(internal_page, new_page, transaction);
@@ -414,6 +885,8 @@ void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node, const KeyType &ke
             LOG_INFO("[%u-InsertIntoParent] insert into parent.\n", tid);
             InsertIntoParent(internal_page, new_page->KeyAt(0), new_page, transaction);
         }
+    } else {
+        LogEntry(LogRecordType::BTREEINSERT, opt, internal_page->ValueIndex(new_node->GetPageId()));
     }
 }
 
@@ -431,8 +904,24 @@ void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node, const KeyType &ke
 
 INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
+    return RemoveKey(key, nullptr, transaction);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::Remove(const KeyType &key, const ValueType &value, Transaction *transaction) {
+    return RemoveKey(key, &value, transaction);
+}
+
+/*
+ * Remove key, or only value of it if given. a key with a posting list loses
+ * value from its list and stays in the leaf, which does not change the tree.
+ * @return : false if the key, or value, is not in the tree
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::RemoveKey(const KeyType &key, const ValueType *value, Transaction *transaction) {
     uint32_t tid = getCurrentThreadId();
     LOG_INFO("[%u-Remove] Start.\n", tid);
+    if (blink_) return RemoveBLink(key, value, transaction);
 
     Page* opt_page = GetLeafPageOptimistic(false, key, transaction);
     bool usePessimistic = false, ret = true;
@@ -453,7 +942,23 @@ bool BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
         bool cor = false;
         int before_page_size = tree_page->GetSize();
         int minSize = tree_page->GetMinSize();
-        if (tree_page->RemoveAndDeleteRecord(key, comparator_) < minSize) {
+        int position = tree_page->LookUpTheKey(key, comparator_);
+        ret = position != -1;
+        if (ret) {
+            ValueType current = tree_page->GetItem(position).second;
+            if (IsPostingList(current) && value != nullptr) {
+                // the key stays, a list of one value left goes back into the leaf.
+                ret = RemoveFromPostingList(opt_page, position, *value);
+                position = -1;
+            } else if (value != nullptr && !(current == *value)) {
+                ret = false;
+                position = -1;
+            } else if (IsPostingList(current)) {
+                DeletePostingList(current);
+            }
+        }
+        if (position != -1) LogEntry(LogRecordType::BTREEDELETE, opt_page, position);
+        if (position != -1 && tree_page->RemoveAndDeleteRecord(key, comparator_) < minSize) {
             LOG_INFO("[%u-Remove] size < minSize, need to CoalesceOrRedistribute.\n", tid);
             //LOG_INFO("[Remove] size < minSize, need to CoalesceOrRedistribute.\n");
             CoalesceOrRedistribute(tree_page, transaction);
@@ -464,8 +969,8 @@ bool BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
         LOG_INFO("[%u-Remove] remove done, operation leaf page size = %d\n", tid, after_page_size);
         if (!cor) {
             LOG_INFO("[%u-Remove] size >= minSize,  no need to CoalesceOrRedistribute.\n", tid);
-            if(after_page_size == before_page_size) {
-                ret = false;
+            if (position != -1) LogLeafHeader(opt_page);
+            if (!ret) {
                 LOG_ERROR("[%u-Remove] delete fail. page id = %d, page size = %d, minSize = %d.\n", 
                     tid, tree_page->GetPageId(), before_page_size, minSize);
             }
@@ -476,7 +981,7 @@ bool BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction) {
             std::shared_ptr<std::deque<Page*>> release_page_set = transaction->GetReleasePageSet();
             release_page_set->push_front(page_set->front());
             page_set->pop_front();
-            if (!cor && !page_set->empty()) {
+            if (!cor && position != -1 && !page_set->empty()) {
                 LOG_ERROR("[%u-Remove] should be empty!\n", tid);
             }
         }
@@ -514,6 +1019,7 @@ void BPLUSTREE_TYPE::CoalesceOrRedistribute(N *node, Transaction *transaction) {
     if (node->IsRootPage()){
         LOG_INFO("[%u-CoalesceOrRedistribute] root page. need adjust root.\n", tid);
         AdjustRoot(node);
+        if (!node->IsLeafPage()) LogParentPageId(root_page_id_, transaction);
         transaction->AddIntoDeletedPageSet(node->GetPageId());
     } else {
         LOG_INFO("[%u-CoalesceOrRedistribute] not a root page.\n", tid);
@@ -534,21 +1040,34 @@ void BPLUSTREE_TYPE::CoalesceOrRedistribute(N *node, Transaction *transaction) {
         assert(parent_node->GetPageId() == node->GetParentPageId() && parent_node->GetPageId() == sibling_node->GetParentPageId());
         LOG_INFO("[%u-CoalesceOrRedistribute] [node_id, sibling_id] = [%d, %d].\n", tid, node->GetPageId(), sibling_node->GetPageId());
         LOG_INFO("[%u-CoalesceOrRedistribute] [node_size, sibling_size] = [%d, %d].\n", tid, node->GetSize(), sibling_node->GetSize());
-        if (node->GetSize() + sibling_node->GetSize() <= node->GetMaxSize()) {
+        if (node->GetSize() + sibling_node->GetSize() <= node->GetMergedMaxSize(sibling_node)) {
             // coalesce: merge right to left and delete right page.
             LOG_INFO("[%u-CoalesceOrRedistribute] Coalesce.\n", tid);
             bool delete_parent = false;
+            Page* merged_page;
+            int moved_from;
             if (current_index < sibling_index){
                 LOG_INFO("[%u-CoalesceOrRedistribute] move all sibling array to node.\n", tid);
+                LogEntry(LogRecordType::BTREEDELETE, parent_page, sibling_index);
+                moved_from = node->GetSize();
                 delete_parent = Coalesce(&node, &sibling_node, &parent_node, sibling_index, transaction);
                 release_page_set->push_back(current_page);
+                merged_page = current_page;
                 //transaction->AddIntoDeletedPageSet(sibling_page_id); -> done in Calesce()
             } else {
                 LOG_INFO("[%u-CoalesceOrRedistribute] move all node array to sibling.\n", tid);
+                LogEntry(LogRecordType::BTREEDELETE, parent_page, current_index);
+                moved_from = sibling_node->GetSize();
                 delete_parent = Coalesce(&sibling_node, &node, &parent_node, current_index, transaction);
                 release_page_set->push_back(sibling_page);
+                merged_page = sibling_page;
                 //transaction->AddIntoDeletedPageSet(node->GetPageId());
             }
+            LogPageImage(merged_page);
+            N* merged_node = reinterpret_cast<N*>(merged_page->GetData());
+            if (!merged_node->IsLeafPage()) {
+                LogChildrenParentPageId(reinterpret_cast<InternalPage*>(merged_node), moved_from, merged_node->GetSize(), transaction);
+            }
             if (delete_parent) {
                 LOG_INFO("[%u-CoalesceOrRedistribute] parent size < min size.\n", tid);
                 CoalesceOrRedistribute(parent_node, transaction);
@@ -557,13 +1076,27 @@ void BPLUSTREE_TYPE::CoalesceOrRedistribute(N *node, Transaction *transaction) {
             // redistribution
             LOG_INFO("[%u-CoalesceOrRedistribute] Redistribute.\n", tid);
             Redistribute(sibling_node, node, current_index);
-            if (current_index == 0) parent_node->SetKeyAt(sibling_index, sibling_node->KeyAt(0));
-            else parent_node->SetKeyAt(current_index, node->KeyAt(0));
+            int key_index = (current_index == 0) ? sibling_index : current_index;
+            if (current_index == 0) {
+                parent_node->SetKeyAt(sibling_index, sibling_node->KeyAt(0));
+                node->SetHighKey(sibling_node->KeyAt(0));
+            } else {
+                parent_node->SetKeyAt(current_index, node->KeyAt(0));
+                sibling_node->SetHighKey(node->KeyAt(0));
+            }
 
             release_page_set->push_back(current_page);
             release_page_set->push_back(sibling_page);
+            LogPageImage(current_page);
+            LogPageImage(sibling_page);
+            LogPageRange(parent_page, INTERNAL_PAGE_HEADER_SIZE + key_index * parent_node->GetEntrySize(),
+                         parent_node->GetEntrySize());
+            if (!node->IsLeafPage()) {
+                // the one entry that moved over, at the end of node or at its front
+                int moved = (current_index == 0) ? node->GetSize() - 1 : 0;
+                LogChildrenParentPageId(reinterpret_cast<InternalPage*>(node), moved, moved + 1, transaction);
+            }
         }
-        if (parent_node->IsRootPage()) UpdateRootPageId();
     }
 }
 
@@ -590,6 +1123,12 @@ bool BPLUSTREE_TYPE::Coalesce(N **neighbor_node, N **node,
     LOG_INFO("[%u-Coalesce] start.\n", tid);
     bool ret = false;
     (*node)->MoveAllTo(*neighbor_node, (*node)->KeyAt(0), buffer_pool_manager_);
+    if ((*node)->IsLeafPage()) {
+        // a reverse scan that still finds the page by a left link must see that it is gone
+        transaction->AddIntoLeafRelinkSet(
+            {reinterpret_cast<LeafPage*>(*node)->GetNextPageId(), (*node)->GetPageId(), (*neighbor_node)->GetPageId()});
+        (*node)->SetPageType(IndexPageType::INVALID_INDEX_PAGE);
+    }
     (*parent)->Remove(index);
     transaction->AddIntoDeletedPageSet((*node)->GetPageId());
     if ((*parent)->GetSize() < (*parent)->GetMinSize()) ret = true;
@@ -653,10 +1192,597 @@ bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node) {
         change_parent_page->SetParentPageId(HEADER_PAGE_ID);
         buffer_pool_manager_->UnpinPage(page_id, true, LatchType::NONE);
     }
+    // the root latch is write latched here, the root can only change under it.
+    UpdateRootPageId();
     return true; 
 }
 
 
+/*****************************************************************************
+ * B-LINK MODE
+ *****************************************************************************/
+/*
+ * Lehman-Yao B-link tree. every page has a right link and a high key (see
+ * BPlusTreeInternalPage), so a search that reaches a page after it was split
+ * finds the keys that moved by following the right link (MoveRight). that is why
+ * writers latch one page at a time on the way down, and a split only latches the
+ * page being split and the new page, which are released before the parent is
+ * latched for the separator. pages are never merged in this mode, a remove only
+ * takes the entry out of its leaf.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::InsertBLink(const KeyType &key, const ValueType &value, Transaction *txn) {
+    std::vector<page_id_t> path;
+    Page* opt = FindLeafBLink(key, false, &path);
+    if (opt == nullptr) {
+        // the root latch makes sure only one writer starts the tree, the tree is never empty again afterwards.
+        root_latch_.WLock();
+        bool empty = root_page_id_ == HEADER_PAGE_ID;
+        if (empty) {
+            StartNewTree(key, value, txn);
+            ReleaseLatchAndDeletePage(txn, false);
+        }
+        root_latch_.WUnlock();
+        if (empty) return true;
+        opt = FindLeafBLink(key, false, &path);
+    }
+    txn->AddIntoReleasePageSet(opt);
+
+    LeafPage* leaf_page = reinterpret_cast<LeafPage*>(opt->GetData());
+    int position = leaf_page->LookUpTheKey(key, comparator_);
+    bool ret = position == -1;
+    if (!ret && !unique_) {
+        ret = AddToPostingList(opt, position, value);
+    } else if (ret) {
+        if (leaf_page->MakeRoomFor(key)) LogPageImage(opt);
+        if (leaf_page->Insert(key, value, comparator_) > leaf_page->GetMaxSize()) {
+            LeafPage* new_page = Split(leaf_page, txn);
+            LogPageImage(opt);
+            LogPageImage(GetLatchedPage(txn, new_page->GetPageId()));
+            txn->AddIntoLeafRelinkSet({new_page->GetNextPageId(), leaf_page->GetPageId(), new_page->GetPageId()});
+            InsertIntoParentBLink(leaf_page, new_page, &path, txn);
+        } else {
+            LogEntry(LogRecordType::BTREEINSERT, opt, leaf_page->KeyIndex(key, comparator_));
+        }
+    }
+    ReleaseLatchAndDeletePage(txn, false);
+    return ret;
+}
+
+/*
+ * Add the separator of a split to the level above. old_node and new_node are
+ * write latched, they are released first unless old_node is the root, which can
+ * only be replaced while it is latched. the parent is the page this descent came
+ * from (path), or the page on its right that it was moved to by a split.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+template <typename N>
+void BPLUSTREE_TYPE::InsertIntoParentBLink(N *old_node, N *new_node, std::vector<page_id_t> *path, Transaction *txn) {
+    if (old_node->GetPageId() == root_page_id_) {
+        NewRootPage(old_node, new_node, txn);
+        return;
+    }
+    page_id_t old_page_id = old_node->GetPageId();
+    page_id_t new_page_id = new_node->GetPageId();
+    KeyType key = new_node->KeyAt(0);
+    ReleaseLatchAndDeletePage(txn, false);
+
+    page_id_t parent_page_id;
+    if (!path->empty()) {
+        parent_page_id = path->back();
+        path->pop_back();
+    } else {
+        // the descent started below the current root, the root was split since.
+        parent_page_id = FindParentBLink(old_page_id, key);
+    }
+    Page* opt = FetchNeedPageFromBPM(parent_page_id);
+    opt->WLatch();
+    opt = MoveRight(opt, key, true);
+    txn->AddIntoReleasePageSet(opt);
+
+    InternalPage* parent_page = reinterpret_cast<InternalPage*>(opt->GetData());
+    // insert by key, not after old_page_id: the separator of the split that created old_page_id may still be on its
+    // way to this page.
+    page_id_t left_page_id = parent_page->Lookup(key, comparator_);
+    if (parent_page->InsertNodeAfter(left_page_id, key, new_page_id, comparator_) > parent_page->GetMaxSize()) {
+        InternalPage* new_parent_page = Split(parent_page, txn);
+        LogPageImage(opt);
+        LogPageImage(GetLatchedPage(txn, new_parent_page->GetPageId()));
+        LogChildrenParentPageId(new_parent_page, 0, new_parent_page->GetSize(), txn);
+        InsertIntoParentBLink(parent_page, new_parent_page, path, txn);
+    } else {
+        LogEntry(LogRecordType::BTREEINSERT, opt, parent_page->ValueIndex(new_page_id));
+    }
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::RemoveBLink(const KeyType &key, const ValueType *value, Transaction *txn) {
+    Page* opt = FindLeafBLink(key, false, nullptr);
+    if (opt == nullptr) return false;
+    LeafPage* leaf_page = reinterpret_cast<LeafPage*>(opt->GetData());
+    int position = leaf_page->LookUpTheKey(key, comparator_);
+    bool ret = position != -1;
+    if (ret) {
+        ValueType current = leaf_page->GetItem(position).second;
+        if (IsPostingList(current) && value != nullptr) {
+            ret = RemoveFromPostingList(opt, position, *value);
+            position = -1;
+        } else if (value != nullptr && !(current == *value)) {
+            ret = false;
+            position = -1;
+        } else if (IsPostingList(current)) {
+            DeletePostingList(current);
+        }
+    }
+    if (position != -1) {
+        LogEntry(LogRecordType::BTREEDELETE, opt, position);
+        leaf_page->RemoveAndDeleteRecord(key, comparator_);
+        LogLeafHeader(opt);
+    }
+    buffer_pool_manager_->UnpinPage(opt->GetPageId(), ret, LatchType::WRITE);
+    return ret;
+}
+
+/*
+ * Descend to the leaf that covers key, latching one page at a time. internal
+ * pages are read latched, the leaf is write latched unless isRead. the internal
+ * pages the descent went through are pushed to path, if given.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+Page* BPLUSTREE_TYPE::FindLeafBLink(const KeyType &key, bool isRead, std::vector<page_id_t> *path) {
+    Page* opt = LatchRootPage(isRead);
+    if (opt == nullptr) return nullptr;
+    while (true) {
+        bool write = !isRead && reinterpret_cast<BPlusTreePage*>(opt->GetData())->IsLeafPage();
+        opt = MoveRight(opt, key, write);
+        BPlusTreePage* current_page = reinterpret_cast<BPlusTreePage*>(opt->GetData());
+        if (current_page->IsLeafPage()) return opt;
+        if (path != nullptr) path->push_back(opt->GetPageId());
+        page_id_t child_page_id = reinterpret_cast<InternalPage*>(current_page)->Lookup(key, comparator_);
+        buffer_pool_manager_->UnpinPage(opt->GetPageId(), false, LatchType::READ);
+        // pages are never deleted, and if the child is split before it is latched the key is found on its right.
+        opt = FetchNeedPageFromBPM(child_page_id);
+        if (!isRead && reinterpret_cast<BPlusTreePage*>(opt->GetData())->IsLeafPage()) opt->WLatch();
+        else opt->RLatch();
+    }
+}
+
+/*
+ * Find a page on the level above child_id that covers key, for a split whose
+ * descent did not go that high. the level is found by the height of child_id.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+page_id_t BPLUSTREE_TYPE::FindParentBLink(page_id_t child_id, const KeyType &key) {
+    size_t height = 0;
+    page_id_t current_page_id = child_id;
+    while (true) {
+        Page* opt = FetchNeedPageFromBPM(current_page_id);
+        opt->RLatch();
+        BPlusTreePage* current_page = reinterpret_cast<BPlusTreePage*>(opt->GetData());
+        bool is_leaf = current_page->IsLeafPage();
+        if (!is_leaf) current_page_id = reinterpret_cast<InternalPage*>(current_page)->ValueAt(0);
+        buffer_pool_manager_->UnpinPage(opt->GetPageId(), false, LatchType::READ);
+        if (is_leaf) break;
+        height++;
+    }
+    std::vector<page_id_t> path;
+    Page* opt = FindLeafBLink(key, true, &path);
+    buffer_pool_manager_->UnpinPage(opt->GetPageId(), false, LatchType::READ);
+    assert(path.size() > height);
+    return path[path.size() - 1 - height];
+}
+
+/*
+ * Follow the right links from a latched page until it covers key. the page on
+ * the right is latched before the one on the left is released.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+Page* BPLUSTREE_TYPE::MoveRight(Page* opt, const KeyType &key, bool isWrite) {
+    page_id_t next_page_id;
+    while ((next_page_id = GetRightPageId(reinterpret_cast<BPlusTreePage*>(opt->GetData()), key)) != INVALID_PAGE_ID) {
+        Page* next_page = FetchNeedPageFromBPM(next_page_id);
+        if (isWrite) next_page->WLatch();
+        else next_page->RLatch();
+        buffer_pool_manager_->UnpinPage(opt->GetPageId(), false, isWrite ? LatchType::WRITE : LatchType::READ);
+        opt = next_page;
+    }
+    return opt;
+}
+
+/*
+ * @return : the right sibling of node if key moved there by a split, INVALID_PAGE_ID if node covers key
+ */
+INDEX_TEMPLATE_ARGUMENTS
+page_id_t BPLUSTREE_TYPE::GetRightPageId(BPlusTreePage *node, const KeyType &key) {
+    if (node->IsLeafPage()) {
+        LeafPage* leaf_page = reinterpret_cast<LeafPage*>(node);
+        return leaf_page->IsBeyondHighKey(key, comparator_) ? leaf_page->GetNextPageId() : INVALID_PAGE_ID;
+    }
+    InternalPage* internal_page = reinterpret_cast<InternalPage*>(node);
+    return internal_page->IsBeyondHighKey(key, comparator_) ? internal_page->GetNextPageId() : INVALID_PAGE_ID;
+}
+
+/*****************************************************************************
+ * BATCHED OPERATIONS
+ *****************************************************************************/
+/*
+ * Lookups and inserts of many keys, e.g. from a join or a bulk insert, in
+ * increasing key order. a leaf is kept for the keys after the one it was found
+ * for as long as they fall into its range (LeafCovers), and the leaf right of it
+ * is taken by its right link when the next key is beyond its high key, so sorted
+ * keys cost about one descent and a walk along the leaves. a key further away,
+ * a key smaller than the one before, or a leaf that changed on the way costs a
+ * new descent, the result is the same as one GetValue() or Insert() per key.
+ */
+/*
+ * Look up keys, the leaves are read without latches like in GetValue().
+ * @return : number of keys found, result[i] holds the values of keys[i]
+ */
+INDEX_TEMPLATE_ARGUMENTS
+size_t BPLUSTREE_TYPE::MultiGet(const std::vector<KeyType> &keys, std::vector<std::vector<ValueType>> *result,
+                                Transaction *transaction) {
+    result->assign(keys.size(), std::vector<ValueType>());
+    size_t found_keys = 0;
+    Page* opt = nullptr;
+    uint64_t version = 0;
+    for (size_t i = 0; i < keys.size(); i++) {
+        const KeyType &key = keys[i];
+        if (opt != nullptr && !LeafCovers(opt, key)) {
+            LeafPage* leaf_page = reinterpret_cast<LeafPage*>(opt->GetData());
+            page_id_t next_id = leaf_page->IsBeyondHighKey(key, comparator_) ? leaf_page->GetNextPageId()
+                                                                               : INVALID_PAGE_ID;
+            Page* next_page = nullptr;
+            uint64_t next_version = 0;
+            if (next_id != INVALID_PAGE_ID && opt->ValidateVersion(version)) {
+                next_page = buffer_pool_manager_->FetchPage(next_id);
+                if (next_page != nullptr) next_version = next_page->GetVersion();
+            }
+            // the right link was still the same when the version of the right page was taken, and merging the right
+            // page away changes this page too.
+            bool valid = next_page != nullptr && opt->ValidateVersion(version);
+            buffer_pool_manager_->UnpinPage(opt->GetPageId(), false);
+            opt = nullptr;
+            if (valid) {
+                opt = next_page;
+                version = next_version;
+            } else if (next_page != nullptr) {
+                buffer_pool_manager_->UnpinPage(next_id, false);
+            }
+            if (opt != nullptr && !LeafCovers(opt, key)) {
+                buffer_pool_manager_->UnpinPage(opt->GetPageId(), false);
+                opt = nullptr;
+            }
+        }
+        if (opt == nullptr && !FindLeafOptimistic(key, &opt, &version)) opt = nullptr;
+
+        ValueType value;
+        bool found = false;
+        bool valid = false;
+        if (opt != nullptr) {
+            found = reinterpret_cast<LeafPage*>(opt->GetData())->Lookup(key, &value, comparator_);
+            valid = opt->ValidateVersion(version);
+        }
+        if (valid && !(found && IsPostingList(value))) {
+            if (found) {
+                (*result)[i].push_back(value);
+                found_keys++;
+            }
+            continue;
+        }
+        // a writer got in the way, the tree is empty or the values are in a posting list.
+        if (!valid && opt != nullptr) {
+            buffer_pool_manager_->UnpinPage(opt->GetPageId(), false);
+            opt = nullptr;
+        }
+        if (GetValue(key, &(*result)[i], transaction)) found_keys++;
+    }
+    if (opt != nullptr) buffer_pool_manager_->UnpinPage(opt->GetPageId(), false);
+    LOG_INFO("[%u-MultiGet] %zu of %zu keys found.\n", getCurrentThreadId(), found_keys, keys.size());
+    return found_keys;
+}
+
+/*
+ * Insert key & value pairs. the leaf stays write latched for the pairs after
+ * the one it was found for, as long as they fit without a split. a pair that
+ * needs a split goes through Insert().
+ * @return : number of pairs inserted, duplicates are skipped like in Insert()
+ */
+INDEX_TEMPLATE_ARGUMENTS
+size_t BPLUSTREE_TYPE::InsertBatch(const std::vector<MappingType> &items, Transaction *transaction) {
+    uint32_t tid = getCurrentThreadId();
+    size_t inserted = 0;
+    Page* opt = nullptr;
+    for (const MappingType &item : items) {
+        const KeyType &key = item.first;
+        if (opt != nullptr && !LeafCovers(opt, key)) opt = NextLeafForBatch(opt, key);
+        if (opt == nullptr) {
+            if (blink_) {
+                opt = FindLeafBLink(key, false, nullptr);
+            } else {
+                opt = GetLeafPageOptimistic(false, key, transaction);
+                // the leaf is released by this method, not with the page set.
+                if (opt != nullptr) transaction->GetPageSet()->pop_front();
+            }
+        }
+
+        LeafPage* leaf_page = opt == nullptr ? nullptr : reinterpret_cast<LeafPage*>(opt->GetData());
+        int position = leaf_page == nullptr ? -1 : leaf_page->LookUpTheKey(key, comparator_);
+        if (position != -1) {
+            if (!unique_ && AddToPostingList(opt, position, item.second)) inserted++;
+        } else if (leaf_page != nullptr && leaf_page->IsSafeToInsert()) {
+            if (leaf_page->MakeRoomFor(key)) LogPageImage(opt);
+            leaf_page->Insert(key, item.second, comparator_);
+            LogEntry(LogRecordType::BTREEINSERT, opt, leaf_page->KeyIndex(key, comparator_));
+            inserted++;
+        } else {
+            LOG_INFO("[%u-InsertBatch] empty tree or the leaf has to split. insert on its own.\n", tid);
+            if (opt != nullptr) buffer_pool_manager_->UnpinPage(opt->GetPageId(), true, LatchType::WRITE);
+            opt = nullptr;
+            if (Insert(key, item.second, transaction)) inserted++;
+        }
+    }
+    if (opt != nullptr) buffer_pool_manager_->UnpinPage(opt->GetPageId(), true, LatchType::WRITE);
+    LOG_INFO("[%u-InsertBatch] %zu of %zu pairs inserted.\n", tid, inserted, items.size());
+    return inserted;
+}
+
+/*
+ * Whether key falls into the range of the leaf, between its low key (included)
+ * and its high key. the leaf is read as it is, without validating it.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::LeafCovers(Page* leaf, const KeyType &key) {
+    LeafPage* leaf_page = reinterpret_cast<LeafPage*>(leaf->GetData());
+    return comparator_(key, leaf_page->GetLowKey()) >= 0 && !leaf_page->IsBeyondHighKey(key, comparator_);
+}
+
+/*
+ * Trade the write latched leaf opt for the leaf right of it, if that one covers
+ * key. in B-link mode the latches are coupled from left to right like in
+ * MoveRight(). with latch crabbing writers latch a left sibling while they hold
+ * its right one (see CoalesceOrRedistribute()), so opt is unlatched first and
+ * the right link is only taken if opt did not change until the right page was
+ * latched: a merge that deletes the right page changes opt as well.
+ * @return : the write latched leaf, or nullptr. opt is released either way
+ */
+INDEX_TEMPLATE_ARGUMENTS
+Page* BPLUSTREE_TYPE::NextLeafForBatch(Page* opt, const KeyType &key) {
+    LeafPage* leaf_page = reinterpret_cast<LeafPage*>(opt->GetData());
+    if (!leaf_page->IsBeyondHighKey(key, comparator_)) {
+        buffer_pool_manager_->UnpinPage(opt->GetPageId(), true, LatchType::WRITE);
+        return nullptr;
+    }
+    Page* next_page = nullptr;
+    if (blink_) {
+        next_page = FetchNeedPageFromBPM(leaf_page->GetNextPageId());
+        next_page->WLatch();
+        buffer_pool_manager_->UnpinPage(opt->GetPageId(), true, LatchType::WRITE);
+    } else {
+        opt->WUnlatch();
+        uint64_t version = opt->GetVersion();
+        page_id_t next_id = leaf_page->GetNextPageId();
+        if (next_id != INVALID_PAGE_ID && (version & 1) == 0) {
+            next_page = FetchNeedPageFromBPM(next_id);
+            next_page->WLatch();
+            if (!opt->ValidateVersion(version)) {
+                buffer_pool_manager_->UnpinPage(next_id, false, LatchType::WRITE);
+                next_page = nullptr;
+            }
+        }
+        buffer_pool_manager_->UnpinPage(opt->GetPageId(), true);
+    }
+    if (next_page != nullptr && !LeafCovers(next_page, key)) {
+        buffer_pool_manager_->UnpinPage(next_page->GetPageId(), false, LatchType::WRITE);
+        next_page = nullptr;
+    }
+    return next_page;
+}
+
+/*****************************************************************************
+ * BULK LOADING
+ *****************************************************************************/
+/*
+ * Build this tree bottom-up from the key & value pairs that source returns in
+ * increasing key order, source returns false at the end of the input.
+ * Leaves are filled one after the other up to fill_factor of their max size and
+ * every page hands its first key up to the level above, which is built the same
+ * way. A page is written out as soon as the page right of it is full as well, so
+ * only the last two pages of every level are pinned and pages are written in
+ * order. At the end, the last page of a level may be under half full, then it is
+ * merged into or evened out with its left sibling. Remove() relies on every page
+ * but the root being at least half full, so fill_factor is clamped to [0.5, 1].
+ * Nobody can see the new pages before the root is published under the root latch.
+ * @return: false if the tree is not empty or the keys are not increasing, the
+ * tree stays empty then. duplicated keys are skipped, like Insert() does, a
+ * non-unique tree puts their values into a posting list instead.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::BulkLoad(const std::function<bool(KeyType *, ValueType *)> &source, double fill_factor,
+                              Transaction *transaction) {
+    uint32_t tid = getCurrentThreadId();
+    LOG_INFO("[%u-BulkLoad] Start. fill_factor = %f.\n", tid, fill_factor);
+    root_latch_.WLock();
+    if (!IsEmpty()) {
+        root_latch_.WUnlock();
+        LOG_ERROR("[%u-BulkLoad] tree is not empty.\n", tid);
+        return false;
+    }
+
+    std::vector<BulkLoadLevel> levels;
+    KeyType key{}, last_key{};
+    ValueType value{};
+    // the values of last_key, a key is appended once the next one comes
+    std::vector<ValueType> values;
+    while (source(&key, &value)) {
+        if (!values.empty()) {
+            int cmp = comparator_(last_key, key);
+            if (cmp == 0) {
+                if (!unique_) values.push_back(value);
+                continue;
+            }
+            if (cmp > 0) {
+                LOG_ERROR("[%u-BulkLoad] keys are not in increasing order.\n", tid);
+                BulkLoadAbort(&levels);
+                root_latch_.WUnlock();
+                return false;
+            }
+            ValueType leaf_value = values.size() == 1 ? values[0] : NewPostingList(&values);
+            BulkLoadAppend<LeafPage, ValueType>(&levels, 0, last_key, leaf_value, fill_factor, transaction);
+            values.clear();
+        }
+        values.push_back(value);
+        last_key = key;
+    }
+    if (!values.empty()) {
+        ValueType leaf_value = values.size() == 1 ? values[0] : NewPostingList(&values);
+        BulkLoadAppend<LeafPage, ValueType>(&levels, 0, last_key, leaf_value, fill_factor, transaction);
+    }
+
+    Page* root = nullptr;
+    for (size_t level = 0; root == nullptr && level < levels.size(); level++) {
+        root = level == 0 ? BulkLoadFinishLevel<LeafPage>(&levels, level, fill_factor, transaction)
+                          : BulkLoadFinishLevel<InternalPage>(&levels, level, fill_factor, transaction);
+    }
+    if (root != nullptr) {
+        root_page_id_ = root->GetPageId();
+        LOG_INFO("[%u-BulkLoad] done. root_page_id = %d, height = %zu.\n", tid, root->GetPageId(), levels.size());
+        buffer_pool_manager_->UnpinPage(root->GetPageId(), true, LatchType::WRITE);
+        UpdateRootPageId();
+    }
+    root_latch_.WUnlock();
+    return true;
+}
+
+/*
+ * Append key & value to the last page of the level, a new page is started if
+ * that one is full. the page left of the full one is closed then.
+ * @return: page id of the page the entry went to.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+template <typename N, typename V>
+page_id_t BPLUSTREE_TYPE::BulkLoadAppend(std::vector<BulkLoadLevel> *levels, size_t level, const KeyType &key,
+                                         const V &value, double fill_factor, Transaction *txn) {
+    if (levels->size() == level) levels->emplace_back();
+    Page* right_page = (*levels)[level].right;
+    if (right_page == nullptr || reinterpret_cast<N*>(right_page->GetData())->GetSize() >=
+                                     BulkLoadFill(reinterpret_cast<N*>(right_page->GetData()), fill_factor)) {
+        page_id_t page_id;
+        Page* new_page = NewPageFromBPM(page_id);
+        N* new_node = reinterpret_cast<N*>(new_page->GetData());
+        new_node->Init(page_id, INVALID_PAGE_ID, level == 0 ? leaf_max_size_ : internal_max_size_);
+        if (right_page != nullptr) {
+            N* right_node = reinterpret_cast<N*>(right_page->GetData());
+            right_node->SetNextPageId(page_id);
+            right_node->SetHighKey(key);
+            new_node->SetLowKey(key);
+            if (level == 0) reinterpret_cast<LeafPage*>(new_node)->SetPrevPageId(right_page->GetPageId());
+        }
+        // closing may add a level on top, that moves the levels around.
+        Page* left_page = (*levels)[level].left;
+        if (left_page != nullptr) BulkLoadClose<N>(levels, level, left_page, fill_factor, txn);
+        (*levels)[level].left = right_page;
+        (*levels)[level].right = new_page;
+        right_page = new_page;
+    }
+    N* node = reinterpret_cast<N*>(right_page->GetData());
+    node->Append(key, value);
+    return node->GetPageId();
+}
+
+/*
+ * Hand a page that is done over to the level above, then log and unpin it.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+template <typename N>
+void BPLUSTREE_TYPE::BulkLoadClose(std::vector<BulkLoadLevel> *levels, size_t level, Page *page, double fill_factor,
+                                   Transaction *txn) {
+    N* node = reinterpret_cast<N*>(page->GetData());
+    page_id_t parent_id = BulkLoadAppend<InternalPage, page_id_t>(levels, level + 1, node->KeyAt(0), node->GetPageId(),
+                                                                 fill_factor, txn);
+    node->SetParentPageId(parent_id);
+    LogPageImage(page);
+    buffer_pool_manager_->UnpinPage(node->GetPageId(), true, LatchType::WRITE);
+}
+
+/*
+ * Close the last two pages of a level, after everything below it is closed. the
+ * last page is merged into its left sibling if both fit into one page, or else
+ * evened out with it if it is under half full.
+ * @return: the root page, still pinned and latched, if this is the top level.
+ * nullptr otherwise.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+template <typename N>
+Page* BPLUSTREE_TYPE::BulkLoadFinishLevel(std::vector<BulkLoadLevel> *levels, size_t level, double fill_factor,
+                                          Transaction *txn) {
+    Page* left_page = (*levels)[level].left;
+    Page* right_page = (*levels)[level].right;
+    N* right_node = reinterpret_cast<N*>(right_page->GetData());
+    if (left_page == nullptr) {
+        // the only page of the top level.
+        right_node->SetParentPageId(HEADER_PAGE_ID);
+        LogPageImage(right_page);
+        return right_page;
+    }
+
+    N* left_node = reinterpret_cast<N*>(left_page->GetData());
+    bool top = levels->size() == level + 1;
+    if (right_node->GetSize() < right_node->GetMinSize()) {
+        int size = left_node->GetSize() + right_node->GetSize();
+        if (size <= left_node->GetMergedMaxSize(right_node)) {
+            LOG_INFO("[BulkLoadFinishLevel] level %zu: merge page %d into page %d.\n", level, right_node->GetPageId(),
+                     left_node->GetPageId());
+            int moved_from = left_node->GetSize();
+            right_node->MoveAllTo(left_node, right_node->KeyAt(0), buffer_pool_manager_);
+            if (!left_node->IsLeafPage()) {
+                LogChildrenParentPageId(reinterpret_cast<InternalPage*>(left_node), moved_from, left_node->GetSize(), txn);
+            }
+            buffer_pool_manager_->DeletePage(right_node->GetPageId(), LatchType::WRITE);
+            if (top) {
+                left_node->SetParentPageId(HEADER_PAGE_ID);
+                LogPageImage(left_page);
+                return left_page;
+            }
+            BulkLoadClose<N>(levels, level, left_page, fill_factor, txn);
+            return nullptr;
+        }
+        int moved = size / 2 - right_node->GetSize();
+        LOG_INFO("[BulkLoadFinishLevel] level %zu: move %d entries from page %d to page %d.\n", level, moved,
+                 left_node->GetPageId(), right_node->GetPageId());
+        left_node->MoveLastNToFrontOf(right_node, moved, buffer_pool_manager_);
+        left_node->SetHighKey(right_node->KeyAt(0));
+        if (!right_node->IsLeafPage()) {
+            LogChildrenParentPageId(reinterpret_cast<InternalPage*>(right_node), 0, moved, txn);
+        }
+    }
+    BulkLoadClose<N>(levels, level, left_page, fill_factor, txn);
+    BulkLoadClose<N>(levels, level, right_page, fill_factor, txn);
+    return nullptr;
+}
+
+/*
+ * Give back the pages that are still pinned. the pages written out already are
+ * not reachable from anywhere.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::BulkLoadAbort(std::vector<BulkLoadLevel> *levels) {
+    for (const BulkLoadLevel &pages : *levels) {
+        if (pages.left != nullptr) buffer_pool_manager_->DeletePage(pages.left->GetPageId(), LatchType::WRITE);
+        if (pages.right != nullptr) buffer_pool_manager_->DeletePage(pages.right->GetPageId(), LatchType::WRITE);
+    }
+    levels->clear();
+}
+
+/*
+ * Number of entries node is filled with. that follows its max size, which leaf
+ * pages that use cells raise while they take short keys.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int BPLUSTREE_TYPE::BulkLoadFill(const BPlusTreePage *node, double fill_factor) const {
+    int max_size = node->GetMaxSize();
+    return std::max(node->GetMinSize(), std::min(max_size, static_cast<int>(max_size * fill_factor)));
+}
+
 /*****************************************************************************
  * INDEX ITERATOR
  *****************************************************************************/
@@ -667,73 +1793,115 @@ bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node) {
  */
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE BPLUSTREE_TYPE::begin() {
-    KeyType key;
+    KeyType key{};
     Page* page = GetLeafPageOptimisticForIterator(key, -1);
-    if (page != nullptr) return INDEXITERATOR_TYPE(page, 0, buffer_pool_manager_);
-    else return INDEXITERATOR_TYPE(page, -1, buffer_pool_manager_);
+    INDEXITERATOR_TYPE iterator(page, page != nullptr ? 0 : -1, buffer_pool_manager_, unique_, this);
+    iterator.SetRange(nullptr, true, nullptr, true, false);
+    return iterator;
 }
 
 /*
  * Input parameter is low key, find the leaf page that contains the input key
- * first, then construct index iterator
+ * first, then construct index iterator at the first pair not below it
  * @return : index iterator
  */
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin(const KeyType &key) { 
     Page* page = GetLeafPageOptimisticForIterator(key, 0);
-    LeafPage* opt = reinterpret_cast<LeafPage*>(page->GetData());
-    int position = opt->LookUpTheKey(key, comparator_);
-    if (position > -1) return INDEXITERATOR_TYPE(page, position, buffer_pool_manager_); 
-    else {
-        std::runtime_error("[Begin(iterator)] didn't find the key!");
-        return INDEXITERATOR_TYPE();
+    int position = page != nullptr ? reinterpret_cast<LeafPage*>(page->GetData())->KeyIndex(key, comparator_) : -1;
+    INDEXITERATOR_TYPE iterator(page, position, buffer_pool_manager_, unique_, this);
+    iterator.SetRange(nullptr, true, nullptr, true, false);
+    return iterator;
+}
+
+/*
+ * Construct an index iterator at the first pair from low (the first one after
+ * it if not low_inclusive) up to high. ++ stops at high without touching the
+ * leaf after it, -- at low.
+ * @return : index iterator
+ */
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin(const KeyType &low, bool low_inclusive, const KeyType &high,
+                                         bool high_inclusive) {
+    Page* page = GetLeafPageOptimisticForIterator(low, 0);
+    int position = -1;
+    if (page != nullptr) {
+        LeafPage* opt = reinterpret_cast<LeafPage*>(page->GetData());
+        position = opt->KeyIndex(low, comparator_);
+        if (!low_inclusive && position < opt->GetSize() && comparator_(opt->KeyAt(position), low) == 0) position++;
+    }
+    INDEXITERATOR_TYPE iterator(page, position, buffer_pool_manager_, unique_, this);
+    iterator.SetRange(&low, low_inclusive, &high, high_inclusive, false);
+    return iterator;
+}
+
+/*
+ * Construct an index iterator at the last pair up to high (the last one before
+ * it if not high_inclusive) from low on, for a reverse scan with --. -- stops at
+ * low without touching the leaf before it, ++ at high.
+ * @return : index iterator
+ */
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE BPLUSTREE_TYPE::RBegin(const KeyType &low, bool low_inclusive, const KeyType &high,
+                                          bool high_inclusive) {
+    Page* page = GetLeafPageOptimisticForIterator(high, 0);
+    int position = -1;
+    if (page != nullptr) {
+        LeafPage* opt = reinterpret_cast<LeafPage*>(page->GetData());
+        position = opt->KeyIndex(high, comparator_);
+        if (!(high_inclusive && position < opt->GetSize() && comparator_(opt->KeyAt(position), high) == 0)) position--;
     }
+    INDEXITERATOR_TYPE iterator(page, position, buffer_pool_manager_, unique_, this);
+    iterator.SetRange(&low, low_inclusive, &high, high_inclusive, true);
+    return iterator;
+}
+
+/*
+ * Construct an index iterator at the last pair, for a reverse scan with --.
+ * @return : index iterator
+ */
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE BPLUSTREE_TYPE::rbegin() {
+    KeyType key{};
+    Page* page = GetLeafPageOptimisticForIterator(key, 1);
+    int position = page != nullptr ? reinterpret_cast<LeafPage*>(page->GetData())->GetSize() - 1 : -1;
+    INDEXITERATOR_TYPE iterator(page, position, buffer_pool_manager_, unique_, this);
+    iterator.SetRange(nullptr, true, nullptr, true, true);
+    return iterator;
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 Page* BPLUSTREE_TYPE::GetLeafPageOptimisticForIterator(const KeyType &key, int position) {
-    // position {-1: leftmost, 0: input key, 1: end}
+    // position {-1: leftmost, 0: input key, 1: end, 2: the keys just below the input key}
     // diff with get page optimistic is this function has no txn. 
     // you should unlatch/unlock the paeg manually.
-    treelatch.RLock();
-
-    page_id_t current_page_id = root_page_id_;
-    Page* ret = nullptr;
-    if (current_page_id == HEADER_PAGE_ID) {
-        treelatch.RUnlock();
-        return ret;
-    }
-
-    Page* pre_page = nullptr;
-    page_id_t unpin;
-    while (current_page_id != HEADER_PAGE_ID) {
-        Page* opt = FetchNeedPageFromBPM(current_page_id);
-        page_id_t save_for_unpin = current_page_id;
-        BPlusTreePage* current_page = reinterpret_cast<BPlusTreePage*>(opt->GetData());
-        opt->RLatch();
-        if ( !current_page->IsLeafPage() ) {
-            InternalPage* current_internal_page = reinterpret_cast<InternalPage*>(current_page);
-            ValueType next_id;
-            if (position == 0) {
-                current_page_id = current_internal_page->Lookup(key, comparator_);
-            } else {
-                int need_index = (position == 1) ? current_internal_page->GetSize() - 1 : 0;
-                current_page_id = current_internal_page->ValueAt(need_index);
+    Page* opt = LatchRootPage(true);
+    if (opt == nullptr) return nullptr;
+
+    BPlusTreePage* current_page = reinterpret_cast<BPlusTreePage*>(opt->GetData());
+    while (!current_page->IsLeafPage()) {
+        InternalPage* current_internal_page = reinterpret_cast<InternalPage*>(current_page);
+        page_id_t current_page_id;
+        if (position == 0 || position == 2) {
+            current_page_id = current_internal_page->Lookup(key, comparator_);
+            int index = current_internal_page->ValueIndex(current_page_id);
+            // the keys below a separator are in the child left of it
+            if (position == 2 && index > 0 && comparator_(current_internal_page->KeyAt(index), key) == 0) {
+                current_page_id = current_internal_page->ValueAt(index - 1);
             }
-            //current_page_id = reinterpret_cast<page_id_t>(next_id); 
         } else {
-            ret = opt;
-            current_page_id = HEADER_PAGE_ID;
-        }
-        if (pre_page == nullptr) {
-            treelatch.RUnlock();
-        } else {
-            buffer_pool_manager_->UnpinPage(unpin, false, LatchType::READ);
+            int need_index = (position == 1) ? current_internal_page->GetSize() - 1 : 0;
+            current_page_id = current_internal_page->ValueAt(need_index);
         }
-        pre_page = opt;
-        unpin = save_for_unpin;
+        Page* child = FetchNeedPageFromBPM(current_page_id);
+        child->RLatch();
+        buffer_pool_manager_->UnpinPage(opt->GetPageId(), false, LatchType::READ);
+        opt = child;
+        // in B-link mode the child may have been split without the separator in the parent yet.
+        if (blink_ && position == 0) opt = MoveRight(opt, key, false);
+        current_page = reinterpret_cast<BPlusTreePage*>(opt->GetData());
     }
-    return ret;
+    return opt;
 }
 
 
@@ -744,10 +1912,10 @@ Page* BPLUSTREE_TYPE::GetLeafPageOptimisticForIterator(const KeyType &key, int p
  */
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE BPLUSTREE_TYPE::end() { 
-    KeyType key;
+    KeyType key{};
     Page* page = GetLeafPageOptimisticForIterator(key, 1);
     LeafPage* opt = reinterpret_cast<LeafPage*>(page->GetData());
-    return INDEXITERATOR_TYPE(page, opt->GetSize() - 1, buffer_pool_manager_); 
+    return INDEXITERATOR_TYPE(page, opt->GetSize() - 1, buffer_pool_manager_, unique_, this); 
 }
 
 
@@ -782,11 +1950,34 @@ Page *BPLUSTREE_TYPE::FindLeafPage(const KeyType &key, bool leftMost) {
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::UpdateRootPageId() {
   HeaderPage *header_page = static_cast<HeaderPage *>(buffer_pool_manager_->FetchPage(HEADER_PAGE_ID));
+  page_id_t old_root_page_id;
+  if (header_page->GetRootId(index_name_, &old_root_page_id) && old_root_page_id == root_page_id_) {
+    buffer_pool_manager_->UnpinPage(HEADER_PAGE_ID, false, LatchType::NONE);
+    return;
+  }
   if (!header_page->InsertRecord(index_name_, root_page_id_))
         header_page->UpdateRecord(index_name_, root_page_id_);
+  if (enable_logging && log_manager_ != nullptr) {
+    LogRecord log_record(LogRecordType::BTREEROOT, root_page_id_, 0, 0, index_name_.data(), index_name_.size());
+    lsn_t lsn = log_manager_->AppendLogRecord(&log_record);
+    // the header page has no lsn that a page flush could wait for, so the (rare) root change is made durable now.
+    header_page->SetRecLSN(lsn);
+    log_manager_->Flush(lsn);
+  }
   buffer_pool_manager_->UnpinPage(HEADER_PAGE_ID, true, LatchType::NONE);
 }
 
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::LoadRootPageId() {
+  HeaderPage *header_page = static_cast<HeaderPage *>(buffer_pool_manager_->FetchPage(HEADER_PAGE_ID));
+  page_id_t root_page_id;
+  if (!header_page->GetRootId(index_name_, &root_page_id)) root_page_id = HEADER_PAGE_ID;
+  root_latch_.WLock();
+  root_page_id_ = root_page_id;
+  root_latch_.WUnlock();
+  buffer_pool_manager_->UnpinPage(HEADER_PAGE_ID, false, LatchType::NONE);
+}
+
 /*
  * This method is used for test only
  * Read data from file and insert one by one
@@ -804,6 +1995,31 @@ void BPLUSTREE_TYPE::InsertFromFile(const std::string &file_name, Transaction *t
     Insert(index_key, rid, transaction);
   }
 }
+/*
+ * This method is used for test only
+ * Read data from file, sort it and bulk load it
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::BulkLoadFromFile(const std::string &file_name, double fill_factor, Transaction *transaction) {
+  int64_t key;
+  std::vector<int64_t> keys;
+  std::ifstream input(file_name);
+  while (input >> key) {
+    keys.push_back(key);
+  }
+  std::sort(keys.begin(), keys.end());
+
+  size_t next = 0;
+  BulkLoad(
+      [&](KeyType *index_key, ValueType *value) {
+        if (next == keys.size()) return false;
+        index_key->SetFromInteger(keys[next]);
+        *value = RID(keys[next]);
+        next++;
+        return true;
+      },
+      fill_factor, transaction);
+}
 /*
  * This method is used for test only
  * Read data from file and remove one by one
@@ -3,7 +3,9 @@
  */
 #include <cassert>
 
+#include "storage/index/b_plus_tree.h"
 #include "storage/index/index_iterator.h"
+#include "storage/page/b_plus_tree_posting_page.h"
 #include "common/logger.h"
 
 namespace bustub {
@@ -16,10 +18,14 @@ INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE::IndexIterator() = default;
 
 INDEX_TEMPLATE_ARGUMENTS
-INDEXITERATOR_TYPE::IndexIterator(Page* page, int idx, BufferPoolManager* _bpm) {
+INDEXITERATOR_TYPE::IndexIterator(Page* page, int idx, BufferPoolManager* _bpm, bool unique,
+                                  BPlusTree<KeyType, ValueType, KeyComparator> *_tree) {
     current_page = page;
     current_index = idx;
     bpm = _bpm; 
+    unique_keys = unique;
+    tree = _tree;
+    ReadPostings();
     if (page != nullptr) {
         B_PLUS_TREE_LEAF_PAGE_TYPE* opt_page = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE*>(current_page->GetData());
         LOG_INFO("[iterator] init done. page id = %d, index = %d\n", opt_page->GetPageId(), current_index);
@@ -29,6 +35,26 @@ INDEXITERATOR_TYPE::IndexIterator(Page* page, int idx, BufferPoolManager* _bpm)
 } 
 
 
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE::IndexIterator(IndexIterator &&itr) noexcept {
+    current_index = itr.current_index;
+    current_page = itr.current_page;
+    bpm = itr.bpm;
+    current_item = itr.current_item;
+    unique_keys = itr.unique_keys;
+    postings = std::move(itr.postings);
+    posting_index = itr.posting_index;
+    tree = itr.tree;
+    has_low_bound = itr.has_low_bound;
+    low_inclusive = itr.low_inclusive;
+    low_bound = itr.low_bound;
+    has_high_bound = itr.has_high_bound;
+    high_inclusive = itr.high_inclusive;
+    high_bound = itr.high_bound;
+    itr.current_page = nullptr;
+    itr.current_index = -1;
+}
+
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE::~IndexIterator() {
     if(current_page != nullptr) {
@@ -38,6 +64,30 @@ INDEXITERATOR_TYPE::~IndexIterator() {
     }    
 }
 
+/*
+ * Read the posting list of the current pair, if it stands for one
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::ReadPostings() {
+    postings.clear();
+    posting_index = 0;
+    if (unique_keys || current_page == nullptr) return;
+    B_PLUS_TREE_LEAF_PAGE_TYPE* opt_page = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE*>(current_page->GetData());
+    if (current_index < 0 || current_index >= opt_page->GetSize()) return;
+    ValueType value = opt_page->GetItem(current_index).second;
+    if (value.GetSlotNum() != BPlusTreePostingPage::POSTING_LIST_SLOT) return;
+    page_id_t page_id = value.GetPageId();
+    while (page_id != INVALID_PAGE_ID) {
+        Page* page = bpm->FetchPage(page_id);
+        if (page == nullptr) throw std::runtime_error("bufferpoolmanager full while reading a posting list");
+        page->RLatch();
+        auto posting_page = reinterpret_cast<BPlusTreePostingPage*>(page->GetData());
+        posting_page->GetRids(&postings);
+        page_id = posting_page->GetNextPageId();
+        bpm->UnpinPage(page->GetPageId(), false, LatchType::READ);
+    }
+}
+
 INDEX_TEMPLATE_ARGUMENTS
 bool INDEXITERATOR_TYPE::isEnd() { 
     if (current_page == nullptr && current_index == -1) return true;
@@ -49,53 +99,176 @@ const MappingType &INDEXITERATOR_TYPE::operator*() {
     assert(current_page != nullptr);
     B_PLUS_TREE_LEAF_PAGE_TYPE* opt_page = 
         reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE*> (current_page->GetData());
-    return opt_page->GetItem(current_index);
+    current_item = opt_page->GetItem(current_index);
+    if (!postings.empty()) current_item.second = postings[posting_index];
+    return current_item;
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE &INDEXITERATOR_TYPE::operator++() { 
-    if (current_page != nullptr) {
-        B_PLUS_TREE_LEAF_PAGE_TYPE* opt_page =
-            reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE*>(current_page->GetData());
-        if (current_index < opt_page->GetSize() - 1) {
-            current_index++;
-            LOG_INFO("[iterator++] inside the current page %d, current index = %d\n", 
-                                                opt_page->GetPageId(), current_index);
-        } else {
-            LOG_INFO("[iterator++] current page id = %d ", opt_page->GetPageId());
-            page_id_t next_page_id = opt_page->GetNextPageId();
-            LOG_INFO("next page id = %d\n", next_page_id);
-            if(next_page_id == INVALID_PAGE_ID) {
-                LOG_INFO("[iterator++] end of all page.\n");
-                current_page->RUnlatch();
-                current_page = nullptr;
-                current_index = -1;
-            } else {
-                LOG_INFO("[iterator++] go to the next page.\n");
-                Page* next_page = bpm->FetchPage(next_page_id);
-                if (next_page != nullptr) {
-                    next_page->RLatch();
-                    current_page = next_page;
-                    current_index = 0;
-                } else {
-                    throw std::runtime_error("bufferpoolmanager full while operator++");
-                }
-            }
-            bpm->UnpinPage(opt_page->GetPageId(), false, LatchType::READ);
-        }
+    if (posting_index + 1 < postings.size()) {
+        posting_index++;
+    } else if (current_page != nullptr) {
+        current_index++;
+        StepForward();
+        ReadPostings();
+    }
+    return *this;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+INDEXITERATOR_TYPE &INDEXITERATOR_TYPE::operator--() {
+    if (posting_index > 0) {
+        posting_index--;
+    } else if (current_page != nullptr) {
+        current_index--;
+        StepBackward();
+        ReadPostings();
+        if (!postings.empty()) posting_index = postings.size() - 1;
     }
-	
     return *this;
 }
 
+/*
+ * Bound the iterator by low and high (nullptr for none), and move it from the
+ * index it was constructed at to the first pair in the range, or to the last
+ * one for a reverse scan.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::SetRange(const KeyType *low, bool low_incl, const KeyType *high, bool high_incl,
+                                  bool reverse) {
+    has_low_bound = low != nullptr;
+    if (has_low_bound) low_bound = *low;
+    low_inclusive = low_incl;
+    has_high_bound = high != nullptr;
+    if (has_high_bound) high_bound = *high;
+    high_inclusive = high_incl;
+    if (current_page == nullptr) return;
+    if (reverse) StepBackward();
+    else StepForward();
+    ReadPostings();
+    if (reverse && !postings.empty()) posting_index = postings.size() - 1;
+}
+
+/*
+ * Settle on the pair at the current index or the first one after it, in the
+ * next leaves if this one has no more. the iterator ends at the last leaf, or
+ * at a leaf whose high key says that the next one is beyond the high bound.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::StepForward() {
+    while (current_page != nullptr) {
+        B_PLUS_TREE_LEAF_PAGE_TYPE* opt_page = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE*>(current_page->GetData());
+        if (current_index < opt_page->GetSize()) {
+            if (!InRange()) SetEnd();
+            return;
+        }
+        page_id_t next_page_id = opt_page->GetNextPageId();
+        // the keys of the next leaf are not below the high key of this one
+        if (next_page_id == INVALID_PAGE_ID ||
+            (has_high_bound && tree->comparator_(high_bound, opt_page->GetHighKey()) < (high_inclusive ? 0 : 1))) {
+            LOG_INFO("[iterator++] end of the pages in range.\n");
+            SetEnd();
+            return;
+        }
+        LOG_INFO("[iterator++] go from page %d to the next page %d.\n", opt_page->GetPageId(), next_page_id);
+        Page* next_page = bpm->FetchPage(next_page_id);
+        if (next_page == nullptr) throw std::runtime_error("bufferpoolmanager full while operator++");
+        next_page->RLatch();
+        bpm->UnpinPage(opt_page->GetPageId(), false, LatchType::READ);
+        current_page = next_page;
+        current_index = 0;
+    }
+}
+
+/*
+ * Settle on the pair at the current index or the last one before it, in the
+ * leaves on the left if there is none. the current leaf is let go before the one
+ * its left link points at is latched, writers latch from left to right. the left
+ * link is only a hint (see BPlusTree::SetPrevLeafPageId()): the page it points at
+ * is taken if it is a leaf whose right link is the current leaf, which did not
+ * change in between. otherwise the leaf with the keys below the low key of the
+ * current one is found again from the root.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::StepBackward() {
+    while (current_page != nullptr) {
+        B_PLUS_TREE_LEAF_PAGE_TYPE* opt_page = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE*>(current_page->GetData());
+        if (current_index >= 0) {
+            if (!InRange()) SetEnd();
+            return;
+        }
+        KeyType low_key = opt_page->GetLowKey();
+        // the keys of the leaf before are below the low key of this one
+        if (opt_page->GetPrevPageId() == INVALID_PAGE_ID ||
+            (has_low_bound && tree->comparator_(low_bound, low_key) >= 0)) {
+            LOG_INFO("[iterator--] end of the pages in range.\n");
+            SetEnd();
+            return;
+        }
+        page_id_t page_id = current_page->GetPageId();
+        current_page->RUnlatch();
+        uint64_t version = current_page->GetVersion();
+        page_id_t prev_page_id = opt_page->GetPrevPageId();
+        Page* prev_page = nullptr;
+        bool valid = false;
+        if ((version & 1) == 0 && prev_page_id != INVALID_PAGE_ID) {
+            prev_page = bpm->FetchPage(prev_page_id);
+            if (prev_page == nullptr) throw std::runtime_error("bufferpoolmanager full while operator--");
+            prev_page->RLatch();
+            // pages merged away are no leaves anymore, and deleted ones read as zeros
+            auto prev_leaf = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE*>(prev_page->GetData());
+            valid = prev_leaf->IsLeafPage() && prev_leaf->GetNextPageId() == page_id &&
+                    current_page->ValidateVersion(version);
+        }
+        bpm->UnpinPage(page_id, false);
+        if (!valid) {
+            LOG_INFO("[iterator--] page %d changed, find the page before it from the root.\n", page_id);
+            if (prev_page != nullptr) bpm->UnpinPage(prev_page_id, false, LatchType::READ);
+            prev_page = tree->GetLeafPageOptimisticForIterator(low_key, 2);
+        }
+        current_page = prev_page;
+        current_index = -1;
+        if (current_page != nullptr) {
+            opt_page = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE*>(current_page->GetData());
+            current_index = opt_page->KeyIndex(low_key, tree->comparator_) - 1;
+        }
+    }
+}
+
+/*
+ * Whether the key at the current index is within the bounds.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool INDEXITERATOR_TYPE::InRange() {
+    if (!has_low_bound && !has_high_bound) return true;
+    KeyType key = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE*>(current_page->GetData())->KeyAt(current_index);
+    if (has_low_bound && tree->comparator_(key, low_bound) < (low_inclusive ? 0 : 1)) return false;
+    if (has_high_bound && tree->comparator_(key, high_bound) > (high_inclusive ? 0 : -1)) return false;
+    return true;
+}
+
+/*
+ * Let go of the current leaf and become End().
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::SetEnd() {
+    if (current_page != nullptr) bpm->UnpinPage(current_page->GetPageId(), false, LatchType::READ);
+    current_page = nullptr;
+    current_index = -1;
+    postings.clear();
+    posting_index = 0;
+}
+
 INDEX_TEMPLATE_ARGUMENTS
 bool INDEXITERATOR_TYPE::operator==(const IndexIterator &itr) const {
-    return (current_page == itr.current_page && current_index == itr.current_index );
+    return (current_page == itr.current_page && current_index == itr.current_index &&
+            posting_index == itr.posting_index);
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 bool INDEXITERATOR_TYPE::operator!=(const IndexIterator &itr) const {
-    return (current_page != itr.current_page || current_index != itr.current_index);
+    return !(*this == itr);
 }
 
 template class IndexIterator<GenericKey<4>, RID, GenericComparator<4>>;
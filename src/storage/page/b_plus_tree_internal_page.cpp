@@ -9,6 +9,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include "common/logger.h"
@@ -26,11 +27,158 @@ namespace bustub {
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Init(page_id_t page_id, page_id_t parent_id, int max_size) {
+    static_assert(sizeof(BPlusTreeInternalPage) == INTERNAL_PAGE_HEADER_SIZE, "INTERNAL_PAGE_HEADER_SIZE is off");
     SetPageType(IndexPageType::INTERNAL_PAGE);
     SetPageId(page_id);
     SetParentPageId(parent_id);
     SetMaxSize(max_size);
+    SetMinSize((max_size + 1) / 2);
+    SetNextPageId(INVALID_PAGE_ID);
+    prefix_size_ = 0;
+    low_key_ = KeyType{};
+    high_key_ = KeyType{};
 }
+
+/*
+ * Helper methods to set/get next page id (the right link), the low key and the
+ * high key. setting either key updates the prefix.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+page_id_t B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetNextPageId() const {
+    return next_page_id_;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetNextPageId(page_id_t next_page_id) {
+    next_page_id_ = next_page_id;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+KeyType B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetLowKey() const {
+    return low_key_;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetLowKey(const KeyType &low_key) {
+    KeyType old_low_key = low_key_;
+    low_key_ = low_key;
+    UpdatePrefix(old_low_key);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+KeyType B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetHighKey() const {
+    return high_key_;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetHighKey(const KeyType &high_key) {
+    high_key_ = high_key;
+    UpdatePrefix(low_key_);
+}
+
+/*
+ * @return true if key belongs to a page on the right, i.e. it was moved there by a split
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool B_PLUS_TREE_INTERNAL_PAGE_TYPE::IsBeyondHighKey(const KeyType &key, const KeyComparator &comparator) const {
+    return next_page_id_ != INVALID_PAGE_ID && comparator(key, high_key_) >= 0;
+}
+
+/*
+ * Helper methods to get the number of key bytes that are not stored in the
+ * slots, and the size of a slot
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetPrefixSize() const {
+    return prefix_size_;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetEntrySize() const {
+    return sizeof(KeyType) - prefix_size_ + sizeof(ValueType);
+}
+
+/*
+ * Max size of the page that merging sibling into me (or me into sibling) gives,
+ * see BPlusTreeLeafPage::GetMergedMaxSize()
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetMergedMaxSize(const BPlusTreeInternalPage *sibling) const {
+    if (GetMaxSize() != MaxSizeFor(prefix_size_)) return GetMaxSize();
+    return MaxSizeFor(std::min(prefix_size_, sibling->prefix_size_));
+}
+
+/*
+ * Max size of a page whose slots leave out prefix_size key bytes, one slot is
+ * kept free like in INTERNAL_PAGE_SIZE
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_INTERNAL_PAGE_TYPE::MaxSizeFor(int prefix_size) {
+    return (PAGE_SIZE - INTERNAL_PAGE_HEADER_SIZE) / (sizeof(KeyType) - prefix_size + sizeof(ValueType)) - 1;
+}
+
+/*
+ * The slots for KeySearch, size is set to the number of slots. prefix size and
+ * size are kept within the page for the lookups that read the page unlatched.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+KeySlots<KeyType> B_PLUS_TREE_INTERNAL_PAGE_TYPE::Slots(int *size) const {
+    int prefix_size = std::max(0, std::min(prefix_size_, static_cast<int>(sizeof(KeyType)) - 1));
+    *size = std::max(0, std::min(GetSize(), MaxSizeFor(prefix_size) + 1));
+    return {slots_, sizeof(KeyType) - prefix_size + sizeof(ValueType), &low_key_, static_cast<size_t>(prefix_size)};
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+char *B_PLUS_TREE_INTERNAL_PAGE_TYPE::SlotAt(int index) {
+    return slots_ + index * GetEntrySize();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+const char *B_PLUS_TREE_INTERNAL_PAGE_TYPE::SlotAt(int index) const {
+    return slots_ + index * GetEntrySize();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+MappingType B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetItem(int index) const {
+    MappingType item;
+    item.first = KeyAt(index);
+    item.second = ValueAt(index);
+    return item;
+}
+
+/*
+ * Write key & value into the slot at index, key has to be between the low and
+ * the high key
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetItem(int index, const KeyType &key, const ValueType &value) {
+    assert(index <= MaxSizeFor(prefix_size_));
+    const char *key_data = reinterpret_cast<const char *>(&key);
+    assert(memcmp(key_data, &low_key_, prefix_size_) == 0);
+    char *slot = SlotAt(index);
+    memcpy(slot, key_data + prefix_size_, sizeof(KeyType) - prefix_size_);
+    memcpy(slot + sizeof(KeyType) - prefix_size_, &value, sizeof(ValueType));
+}
+
+/*
+ * Make the prefix what the low key and the high key have in common and rewrite
+ * the slots if it changed, see BPlusTreeLeafPage::UpdatePrefix()
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::UpdatePrefix(const KeyType &old_low_key) {
+    KeyType high_key = high_key_;
+    if (next_page_id_ == INVALID_PAGE_ID) memset(&high_key, 0xFF, sizeof(KeyType));
+    int prefix_size = CommonPrefixSize(reinterpret_cast<const char *>(&low_key_), reinterpret_cast<const char *>(&high_key),
+                                       sizeof(KeyType) - 1);
+    if (prefix_size == prefix_size_) return;
+    assert(GetSize() <= MaxSizeFor(prefix_size) + 1);
+    const KeyType &prefix = prefix_size < prefix_size_ ? old_low_key : low_key_;
+    ResizeSlots(slots_, GetSize(), sizeof(KeyType), sizeof(ValueType), reinterpret_cast<const char *>(&prefix),
+                prefix_size_, prefix_size);
+    if (GetMaxSize() == MaxSizeFor(prefix_size_)) SetMaxSize(MaxSizeFor(prefix_size));
+    prefix_size_ = prefix_size;
+}
+
 /*
  * Helper method to get/set the key associated with input "index"(a.k.a
  * array offset)
@@ -40,13 +188,15 @@ KeyType B_PLUS_TREE_INTERNAL_PAGE_TYPE::KeyAt(int index) const {
   // replace with your own code
     //assert(index > 0 );
     assert( index < GetSize());
-    return array[index].first;
+    KeyType key = low_key_;
+    memcpy(reinterpret_cast<char *>(&key) + prefix_size_, SlotAt(index), sizeof(KeyType) - prefix_size_);
+    return key;
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetKeyAt(int index, const KeyType &key) {
     assert(index > 0 && index < GetSize());
-    array[index].first = key;
+    SetItem(index, key, ValueAt(index));
 }
 
 /*
@@ -57,7 +207,7 @@ INDEX_TEMPLATE_ARGUMENTS
 int B_PLUS_TREE_INTERNAL_PAGE_TYPE::ValueIndex(const ValueType &value) const {
     int ret = -1, size = GetSize();
     for (int i = 0; i < size; i++) {
-        if (array[i].second == value) {
+        if (ValueAt(i) == value) {
             ret = i;
             break;
         }
@@ -73,7 +223,9 @@ INDEX_TEMPLATE_ARGUMENTS
 ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::ValueAt(int index) const { 
     //assert(index >= 0);
     assert (index < GetSize() );
-    return array[index].second; 
+    ValueType value;
+    memcpy(&value, SlotAt(index) + sizeof(KeyType) - prefix_size_, sizeof(ValueType));
+    return value; 
 }
 
 /*****************************************************************************
@@ -86,28 +238,13 @@ ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::ValueAt(int index) const {
  */
 INDEX_TEMPLATE_ARGUMENTS
 ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::Lookup(const KeyType &key, const KeyComparator &comparator) const {
-    ValueType ret = array[0].second;
-    int l = 1, r = GetSize() - 1;
-    while (l <= r) {
-        int mid = l + (r - l) / 2;
-        //LOG_INFO("[Internal-Lookup] mid = %d", mid);
-        int cmp = comparator(array[mid].first, key);
-        if (cmp <= 0) {
-            ret = array[mid].second;
-            if (cmp != 0){
-                //LOG_INFO("[Internal-Lookup] mid.key < key, find in right section.");
-                l = mid + 1;
-            } 
-            else {
-                //LOG_INFO("[Internal-Lookup] mid.key == key.");
-                break;
-            }
-        } else {
-            //LOG_INFO("[Internal-Lookup] mid.key > key, find in left section.");
-            r = mid - 1;
-        }
-    }
-    return ret;
+    // the last key <= key, the first child if there is none
+    int size;
+    KeySlots<KeyType> slots = Slots(&size);
+    int index = std::max(0, KeySearch<KeyType, KeyComparator>::UpperBound(slots, 1, size, key, comparator) - 1);
+    ValueType value;
+    memcpy(&value, slots.slots + index * slots.stride + sizeof(KeyType) - slots.prefix_size, sizeof(ValueType));
+    return value;
 }
 
 /*****************************************************************************
@@ -123,11 +260,23 @@ INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::PopulateNewRoot(const ValueType &old_value, const KeyType &new_key,
                                                      const ValueType &new_value) {
     assert(GetSize() == 0);
-    array[0].second = old_value;
-    array[1].first = new_key;
-    array[1].second = new_value;
+    SetItem(0, low_key_, old_value);
+    SetItem(1, new_key, new_value);
     SetSize(2);
 }
+/*
+ * Append new_key & new_value pair after my last one, used by bulk loading which
+ * hands the children over in key order. unlike in the other methods, the first
+ * key is set too: it is the smallest key of the first child.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Append(const KeyType &new_key, const ValueType &new_value) {
+    int current_size = GetSize();
+    assert(current_size < GetMaxSize());
+    SetItem(current_size, new_key, new_value);
+    SetSize(current_size + 1);
+}
+
 /*
  * Insert new_key & new_value pair right after the pair with its value ==
  * old_value
@@ -140,15 +289,12 @@ int B_PLUS_TREE_INTERNAL_PAGE_TYPE::InsertNodeAfter(const ValueType &old_value,
     int position = ValueIndex(old_value);
     int current_size = GetSize();
     assert( position >= 0 );
-    assert( comparator(array[position].first, new_key) < 0 );
-    if (position < current_size - 1)  assert( comparator(array[position + 1].first, new_key) > 0 );
+    assert( comparator(KeyAt(position), new_key) < 0 );
+    if (position < current_size - 1)  assert( comparator(KeyAt(position + 1), new_key) > 0 );
     int insert_position = position + 1;
     LOG_INFO("[internal-InsertNodeAfter] insert position %d", insert_position);
-    for (int i = current_size; i > insert_position; i--) {
-        array[i] = array[i-1];
-    }
-    array[insert_position].first = new_key;
-    array[insert_position].second = new_value;
+    memmove(SlotAt(insert_position + 1), SlotAt(insert_position), (current_size - insert_position) * GetEntrySize());
+    SetItem(insert_position, new_key, new_value);
     current_size += 1;
     SetSize(current_size);
     return current_size;
@@ -177,7 +323,9 @@ int B_PLUS_TREE_INTERNAL_PAGE_TYPE::InsertNodeAfter(const ValueType &old_value,
  * SPLIT
  *****************************************************************************/
 /*
- * Remove half of key & value pairs from this page to "recipient" page
+ * Remove half of key & value pairs from this page to "recipient" page. the
+ * recipient goes right of me and takes over my right link and my high key, the
+ * first key moved is the key between us (see BPlusTreeLeafPage::MoveHalfTo()).
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveHalfTo(BPlusTreeInternalPage *recipient,
@@ -185,25 +333,33 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveHalfTo(BPlusTreeInternalPage *recipient
     int current_size = GetSize();
     assert(current_size > GetMaxSize());
     int half = (current_size + 1) / 2;
-    recipient->CopyNFrom(array + half, current_size - half, buffer_pool_manager);
+    KeyType middle_key = KeyAt(half);
+    recipient->SetNextPageId(GetNextPageId());
+    recipient->SetLowKey(middle_key);
+    recipient->SetHighKey(GetHighKey());
+    recipient->CopyNFrom(this, half, current_size - half, buffer_pool_manager);
     SetSize(half);
+    SetNextPageId(recipient->GetPageId());
+    SetHighKey(middle_key);
 }
 
-/* Copy entries into me, starting from {items} and copy {size} entries.
+/* Copy {size} entries of page into me, starting from {from}.
  * Since it is an internal page, for all entries (pages) moved, their parents page now changes to me.
  * So I need to 'adopt' them by changing their parent page id, which needs to be persisted with BufferPoolManger
  */
 INDEX_TEMPLATE_ARGUMENTS
-void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyNFrom(MappingType *items, int size, BufferPoolManager *buffer_pool_manager) {
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyNFrom(const BPlusTreeInternalPage *page, int from, int size,
+                                               BufferPoolManager *buffer_pool_manager) {
     int current_size = GetSize();
     int new_size = current_size + size;
     assert(new_size <= GetMaxSize());
 
     page_id_t current_id = GetPageId();
     for(int i = 0; i < size; i++) {
-        array[current_size + i] = items[i];
+        MappingType item = page->GetItem(from + i);
+        SetItem(current_size + i, item.first, item.second);
 
-        page_id_t pid =  static_cast<page_id_t>(items[i].second);
+        page_id_t pid =  static_cast<page_id_t>(item.second);
         ResetParentIdForMovePage(pid, current_id, buffer_pool_manager);
     }
     SetSize(new_size);
@@ -222,9 +378,7 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Remove(int index) {
     int size = GetSize();
     assert(index >= 0 && index < size);
     size -= 1;
-    for(int i = index; i < size; i++) {
-        array[i] = array[i+1];
-    }
+    memmove(SlotAt(index), SlotAt(index + 1), (size - index) * GetEntrySize());
     SetSize(size);
 }
 
@@ -235,8 +389,9 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Remove(int index) {
 INDEX_TEMPLATE_ARGUMENTS
 ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::RemoveAndReturnOnlyChild() { 
     assert(GetSize() == 1);
+    ValueType value = ValueAt(0);
     SetSize(0);
-    return array[0].second; 
+    return value; 
 }
 /*****************************************************************************
  * MERGE
@@ -247,13 +402,17 @@ ValueType B_PLUS_TREE_INTERNAL_PAGE_TYPE::RemoveAndReturnOnlyChild() {
  * to make sure the middle key is added to the recipient to maintain the invariant.
  * You also need to use BufferPoolManager to persist changes to the parent page id for those
  * pages that are moved to the recipien
+ * The recipient takes over my high key before the entries, that can make its
+ * prefix shorter.
  */
 
 // TODO: middle_key ?
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveAllTo(BPlusTreeInternalPage *recipient, const KeyType &middle_key,
                                                BufferPoolManager *buffer_pool_manager) {
-    recipient->CopyNFrom(array, GetSize(), buffer_pool_manager);
+    recipient->SetNextPageId(GetNextPageId());
+    recipient->SetHighKey(GetHighKey());
+    recipient->CopyNFrom(this, 0, GetSize(), buffer_pool_manager);
     SetSize(0);
 }
 
@@ -276,12 +435,14 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveFirstToEndOf(BPlusTreeInternalPage *rec
                                                       BufferPoolManager *buffer_pool_manager) {
     int current_len = GetSize();
     assert(current_len > GetMinSize());
-    recipient->CopyLastFrom(array[0], buffer_pool_manager);
+    // my second key becomes the key between the recipient and me
+    KeyType new_middle_key = KeyAt(1);
+    recipient->SetHighKey(new_middle_key);
+    recipient->CopyLastFrom(GetItem(0), buffer_pool_manager);
     current_len -= 1;
-    for (int i = 0; i < current_len; i++) {
-        array[i] = array[i+1];
-    }
+    memmove(SlotAt(0), SlotAt(1), current_len * GetEntrySize());
     SetSize(current_len);
+    SetLowKey(new_middle_key);
 }
 
 /* Append an entry at the end.
@@ -292,7 +453,7 @@ INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyLastFrom(const MappingType &pair, BufferPoolManager *buffer_pool_manager) {
     int size = GetSize();
     assert(size == GetMinSize() - 1);
-    array[size] = pair;
+    SetItem(size, pair.first, pair.second);
     IncreaseSize(1);
 
     page_id_t pid =  static_cast<page_id_t>(pair.second);
@@ -312,8 +473,12 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveLastToFrontOf(BPlusTreeInternalPage *re
                                                        BufferPoolManager *buffer_pool_manager) {
     int current_len = GetSize();
     assert(current_len > GetMinSize());
-    recipient->CopyFirstFrom(array[current_len-1], buffer_pool_manager);
+    // my last key becomes the key between me and the recipient
+    MappingType pair = GetItem(current_len - 1);
+    recipient->SetLowKey(pair.first);
+    recipient->CopyFirstFrom(pair, buffer_pool_manager);
     IncreaseSize(-1);
+    SetHighKey(pair.first);
 }
 
 /* Append an entry at the beginning.
@@ -324,16 +489,40 @@ INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyFirstFrom(const MappingType &pair, BufferPoolManager *buffer_pool_manager) {
     int current_size = GetSize();
     assert(current_size == GetMinSize() - 1);
-    for(int i = current_size; i > 0; i--) {
-        array[i] = array[i-1];
-    }
+    memmove(SlotAt(1), SlotAt(0), current_size * GetEntrySize());
     IncreaseSize(1);
-    array[0] = pair;
+    SetItem(0, pair.first, pair.second);
 
     page_id_t pid =  static_cast<page_id_t>(pair.second);
     ResetParentIdForMovePage(pid, GetPageId(), buffer_pool_manager);
 }
 
+/*
+ * Remove my last n entries to the front of "recipient" page, in one go. used by
+ * bulk loading to even out the last two pages of a level. the moved children
+ * are adopted by recipient like in CopyNFrom().
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveLastNToFrontOf(BPlusTreeInternalPage *recipient, int n,
+                                                        BufferPoolManager *buffer_pool_manager) {
+    int size = GetSize();
+    int recipient_size = recipient->GetSize();
+    assert(n > 0 && n <= size);
+    KeyType middle_key = KeyAt(size - n);
+    recipient->SetLowKey(middle_key);
+    assert(recipient_size + n <= recipient->GetMaxSize());
+    memmove(recipient->SlotAt(n), recipient->SlotAt(0), recipient_size * recipient->GetEntrySize());
+    page_id_t recipient_id = recipient->GetPageId();
+    for (int i = 0; i < n; i++) {
+        MappingType pair = GetItem(size - n + i);
+        recipient->SetItem(i, pair.first, pair.second);
+        ResetParentIdForMovePage(static_cast<page_id_t>(pair.second), recipient_id, buffer_pool_manager);
+    }
+    recipient->SetSize(recipient_size + n);
+    SetSize(size - n);
+    SetHighKey(middle_key);
+}
+
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::ResetParentIdForMovePage(page_id_t pid, page_id_t newparentid, BufferPoolManager *buffer_pool_manager) {
     Page* opt_page = nullptr;
@@ -9,6 +9,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <sstream>
 
 #include "common/exception.h"
@@ -29,17 +30,30 @@ namespace bustub {
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::Init(page_id_t page_id, page_id_t parent_id, int max_size) {
+    static_assert(sizeof(BPlusTreeLeafPage) == LEAF_PAGE_HEADER_SIZE, "LEAF_PAGE_HEADER_SIZE is off");
+    assert(reinterpret_cast<char*>(&prev_page_id_) - reinterpret_cast<char*>(this) == OFFSET_PREV_PAGE_ID);
     SetPageType(IndexPageType::LEAF_PAGE);
     SetPageId(page_id);
     SetParentPageId(parent_id);
-    SetMaxSize(max_size);
+    // splits have to leave both halves at their min size in either layout
+    int page_max_size = MaxSizeFor(0, VARIABLE_KEYS);
+    size_limit_ = max_size < page_max_size ? max_size : 0;
+    SetMinSize((std::min(max_size, page_max_size) + 1) / 2);
     SetNextPageId(INVALID_PAGE_ID);
+    SetPrevPageId(INVALID_PAGE_ID);
+    prefix_size_ = 0;
+    use_cells_ = VARIABLE_KEYS;
+    cells_offset_ = PAGE_SIZE;
+    cells_size_ = 0;
+    low_key_ = KeyType{};
+    high_key_ = KeyType{};
+    UpdateMaxSize();
     LOG_INFO("[leaf page init] init done. page_id = %d, parent_page_id = %d, max_size = %d\n", 
                                                     GetPageId(), GetParentPageId(), max_size);
 }
 
 /**
- * Helper methods to set/get next page id
+ * Helper methods to set/get next page id and prev page id
  */
 INDEX_TEMPLATE_ARGUMENTS
 page_id_t B_PLUS_TREE_LEAF_PAGE_TYPE::GetNextPageId() const { 
@@ -51,32 +65,119 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::SetNextPageId(page_id_t next_page_id) {
     next_page_id_ = next_page_id;
 }
 
+INDEX_TEMPLATE_ARGUMENTS
+page_id_t B_PLUS_TREE_LEAF_PAGE_TYPE::GetPrevPageId() const {
+    return prev_page_id_;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SetPrevPageId(page_id_t prev_page_id) {
+    prev_page_id_ = prev_page_id;
+}
+
+/**
+ * Helper methods to set/get the low key and the high key, the high key is only
+ * meaningful with a next page. setting either one updates the prefix.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+KeyType B_PLUS_TREE_LEAF_PAGE_TYPE::GetLowKey() const {
+    return low_key_;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SetLowKey(const KeyType &low_key) {
+    KeyType old_low_key = low_key_;
+    low_key_ = low_key;
+    UpdatePrefix(old_low_key);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+KeyType B_PLUS_TREE_LEAF_PAGE_TYPE::GetHighKey() const {
+    return high_key_;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SetHighKey(const KeyType &high_key) {
+    high_key_ = high_key;
+    UpdatePrefix(low_key_);
+}
+
+/**
+ * @return true if key belongs to a page on the right, i.e. it was moved there by a split
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool B_PLUS_TREE_LEAF_PAGE_TYPE::IsBeyondHighKey(const KeyType &key, const KeyComparator &comparator) const {
+    return next_page_id_ != INVALID_PAGE_ID && comparator(key, high_key_) >= 0;
+}
+
+/**
+ * Helper methods to get the number of key bytes that are not stored in the
+ * slots, whether the pairs are in cells, and the size of a slot (a KeyCell then)
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_LEAF_PAGE_TYPE::GetPrefixSize() const {
+    return prefix_size_;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+bool B_PLUS_TREE_LEAF_PAGE_TYPE::UsesCells() const {
+    return VARIABLE_KEYS && use_cells_ != 0;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_LEAF_PAGE_TYPE::GetEntrySize() const {
+    if (UsesCells()) return sizeof(KeyCell);
+    return sizeof(KeyType) - prefix_size_ + sizeof(ValueType);
+}
+
+/**
+ * Max size of the page that merging sibling into me (or me into sibling) gives.
+ * the prefix of that page is the shorter one of the two, because both come from
+ * the separator between us. with VARIABLE_KEYS the layout of that page and the
+ * cells of both pages under that prefix count as well.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_LEAF_PAGE_TYPE::GetMergedMaxSize(const BPlusTreeLeafPage *sibling) const {
+    if (size_limit_ > 0) return size_limit_;
+    int prefix_size = std::min(prefix_size_, sibling->prefix_size_);
+    if (!VARIABLE_KEYS) return MaxSizeFor(prefix_size);
+    int size = GetSize() + sibling->GetSize();
+    int cells_size = 0;
+    for (const BPlusTreeLeafPage *page : {this, sibling}) {
+        for (int i = 0; i < page->GetSize(); i++) {
+            cells_size += sizeof(KeyCell) + CellKeySize(page->KeyAt(i), prefix_size) + sizeof(ValueType);
+        }
+    }
+    if (!PreferCells(size, cells_size, prefix_size)) return MaxSizeFor(prefix_size);
+    int free_size = static_cast<int>(PAGE_SIZE - LEAF_PAGE_HEADER_SIZE) - cells_size;
+    int longest_size = sizeof(KeyCell) + sizeof(KeyType) - prefix_size + sizeof(ValueType);
+    return size + free_size / longest_size - 1;
+}
+
+/**
+ * Helper methods for logging the cells: where the lowest one starts (PAGE_SIZE
+ * without cells), and where the one of the pair at index is
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_LEAF_PAGE_TYPE::GetCellsOffset() const {
+    return cells_offset_;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+KeyCell B_PLUS_TREE_LEAF_PAGE_TYPE::GetCell(int index) const {
+    assert(UsesCells() && index < GetSize());
+    int size;
+    return Cells(&size).At(index);
+}
+
 /**
  * Helper method to find the first index i so that array[i].first >= key
  * NOTE: This method is only used when generating index iterator
  */
 INDEX_TEMPLATE_ARGUMENTS
 int B_PLUS_TREE_LEAF_PAGE_TYPE::KeyIndex(const KeyType &key, const KeyComparator &comparator) const {
-    int l = 0, r = GetSize() - 1;
-    int ret = GetSize();
-    while (l <= r) {
-        int m = l + ( r - l ) / 2;
-        //LOG_INFO("[leaf-KeyIndex] mid = %d.", m);
-        int cmp = comparator(array[m].first, key);
-        if (cmp >= 0) {
-            ret = m;
-            if (cmp == 0) {
-                //LOG_INFO("[leaf-KeyIndex] mid.key == key, break.");
-                break;
-            } else {
-                //LOG_INFO("[leaf-KeyIndex] mid.key > key, go to left section.");
-                r = m - 1;
-            }
-        } else {
-            //LOG_INFO("[leaf-KeyIndex] mid.key < key, go to right section.");
-            l = m + 1;
-        }
-    }
+    int size;
+    int ret = LowerBound(key, comparator, &size);
     if (ret == GetSize()) {LOG_INFO("[leaf-KeyIndex] array[i].first >= key no exist. return the current size.");}
     return ret; 
 }
@@ -89,7 +190,7 @@ INDEX_TEMPLATE_ARGUMENTS
 KeyType B_PLUS_TREE_LEAF_PAGE_TYPE::KeyAt(int index) const {
   // replace with your own code
   assert(index < GetSize());
-  return array[index].first;
+  return DecodeKey(index, low_key_);
 }
 
 /*
@@ -97,10 +198,303 @@ KeyType B_PLUS_TREE_LEAF_PAGE_TYPE::KeyAt(int index) const {
  * "index"(a.k.a array offset)
  */
 INDEX_TEMPLATE_ARGUMENTS
-const MappingType &B_PLUS_TREE_LEAF_PAGE_TYPE::GetItem(int index) {
+MappingType B_PLUS_TREE_LEAF_PAGE_TYPE::GetItem(int index) const {
   // replace with your own code
   assert(index < GetSize());
-  return array[index];
+  MappingType item;
+  item.first = KeyAt(index);
+  item.second = ValueAt(index);
+  return item;
+}
+
+/*
+ * Max size of a page whose slots leave out prefix_size key bytes, one slot is
+ * kept free like in LEAF_PAGE_SIZE. with cells this is for keys that are not
+ * any shorter.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_LEAF_PAGE_TYPE::MaxSizeFor(int prefix_size, bool cells) {
+    int longest_size = (cells ? sizeof(KeyCell) : 0) + sizeof(KeyType) - prefix_size + sizeof(ValueType);
+    return (PAGE_SIZE - LEAF_PAGE_HEADER_SIZE) / longest_size - 1;
+}
+
+/*
+ * Whether size pairs that take cells_size bytes in cells (slots included) are
+ * better off there than in fixed slots
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool B_PLUS_TREE_LEAF_PAGE_TYPE::PreferCells(int size, int cells_size, int prefix_size) {
+    return VARIABLE_KEYS && size > 0 &&
+           cells_size < size * static_cast<int>(sizeof(KeyType) - prefix_size + sizeof(ValueType));
+}
+
+/*
+ * Number of bytes of key that go into its cell: the ones after the prefix,
+ * without the zero bytes at the end
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_LEAF_PAGE_TYPE::CellKeySize(const KeyType &key, int prefix_size) {
+    const char *key_data = reinterpret_cast<const char *>(&key);
+    int end = sizeof(KeyType);
+    while (end > prefix_size && key_data[end - 1] == 0) end--;
+    return end - prefix_size;
+}
+
+/*
+ * Bytes left for more pairs in cells, dead cells included
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_LEAF_PAGE_TYPE::FreeSize() const {
+    return PAGE_SIZE - LEAF_PAGE_HEADER_SIZE - GetSize() * sizeof(KeyCell) - cells_size_;
+}
+
+/*
+ * The slots for KeySearch, size is set to the number of slots. lookups read
+ * pages while they are being changed and validate them afterwards, so prefix
+ * size and size are kept within the page here.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+KeySlots<KeyType> B_PLUS_TREE_LEAF_PAGE_TYPE::Slots(int *size) const {
+    int prefix_size = std::max(0, std::min(prefix_size_, static_cast<int>(sizeof(KeyType)) - 1));
+    *size = std::max(0, std::min(GetSize(), MaxSizeFor(prefix_size) + 1));
+    return {slots_, sizeof(KeyType) - prefix_size + sizeof(ValueType), &low_key_, static_cast<size_t>(prefix_size)};
+}
+
+/*
+ * KeySearch::LowerBound over my slots or cells, size is set to the number
+ * searched
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_LEAF_PAGE_TYPE::LowerBound(const KeyType &key, const KeyComparator &comparator, int *size) const {
+    if constexpr (VARIABLE_KEYS) {
+        if (use_cells_ != 0) {
+            KeyCells<KeyType> cells = Cells(size);
+            return KeySearch<KeyType, KeyComparator>::LowerBound(cells, 0, *size, key, comparator);
+        }
+    }
+    KeySlots<KeyType> slots = Slots(size);
+    return KeySearch<KeyType, KeyComparator>::LowerBound(slots, 0, *size, key, comparator);
+}
+
+/*
+ * The cells for KeySearch, kept within the page like Slots
+ */
+INDEX_TEMPLATE_ARGUMENTS
+KeyCells<KeyType> B_PLUS_TREE_LEAF_PAGE_TYPE::Cells(int *size) const {
+    int prefix_size = std::max(0, std::min(prefix_size_, static_cast<int>(sizeof(KeyType)) - 1));
+    *size = std::max(0, std::min(GetSize(), static_cast<int>((PAGE_SIZE - LEAF_PAGE_HEADER_SIZE) / sizeof(KeyCell))));
+    return {reinterpret_cast<const char *>(this), slots_, &low_key_, static_cast<size_t>(prefix_size)};
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+char *B_PLUS_TREE_LEAF_PAGE_TYPE::SlotAt(int index) {
+    return slots_ + index * GetEntrySize();
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+const char *B_PLUS_TREE_LEAF_PAGE_TYPE::SlotAt(int index) const {
+    return slots_ + index * GetEntrySize();
+}
+
+/*
+ * The key at index, with the prefix taken from prefix
+ */
+INDEX_TEMPLATE_ARGUMENTS
+KeyType B_PLUS_TREE_LEAF_PAGE_TYPE::DecodeKey(int index, const KeyType &prefix) const {
+    KeyType key = prefix;
+    char *key_data = reinterpret_cast<char *>(&key);
+    if (UsesCells()) {
+        int size;
+        KeyCells<KeyType> cells = Cells(&size);
+        KeyCell cell = cells.At(index);
+        memcpy(key_data + cells.prefix_size, cells.page + cell.offset, cell.size);
+        memset(key_data + cells.prefix_size + cell.size, 0, sizeof(KeyType) - cells.prefix_size - cell.size);
+    } else {
+        int size;
+        KeySlots<KeyType> slots = Slots(&size);
+        memcpy(key_data + slots.prefix_size, slots.slots + index * slots.stride, sizeof(KeyType) - slots.prefix_size);
+    }
+    return key;
+}
+
+/*
+ * Where the value of the pair at index is, from the start of the page
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_LEAF_PAGE_TYPE::ValueOffset(int index) const {
+    if (UsesCells()) {
+        int size;
+        KeyCell cell = Cells(&size).At(index);
+        return std::min<int>(cell.offset + cell.size, PAGE_SIZE - sizeof(ValueType));
+    }
+    return SlotAt(index) + sizeof(KeyType) - prefix_size_ - reinterpret_cast<const char *>(this);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+ValueType B_PLUS_TREE_LEAF_PAGE_TYPE::ValueAt(int index) const {
+    ValueType value;
+    memcpy(&value, reinterpret_cast<const char *>(this) + ValueOffset(index), sizeof(ValueType));
+    return value;
+}
+
+/*
+ * Replace the value of the pair at index, the key stays where it is
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SetValueAt(int index, const ValueType &value) {
+    assert(index < GetSize());
+    memcpy(reinterpret_cast<char *>(this) + ValueOffset(index), &value, sizeof(ValueType));
+}
+
+/*
+ * Insert key & value at index, the pairs from index on move up by one. key has
+ * to be between the low and the high key, and the pair has to fit.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::InsertItem(int index, const KeyType &key, const ValueType &value) {
+    int size = GetSize();
+    const char *key_data = reinterpret_cast<const char *>(&key);
+    assert(index <= size);
+    assert(memcmp(key_data, &low_key_, prefix_size_) == 0);
+    if (UsesCells()) {
+        KeyCell cell;
+        cell.size = CellKeySize(key, prefix_size_);
+        int cell_size = cell.size + sizeof(ValueType);
+        int slots_end = LEAF_PAGE_HEADER_SIZE + (size + 1) * sizeof(KeyCell);
+        if (cells_offset_ - slots_end < cell_size) Compact();
+        assert(cells_offset_ - slots_end >= cell_size);
+        cells_offset_ -= cell_size;
+        cells_size_ += cell_size;
+        cell.offset = cells_offset_;
+        char *cell_data = reinterpret_cast<char *>(this) + cell.offset;
+        memcpy(cell_data, key_data + prefix_size_, cell.size);
+        memcpy(cell_data + cell.size, &value, sizeof(ValueType));
+        memmove(SlotAt(index + 1), SlotAt(index), (size - index) * sizeof(KeyCell));
+        memcpy(SlotAt(index), &cell, sizeof(KeyCell));
+    } else {
+        assert(size <= MaxSizeFor(prefix_size_));
+        memmove(SlotAt(index + 1), SlotAt(index), (size - index) * GetEntrySize());
+        char *slot = SlotAt(index);
+        memcpy(slot, key_data + prefix_size_, sizeof(KeyType) - prefix_size_);
+        memcpy(slot + sizeof(KeyType) - prefix_size_, &value, sizeof(ValueType));
+    }
+    SetSize(size + 1);
+    UpdateMaxSize();
+}
+
+/*
+ * Remove n pairs starting at index, the pairs after them move down. their
+ * cells are dead until the next Compact, unless the page is empty then.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::RemoveItems(int index, int n) {
+    int size = GetSize();
+    assert(index >= 0 && n >= 0 && index + n <= size);
+    if (UsesCells()) {
+        for (int i = index; i < index + n; i++) {
+            cells_size_ -= GetCell(i).size + sizeof(ValueType);
+        }
+        if (size == n) cells_offset_ = PAGE_SIZE;
+    }
+    memmove(SlotAt(index), SlotAt(index + n), (size - index - n) * GetEntrySize());
+    SetSize(size - n);
+    UpdateMaxSize();
+}
+
+/*
+ * Move the cells in use together at the end of the page, in the order of their
+ * pairs. the dead cells between them become free.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::Compact() {
+    char buffer[PAGE_SIZE];
+    char *page = reinterpret_cast<char *>(this);
+    int offset = PAGE_SIZE;
+    for (int i = 0; i < GetSize(); i++) {
+        KeyCell cell;
+        memcpy(&cell, SlotAt(i), sizeof(KeyCell));
+        int cell_size = cell.size + sizeof(ValueType);
+        offset -= cell_size;
+        memcpy(buffer + offset, page + cell.offset, cell_size);
+        cell.offset = offset;
+        memcpy(SlotAt(i), &cell, sizeof(KeyCell));
+    }
+    memcpy(page + offset, buffer + offset, PAGE_SIZE - offset);
+    assert(PAGE_SIZE - offset == cells_size_);
+    cells_offset_ = offset;
+}
+
+/*
+ * Replace my pairs with items, in cells or in fixed slots, whichever takes less
+ * room. an empty page keeps its layout.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::Rebuild(const std::vector<MappingType> &items) {
+    int size = static_cast<int>(items.size());
+    if (VARIABLE_KEYS && size > 0) {
+        int cells_size = 0;
+        for (const MappingType &item : items) {
+            cells_size += sizeof(KeyCell) + CellKeySize(item.first, prefix_size_) + sizeof(ValueType);
+        }
+        use_cells_ = PreferCells(size, cells_size, prefix_size_);
+    }
+    SetSize(0);
+    cells_offset_ = PAGE_SIZE;
+    cells_size_ = 0;
+    for (const MappingType &item : items) {
+        InsertItem(GetSize(), item.first, item.second);
+    }
+    UpdateMaxSize();
+}
+
+/*
+ * The max size for the prefix and, with cells, for the pairs the page holds:
+ * room for one more pair of the longest kind means there is room for the next
+ * insert, so a page that is not over its max size always takes one.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::UpdateMaxSize() {
+    if (size_limit_ > 0) {
+        SetMaxSize(size_limit_);
+    } else if (UsesCells()) {
+        int longest_size = sizeof(KeyCell) + sizeof(KeyType) - prefix_size_ + sizeof(ValueType);
+        SetMaxSize(GetSize() + FreeSize() / longest_size - 1);
+    } else {
+        SetMaxSize(MaxSizeFor(prefix_size_));
+    }
+}
+
+/*
+ * Make the prefix what the low key and the high key have in common, without a
+ * next page there is no upper bound and the high key counts as the largest key
+ * (all bytes 0xFF). the slots are rewritten if the prefix changed, old_low_key is
+ * the low key they were written with. with VARIABLE_KEYS the page is rebuilt,
+ * which picks its layout again. the max size follows the prefix, unless the
+ * page was set up with less than the page allows.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::UpdatePrefix(const KeyType &old_low_key) {
+    KeyType high_key = high_key_;
+    if (next_page_id_ == INVALID_PAGE_ID) memset(&high_key, 0xFF, sizeof(KeyType));
+    int prefix_size = CommonPrefixSize(reinterpret_cast<const char *>(&low_key_), reinterpret_cast<const char *>(&high_key),
+                                       sizeof(KeyType) - 1);
+    if (prefix_size == prefix_size_) return;
+    if (VARIABLE_KEYS) {
+        std::vector<MappingType> items(GetSize());
+        for (int i = 0; i < GetSize(); i++) {
+            items[i] = {DecodeKey(i, old_low_key), ValueAt(i)};
+        }
+        prefix_size_ = prefix_size;
+        Rebuild(items);
+    } else {
+        assert(GetSize() <= MaxSizeFor(prefix_size) + 1);
+        // the longer prefix is in the low key the slots are written for
+        const KeyType &prefix = prefix_size < prefix_size_ ? old_low_key : low_key_;
+        ResizeSlots(slots_, GetSize(), sizeof(KeyType), sizeof(ValueType), reinterpret_cast<const char *>(&prefix),
+                    prefix_size_, prefix_size);
+        prefix_size_ = prefix_size;
+    }
+    UpdateMaxSize();
 }
 
 /*****************************************************************************
@@ -118,22 +512,44 @@ int B_PLUS_TREE_LEAF_PAGE_TYPE::Insert(const KeyType &key, const ValueType &valu
     //assert(comparator(array[position], key) <= 0);
     //if (position == -1) position = 0;
     LOG_INFO("[leaf-Insert] insert position %d\n", position);
-    for (int i = current_size; i > position; i--) {
-        array[i] = array[i-1];
-    }
-    array[position].first = key;
-    array[position].second = value;
-    
-    current_size += 1;
-    SetSize(current_size);
-    return current_size;
+    InsertItem(position, key, value);
+    return current_size + 1;
+}
+
+/*
+ * Append key & value pair after my last one, used by bulk loading which hands
+ * the pairs over in key order.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::Append(const KeyType &key, const ValueType &value) {
+    int current_size = GetSize();
+    assert(current_size < GetMaxSize());
+    InsertItem(current_size, key, value);
+}
+
+/*
+ * Move the cells together if the pair with key would not fit in front of them
+ * any more. the tree logs the whole page then, Insert only logs the pair.
+ * @return true if the cells were moved
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool B_PLUS_TREE_LEAF_PAGE_TYPE::MakeRoomFor(const KeyType &key) {
+    if (!UsesCells() || cells_offset_ + cells_size_ == PAGE_SIZE) return false;
+    int slots_end = LEAF_PAGE_HEADER_SIZE + (GetSize() + 1) * sizeof(KeyCell);
+    if (cells_offset_ - slots_end >= CellKeySize(key, prefix_size_) + static_cast<int>(sizeof(ValueType))) return false;
+    Compact();
+    return true;
 }
 
 /*****************************************************************************
  * SPLIT
  *****************************************************************************/
 /*
- * Remove half of key & value pairs from this page to "recipient" page
+ * Remove half of key & value pairs from this page to "recipient" page. the
+ * recipient goes right of me on the same level: it takes over my right link and
+ * my high key, and the first key moved becomes the key between us. the left
+ * link of the page after the recipient is the caller's. the bounds
+ * of the recipient are set first, so that it takes the pairs with its prefix.
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveHalfTo(BPlusTreeLeafPage *recipient,
@@ -141,22 +557,31 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveHalfTo(BPlusTreeLeafPage *recipient,
     int current_size = GetSize();
     assert(current_size > GetMaxSize());
     int left_half = (current_size + 1) / 2;
-    recipient->CopyNFrom(array + left_half, current_size - left_half);
-    SetSize(left_half);
+    KeyType middle_key = KeyAt(left_half);
+    recipient->SetNextPageId(GetNextPageId());
+    recipient->SetPrevPageId(GetPageId());
+    recipient->SetLowKey(middle_key);
+    recipient->SetHighKey(GetHighKey());
+    recipient->CopyNFrom(this, left_half, current_size - left_half);
+    RemoveItems(left_half, current_size - left_half);
+    SetNextPageId(recipient->GetPageId());
+    SetHighKey(middle_key);
 }
 
 /*
- * Copy starting from items, and copy {size} number of elements into me.
+ * Copy {size} number of elements of page, starting from {from}, after mine.
+ * the page is rebuilt with them, that picks its layout for what it holds then.
  */
 INDEX_TEMPLATE_ARGUMENTS
-void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyNFrom(MappingType *items, int size) {
-    int current_size = GetSize();
-    int new_size = current_size + size;
-    assert(new_size <= GetMaxSize());
+void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyNFrom(const BPlusTreeLeafPage *page, int from, int size) {
+    std::vector<MappingType> items;
+    for (int i = 0; i < GetSize(); i++) {
+        items.push_back(GetItem(i));
+    }
     for (int i = 0; i < size; i++) {
-        array[current_size + i] = items[i];
+        items.push_back(page->GetItem(from + i));
     }
-    SetSize(new_size);
+    Rebuild(items);
 }
 
 /*****************************************************************************
@@ -173,7 +598,7 @@ bool B_PLUS_TREE_LEAF_PAGE_TYPE::Lookup(const KeyType &key, ValueType *value, co
     int location = LookUpTheKey(key, comparator);
     if (location != -1) {
         ret = true;
-        *value = array[location].second;
+        *value = ValueAt(location);
     }
     return ret;
 }
@@ -193,10 +618,7 @@ int B_PLUS_TREE_LEAF_PAGE_TYPE::RemoveAndDeleteRecord(const KeyType &key, const
     int position =  LookUpTheKey(key, comparator);
     if (position != -1) {
         current_size -= 1;
-        for(int i = position; i < current_size; i++){
-            array[i] = array[i+1];
-        }
-        SetSize(current_size);
+        RemoveItems(position, 1);
         LOG_INFO("[leaf-Remove] remove position %d. current array size is %d\n", position, current_size);
     } else {
         LOG_INFO("[leaf-Remove] didn't find match key.\n");
@@ -209,35 +631,37 @@ int B_PLUS_TREE_LEAF_PAGE_TYPE::RemoveAndDeleteRecord(const KeyType &key, const
  *****************************************************************************/
 /*
  * Remove all of key & value pairs from this page to "recipient" page. Don't forget
- * to update the next_page id in the sibling page
+ * to update the next_page id in the sibling page (the prev page id of the page
+ * after me is the caller's). the recipient takes over my high key before the
+ * pairs, that can make its prefix shorter.
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveAllTo(BPlusTreeLeafPage *recipient, 
                                             __attribute__((unused)) const KeyType &middle_key, 
                                             __attribute__((unused)) BufferPoolManager *buffer_pool_manager) {
-    recipient->CopyNFrom(array, GetSize());
     recipient->SetNextPageId(GetNextPageId());
-    SetSize(0);
+    recipient->SetHighKey(GetHighKey());
+    recipient->CopyNFrom(this, 0, GetSize());
+    RemoveItems(0, GetSize());
 }
 
 /*****************************************************************************
  * REDISTRIBUTE
  *****************************************************************************/
 /*
- * Remove the first key & value pair from this page to "recipient" page.
+ * Remove the first key & value pair from this page to "recipient" page. my
+ * second key becomes the key between the recipient and me.
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveFirstToEndOf(BPlusTreeLeafPage *recipient,
                                             __attribute__((unused)) const KeyType &middle_key, 
                                             __attribute__((unused)) BufferPoolManager *buffer_pool_manager) {
-    int current_size = GetSize();
-    assert(current_size > GetMinSize());
-    recipient->CopyLastFrom(array[0]);
-    current_size -= 1;
-    for(int i = 0; i < current_size; i++) {
-        array[i] = array[i+1];
-    }
-    SetSize(current_size);
+    assert(GetSize() > GetMinSize());
+    KeyType new_middle_key = KeyAt(1);
+    recipient->SetHighKey(new_middle_key);
+    recipient->CopyLastFrom(GetItem(0));
+    RemoveItems(0, 1);
+    SetLowKey(new_middle_key);
 }
 
 /*
@@ -245,14 +669,13 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveFirstToEndOf(BPlusTreeLeafPage *recipient,
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyLastFrom(const MappingType &item) {
-    int size = GetSize();
-    assert(size < GetMinSize());
-    array[size] = item;
-    IncreaseSize(1);
+    assert(GetSize() < GetMinSize());
+    InsertItem(GetSize(), item.first, item.second);
 }
 
 /*
- * Remove the last key & value pair from this page to "recipient" page.
+ * Remove the last key & value pair from this page to "recipient" page. it
+ * becomes the key between me and the recipient.
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveLastToFrontOf(BPlusTreeLeafPage *recipient,
@@ -261,8 +684,11 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveLastToFrontOf(BPlusTreeLeafPage *recipient,
     int size = GetSize();
     assert(size > GetMinSize());
     size -= 1;
-    recipient->CopyFirstFrom(array[size]);
-    SetSize(size);
+    MappingType item = GetItem(size);
+    recipient->SetLowKey(item.first);
+    recipient->CopyFirstFrom(item);
+    RemoveItems(size, 1);
+    SetHighKey(item.first);
 }
 
 /*
@@ -271,35 +697,60 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveLastToFrontOf(BPlusTreeLeafPage *recipient,
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_LEAF_PAGE_TYPE::CopyFirstFrom(const MappingType &item) {
     assert(GetSize() < GetMaxSize() - 1);
-    for(int i = GetSize(); i > 0; i--) {
-        array[i] = array[i-1];
-    }
-    array[0] = item;
-    IncreaseSize(1);
+    InsertItem(0, item.first, item.second);
 }
 
 
+/*
+ * Remove my last n key & value pairs to the front of "recipient" page, in one
+ * go. used by bulk loading to even out the last two pages of a level. with
+ * VARIABLE_KEYS my last pairs can be longer than the ones in front of them,
+ * fewer are moved if n do not fit, but at least enough for the recipient's min
+ * size. the sizes are the ones in cells, the layout the recipient is rebuilt
+ * with takes no more than that.
+ */
 INDEX_TEMPLATE_ARGUMENTS
-int B_PLUS_TREE_LEAF_PAGE_TYPE::LookUpTheKey(const KeyType &key, const KeyComparator &comparator) const {
-    int l = 0, r = GetSize() - 1;
-    while (l <= r) {
-        int m = l + ( r - l ) / 2;
-        //LOG_INFO("[leaf-lookup] mid = %d.", m);
-        int cmp = comparator(array[m].first, key);
-        if (cmp == 0) {
-            //LOG_INFO("[leaf-lookup] mid.key == key, return.");
-            return m;
-        } else {
-            if (cmp > 0) {
-                //LOG_INFO("[leaf-lookup] mid.key > key, go to left section.");
-                r = m - 1;
-            }
-            else {
-                //LOG_INFO("[leaf-lookup] mid.key < key, go to right section.");
-                l = m + 1;
-            }
+void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveLastNToFrontOf(BPlusTreeLeafPage *recipient, int n,
+                                            __attribute__((unused)) BufferPoolManager *buffer_pool_manager) {
+    int size = GetSize();
+    int recipient_size = recipient->GetSize();
+    assert(n > 0 && n <= size);
+    if (VARIABLE_KEYS && size_limit_ == 0) {
+        // sizes for the shortest prefix the recipient can end up with
+        int prefix_size = std::min(prefix_size_, recipient->prefix_size_);
+        int pair_overhead = sizeof(KeyCell) + sizeof(ValueType);
+        int used_size = 0;
+        for (int i = 0; i < recipient_size; i++) {
+            used_size += pair_overhead + CellKeySize(recipient->KeyAt(i), prefix_size);
+        }
+        int limit = PAGE_SIZE - LEAF_PAGE_HEADER_SIZE - (pair_overhead + sizeof(KeyType) - prefix_size);
+        int fit = 0;
+        while (fit < n) {
+            used_size += pair_overhead + CellKeySize(KeyAt(size - 1 - fit), prefix_size);
+            if (used_size > limit && recipient_size + fit >= recipient->GetMinSize()) break;
+            fit++;
         }
+        n = fit;
     }
+    KeyType middle_key = KeyAt(size - n);
+    recipient->SetLowKey(middle_key);
+    std::vector<MappingType> items;
+    for (int i = size - n; i < size; i++) {
+        items.push_back(GetItem(i));
+    }
+    for (int i = 0; i < recipient_size; i++) {
+        items.push_back(recipient->GetItem(i));
+    }
+    recipient->Rebuild(items);
+    RemoveItems(size - n, n);
+    SetHighKey(middle_key);
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_LEAF_PAGE_TYPE::LookUpTheKey(const KeyType &key, const KeyComparator &comparator) const {
+    int size;
+    int m = LowerBound(key, comparator, &size);
+    if (m < size && comparator(DecodeKey(m, low_key_), key) == 0) return m;
     LOG_INFO("[leaf-lookup] did not find the needed key, return.");
     return -1;
 }
@@ -47,14 +47,16 @@ bool BPlusTreePage::IsSafeToRemove() {
 }
 
 /*
- * Helper method to get min page size
- * Generally, min page size == max page size / 2
+ * Helper method to get/set min page size
+ * Generally, min page size == max page size / 2, of the max size the page was
+ * initialized with
  */
 int BPlusTreePage::GetMinSize() const { 
-    int ret = (max_size_ + 1) / 2;
+    int ret = min_size_;
     if ( IsRootPage() ) ret = IsLeafPage() ? 1 : 2;
     return ret;
  }
+void BPlusTreePage::SetMinSize(int min_size) { min_size_ = min_size; }
 
 /*
  * Helper methods to get/set parent page id
@@ -73,4 +75,41 @@ void BPlusTreePage::SetPageId(page_id_t page_id) { page_id_ = page_id; }
  */
 void BPlusTreePage::SetLSN(lsn_t lsn) { lsn_ = lsn; }
 
+/*
+ * Number of leading bytes the two keys have in common
+ */
+size_t BPlusTreePage::CommonPrefixSize(const char *lhs, const char *rhs, size_t key_size) {
+    size_t ret = 0;
+    while (ret < key_size && lhs[ret] == rhs[ret]) ret++;
+    return ret;
+}
+
+/*
+ * Rewrite size slots, so that the keys go without their first new_prefix_size
+ * bytes instead of old_prefix_size. the bytes in between are taken from prefix
+ * when the slots get longer, they have to be the same in all keys when the slots
+ * get shorter. slots are moved from the front when they shrink and from the back
+ * when they grow, so none is overwritten before it is moved.
+ */
+void BPlusTreePage::ResizeSlots(char *slots, int size, size_t key_size, size_t value_size, const char *prefix,
+                                size_t old_prefix_size, size_t new_prefix_size) {
+    size_t old_stride = key_size - old_prefix_size + value_size;
+    size_t new_stride = key_size - new_prefix_size + value_size;
+    if (new_prefix_size > old_prefix_size) {
+        size_t cut = new_prefix_size - old_prefix_size;
+        for (int i = 0; i < size; i++) {
+            char *slot = slots + i * old_stride;
+            assert(memcmp(slot, prefix + old_prefix_size, cut) == 0);
+            memmove(slots + i * new_stride, slot + cut, new_stride);
+        }
+    } else if (new_prefix_size < old_prefix_size) {
+        size_t added = old_prefix_size - new_prefix_size;
+        for (int i = size - 1; i >= 0; i--) {
+            char *slot = slots + i * new_stride;
+            memmove(slot + added, slots + i * old_stride, old_stride);
+            memcpy(slot, prefix + new_prefix_size, added);
+        }
+    }
+}
+
 }  // namespace bustub
@@ -0,0 +1,211 @@
+//===----------------------------------------------------------------------===//
+//
+//                         CMU-DB Project (15-445/645)
+//                         ***DO NO SHARE PUBLICLY***
+//
+// Identification: src/page/b_plus_tree_posting_page.cpp
+//
+// Copyright (c) 2018, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <cassert>
+#include <cstring>
+
+#include "common/logger.h"
+#include "storage/page/b_plus_tree_posting_page.h"
+
+namespace bustub {
+/*****************************************************************************
+ * HELPER METHODS AND UTILITIES
+ *****************************************************************************/
+/*
+ * Init method after creating a new posting page, the page holds no RIDs.
+ */
+void BPlusTreePostingPage::Init(page_id_t page_id) {
+    static_assert(sizeof(BPlusTreePostingPage) == POSTING_PAGE_HEADER_SIZE, "POSTING_PAGE_HEADER_SIZE is off");
+    SetPageType(IndexPageType::POSTING_PAGE);
+    SetPageId(page_id);
+    SetParentPageId(INVALID_PAGE_ID);
+    SetSize(0);
+    SetMaxSize(0);
+    SetMinSize(0);
+    next_page_id_ = INVALID_PAGE_ID;
+    data_size_ = 0;
+}
+
+page_id_t BPlusTreePostingPage::GetNextPageId() const { return next_page_id_; }
+
+void BPlusTreePostingPage::SetNextPageId(page_id_t next_page_id) { next_page_id_ = next_page_id; }
+
+/*
+ * Bytes from the start of the page to the end of the data, the rest is garbage.
+ */
+int BPlusTreePostingPage::GetUsedSize() const { return POSTING_PAGE_HEADER_SIZE + data_size_; }
+
+bool BPlusTreePostingPage::HasRoomForInsert() const {
+    return GetUsedSize() + MAX_INSERT_GROWTH <= static_cast<int>(PAGE_SIZE);
+}
+
+/*
+ * 7 bits a byte, low bits first, the high bit of a byte is set if more follow.
+ * @return : number of bytes written, at most 10
+ */
+int BPlusTreePostingPage::EncodeVarint(uint64_t value, char *out) {
+    int size = 0;
+    while (value >= 0x80) {
+        out[size++] = static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    out[size++] = static_cast<char>(value);
+    return size;
+}
+
+/*
+ * @return : number of bytes read, 0 if the varint does not end before end
+ */
+int BPlusTreePostingPage::DecodeVarint(const char *in, const char *end, uint64_t *value) {
+    *value = 0;
+    for (int size = 0; in + size < end && size < 10; size++) {
+        auto byte = static_cast<uint8_t>(in[size]);
+        *value |= static_cast<uint64_t>(byte & 0x7f) << (7 * size);
+        if ((byte & 0x80) == 0) return size + 1;
+    }
+    return 0;
+}
+
+RID BPlusTreePostingPage::GetFirstRid() const {
+    assert(GetSize() > 0);
+    uint64_t value;
+    DecodeVarint(data_, data_ + data_size_, &value);
+    return RID(static_cast<int64_t>(value));
+}
+
+/*
+ * Append the RIDs of this page to result, in order
+ */
+void BPlusTreePostingPage::GetRids(std::vector<RID> *result) const {
+    const char *end = data_ + data_size_;
+    uint64_t value = 0;
+    for (const char *in = data_; in < end;) {
+        uint64_t delta;
+        int size = DecodeVarint(in, end, &delta);
+        if (size == 0) break;
+        value += delta;
+        result->push_back(RID(static_cast<int64_t>(value)));
+        in += size;
+    }
+}
+
+/*****************************************************************************
+ * INSERTION
+ *****************************************************************************/
+/*
+ * Insert rid in order, the page has to have room for it (HasRoomForInsert()).
+ * only the varint of the RID after it changes, so the bytes after that move.
+ * @return : offset of the first byte that changed from the start of the page,
+ * -1 if rid is in the page already
+ */
+int BPlusTreePostingPage::Insert(const RID &rid) {
+    assert(HasRoomForInsert());
+    uint64_t target = SortKey(rid);
+    const char *end = data_ + data_size_;
+    uint64_t value = 0;
+    int offset = 0;
+    while (offset < data_size_) {
+        uint64_t delta;
+        int size = DecodeVarint(data_ + offset, end, &delta);
+        assert(size > 0);
+        if (value + delta == target) return -1;
+        if (value + delta > target) {
+            char buffer[MAX_INSERT_GROWTH];
+            int new_size = EncodeVarint(target - value, buffer);
+            new_size += EncodeVarint(value + delta - target, buffer + new_size);
+            memmove(data_ + offset + new_size, data_ + offset + size, data_size_ - offset - size);
+            memcpy(data_ + offset, buffer, new_size);
+            data_size_ += new_size - size;
+            IncreaseSize(1);
+            return POSTING_PAGE_HEADER_SIZE + offset;
+        }
+        value += delta;
+        offset += size;
+    }
+    data_size_ += EncodeVarint(target - value, data_ + offset);
+    IncreaseSize(1);
+    return POSTING_PAGE_HEADER_SIZE + offset;
+}
+
+/*
+ * Replace the RIDs of the page with the first size of rids, which have to be in
+ * order, as many of them as fit.
+ * @return : number of RIDs the page took
+ */
+int BPlusTreePostingPage::SetRids(const RID *rids, int size) {
+    char buffer[10];
+    uint64_t value = 0;
+    data_size_ = 0;
+    int count = 0;
+    for (; count < size; count++) {
+        uint64_t next = SortKey(rids[count]);
+        assert(count == 0 || next > value);
+        int varint_size = EncodeVarint(next - value, buffer);
+        if (GetUsedSize() + varint_size > static_cast<int>(PAGE_SIZE)) break;
+        memcpy(data_ + data_size_, buffer, varint_size);
+        data_size_ += varint_size;
+        value = next;
+    }
+    SetSize(count);
+    return count;
+}
+
+/*
+ * Move the upper half of the RIDs to recipient, a new page that is linked in
+ * after this one.
+ */
+void BPlusTreePostingPage::MoveHalfTo(BPlusTreePostingPage *recipient) {
+    std::vector<RID> rids;
+    GetRids(&rids);
+    int half = static_cast<int>(rids.size()) / 2;
+    recipient->SetRids(rids.data() + half, static_cast<int>(rids.size()) - half);
+    SetRids(rids.data(), half);
+    recipient->SetNextPageId(GetNextPageId());
+    SetNextPageId(recipient->GetPageId());
+    LOG_INFO("[posting page split] page %d keeps %d rids, page %d takes %d.\n", GetPageId(), GetSize(),
+             recipient->GetPageId(), recipient->GetSize());
+}
+
+/*****************************************************************************
+ * REMOVE
+ *****************************************************************************/
+/*
+ * Remove rid, the RID after it takes over its distance to the one before.
+ * @return : offset of the first byte that changed from the start of the page,
+ * -1 if rid is not in the page
+ */
+int BPlusTreePostingPage::Remove(const RID &rid) {
+    uint64_t target = SortKey(rid);
+    const char *end = data_ + data_size_;
+    uint64_t value = 0;
+    int offset = 0;
+    while (offset < data_size_) {
+        uint64_t delta;
+        int size = DecodeVarint(data_ + offset, end, &delta);
+        if (size == 0 || value + delta > target) return -1;
+        if (value + delta == target) {
+            uint64_t next_delta = 0;
+            int next_size = offset + size < data_size_ ? DecodeVarint(data_ + offset + size, end, &next_delta) : 0;
+            char buffer[10];
+            int new_size = next_size == 0 ? 0 : EncodeVarint(delta + next_delta, buffer);
+            memmove(data_ + offset + new_size, data_ + offset + size + next_size, data_size_ - offset - size - next_size);
+            memcpy(data_ + offset, buffer, new_size);
+            data_size_ -= size + next_size - new_size;
+            IncreaseSize(-1);
+            return POSTING_PAGE_HEADER_SIZE + offset;
+        }
+        value += delta;
+        offset += size;
+    }
+    return -1;
+}
+
+}  // namespace bustub
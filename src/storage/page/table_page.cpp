@@ -171,7 +171,8 @@ bool TablePage::UpdateTuple(const Tuple &new_tuple, Tuple *old_tuple, const RID
     } else if (!txn->IsExclusiveLocked(rid) && !lock_manager->LockExclusive(txn, rid)) {
       return false;
     }
-    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::UPDATE, rid, *old_tuple, new_tuple);
+    LogRecordType log_record_type = enable_delta_update_logging ? LogRecordType::DELTAUPDATE : LogRecordType::UPDATE;
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), log_record_type, rid, *old_tuple, new_tuple);
     lsn_t lsn = log_manager->AppendLogRecord(&log_record);
     SetLSN(lsn);
     txn->SetPrevLSN(lsn);
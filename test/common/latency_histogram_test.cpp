@@ -0,0 +1,67 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// latency_histogram_test.cpp
+//
+// Identification: test/common/latency_histogram_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <chrono>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "common/latency_histogram.h"
+#include "gtest/gtest.h"
+
+namespace bustub {
+
+TEST(LatencyHistogramTest, PercentileTest) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(0, histogram.GetCount());
+  EXPECT_EQ(std::chrono::nanoseconds(0), histogram.GetPercentile(0.99));
+
+  // 99 samples of 1us and one of 1ms.
+  for (int i = 0; i < 99; i++) {
+    histogram.Record(std::chrono::microseconds(1));
+  }
+  histogram.Record(std::chrono::milliseconds(1));
+  EXPECT_EQ(100, histogram.GetCount());
+  EXPECT_EQ(std::chrono::nanoseconds(99 * 1000 + 1000000), histogram.GetTotal());
+  EXPECT_EQ(std::chrono::milliseconds(1), histogram.GetMax());
+
+  // A percentile is the end of its power-of-two bucket: 1000ns falls into [512, 1024).
+  EXPECT_EQ(std::chrono::nanoseconds(1023), histogram.GetPercentile(0.5));
+  EXPECT_EQ(std::chrono::nanoseconds(1023), histogram.GetPercentile(0.99));
+  EXPECT_EQ(std::chrono::milliseconds(1), histogram.GetPercentile(1.0));
+
+  // Negative durations count as zero.
+  histogram.Reset();
+  histogram.Record(std::chrono::nanoseconds(-5));
+  EXPECT_EQ(1, histogram.GetCount());
+  EXPECT_EQ(std::chrono::nanoseconds(0), histogram.GetMax());
+  EXPECT_EQ(std::chrono::nanoseconds(0), histogram.GetPercentile(0.5));
+}
+
+TEST(LatencyHistogramTest, ConcurrentRecordTest) {
+  LatencyHistogram histogram;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&histogram, t] {
+      for (int i = 1; i <= 10000; i++) {
+        histogram.Record(std::chrono::nanoseconds(t * 10000 + i));
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(40000, histogram.GetCount());
+  EXPECT_EQ(std::chrono::nanoseconds(40000LL * 40001 / 2), histogram.GetTotal());
+  EXPECT_EQ(std::chrono::nanoseconds(40000), histogram.GetMax());
+}
+
+}  // namespace bustub
@@ -0,0 +1,231 @@
+/**
+ * b_plus_tree_batch_test.cpp
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "b_plus_tree_test_util.h"  // NOLINT
+#include "buffer/buffer_pool_manager.h"
+#include "gtest/gtest.h"
+#include "storage/index/b_plus_tree.h"
+
+namespace bustub {
+
+using Tree = BPlusTree<GenericKey<8>, RID, GenericComparator<8>>;
+using Pair = std::pair<GenericKey<8>, RID>;
+
+std::vector<Pair> SortedPairs(std::vector<int64_t> keys) {
+  std::sort(keys.begin(), keys.end());
+  std::vector<Pair> pairs(keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    pairs[i].first.SetFromInteger(keys[i]);
+    pairs[i].second = RID(keys[i]);
+  }
+  return pairs;
+}
+
+// every key in [0, scale) has to be found with its own RID exactly if present says so
+void CheckMultiGet(Tree *tree, int64_t scale, const std::function<bool(int64_t)> &present, Transaction *transaction) {
+  std::vector<GenericKey<8>> keys(scale);
+  size_t expected = 0;
+  for (int64_t key = 0; key < scale; key++) {
+    keys[key].SetFromInteger(key);
+    if (present(key)) expected++;
+  }
+  std::vector<std::vector<RID>> result;
+  EXPECT_EQ(tree->MultiGet(keys, &result, transaction), expected);
+  ASSERT_EQ(result.size(), keys.size());
+  for (int64_t key = 0; key < scale; key++) {
+    if (present(key)) {
+      ASSERT_EQ(result[key].size(), 1) << key;
+      EXPECT_EQ(result[key][0], RID(key));
+    } else {
+      EXPECT_TRUE(result[key].empty()) << key;
+    }
+  }
+}
+
+// batches of random keys, sorted within a batch, under small pages so that many of the pairs go into a leaf the batch
+// reached by its right link, and many need a split
+void BatchInsertAndLookup(bool blink) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
+  Tree tree("foo_pk", bpm, comparator, 8, 4, nullptr, blink);
+  Transaction *transaction = new Transaction(0);
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+
+  // only even keys go in, odd keys are lookups that miss
+  const int64_t scale = 10000;
+  std::vector<int64_t> keys;
+  for (int64_t key = 0; key < scale; key += 2) keys.push_back(key);
+  std::mt19937 gen(0);
+  std::shuffle(keys.begin(), keys.end(), gen);
+  for (size_t first = 0; first < keys.size(); first += 500) {
+    size_t last = std::min(first + 500, keys.size());
+    std::vector<Pair> pairs = SortedPairs(std::vector<int64_t>(keys.begin() + first, keys.begin() + last));
+    EXPECT_EQ(tree.InsertBatch(pairs, transaction), pairs.size());
+  }
+  // duplicates are skipped
+  std::vector<Pair> pairs = SortedPairs(std::vector<int64_t>(keys.begin(), keys.begin() + 100));
+  EXPECT_EQ(tree.InsertBatch(pairs, transaction), 0);
+  CheckMultiGet(&tree, scale, [](int64_t key) { return key % 2 == 0; }, transaction);
+
+  // keys out of order still find their values
+  std::vector<GenericKey<8>> lookups(keys.size());
+  for (size_t i = 0; i < keys.size(); i++) lookups[i].SetFromInteger(keys[i]);
+  std::vector<std::vector<RID>> result;
+  EXPECT_EQ(tree.MultiGet(lookups, &result, transaction), keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    ASSERT_EQ(result[i].size(), 1);
+    EXPECT_EQ(result[i][0], RID(keys[i]));
+  }
+
+  int64_t current_key = 0;
+  for (auto iterator = tree.begin(); iterator != tree.End(); ++iterator) {
+    EXPECT_EQ((*iterator).first.ToString(), current_key);
+    current_key += 2;
+  }
+  EXPECT_EQ(current_key, scale);
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete key_schema;
+  delete transaction;
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(BPlusTreeTests, BatchTest) {
+  BatchInsertAndLookup(false);
+  BatchInsertAndLookup(true);
+}
+
+// batches in a non-unique tree add to the posting lists of keys they meet again
+TEST(BPlusTreeTests, NonUniqueBatchTest) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
+  Tree tree("foo_pk", bpm, comparator, 8, 4, nullptr, false, false);
+  Transaction *transaction = new Transaction(0);
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+
+  // round r inserts RID(r, key) for every key
+  const int64_t scale = 200;
+  const int rounds = 5;
+  std::vector<Pair> pairs(scale);
+  std::vector<GenericKey<8>> keys(scale);
+  for (int round = 0; round < rounds; round++) {
+    for (int64_t key = 0; key < scale; key++) {
+      pairs[key].first.SetFromInteger(key);
+      pairs[key].second = RID(round, static_cast<uint32_t>(key));
+      keys[key] = pairs[key].first;
+    }
+    EXPECT_EQ(tree.InsertBatch(pairs, transaction), scale);
+  }
+  EXPECT_EQ(tree.InsertBatch(pairs, transaction), 0);
+
+  std::vector<std::vector<RID>> result;
+  EXPECT_EQ(tree.MultiGet(keys, &result, transaction), scale);
+  for (int64_t key = 0; key < scale; key++) {
+    ASSERT_EQ(result[key].size(), rounds);
+    for (int round = 0; round < rounds; round++) {
+      EXPECT_EQ(result[key][round], RID(round, static_cast<uint32_t>(key)));
+    }
+  }
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete key_schema;
+  delete transaction;
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+// batches that walk the leaves while other threads split and merge them
+void ConcurrentBatch(bool blink) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
+  Tree tree("foo_pk", bpm, comparator, 8, 4, nullptr, blink);
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+
+  // keys below scale are there from the start, the ones that are 1 mod 4 are removed and those at least scale are
+  // inserted in batches meanwhile. multiples of 4 below scale are always there.
+  const int64_t scale = 4000;
+  std::vector<int64_t> keys;
+  for (int64_t key = 0; key < scale; key++) keys.push_back(key);
+  Transaction *transaction = new Transaction(0);
+  EXPECT_EQ(tree.InsertBatch(SortedPairs(keys), transaction), scale);
+
+  auto remover = [&](uint64_t thread_itr) {
+    Transaction txn(static_cast<txn_id_t>(thread_itr + 1));
+    GenericKey<8> index_key;
+    for (int64_t key = 1; key < scale; key += 4) {
+      index_key.SetFromInteger(key);
+      EXPECT_TRUE(tree.Remove(index_key, &txn));
+    }
+  };
+  auto inserter = [&](uint64_t thread_itr) {
+    Transaction txn(static_cast<txn_id_t>(thread_itr + 1));
+    for (int64_t first = scale; first < 2 * scale; first += 200) {
+      std::vector<int64_t> batch;
+      for (int64_t key = first; key < first + 200; key++) {
+        if (static_cast<uint64_t>(key % 2) == thread_itr % 2) batch.push_back(key);
+      }
+      EXPECT_EQ(tree.InsertBatch(SortedPairs(batch), &txn), batch.size());
+    }
+  };
+  auto reader = [&](uint64_t thread_itr) {
+    Transaction txn(static_cast<txn_id_t>(thread_itr + 1));
+    std::vector<GenericKey<8>> batch(scale / 4);
+    for (int64_t i = 0; i < scale / 4; i++) batch[i].SetFromInteger(i * 4);
+    std::vector<std::vector<RID>> result;
+    for (int round = 0; round < 5; round++) {
+      EXPECT_EQ(tree.MultiGet(batch, &result, &txn), batch.size());
+    }
+  };
+  std::vector<std::thread> threads;
+  threads.emplace_back(remover, 0);
+  threads.emplace_back(inserter, 1);
+  threads.emplace_back(inserter, 2);
+  threads.emplace_back(reader, 3);
+  for (auto &thread : threads) thread.join();
+
+  CheckMultiGet(&tree, 2 * scale, [](int64_t key) { return key >= scale || key % 4 != 1; }, transaction);
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete key_schema;
+  delete transaction;
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(BPlusTreeTests, ConcurrentBatchTest) {
+  ConcurrentBatch(false);
+  ConcurrentBatch(true);
+}
+
+}  // namespace bustub
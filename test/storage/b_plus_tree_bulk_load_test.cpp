@@ -0,0 +1,181 @@
+/**
+ * b_plus_tree_bulk_load_test.cpp
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+#include "b_plus_tree_test_util.h"  // NOLINT
+#include "buffer/buffer_pool_manager.h"
+#include "gtest/gtest.h"
+#include "storage/index/b_plus_tree.h"
+
+namespace bustub {
+
+using Tree = BPlusTree<GenericKey<8>, RID, GenericComparator<8>>;
+
+// sizes of the leaves from left to right
+std::vector<int> LeafSizes(Tree *tree, BufferPoolManager *bpm) {
+  std::vector<int> sizes;
+  GenericKey<8> index_key;
+  Page *page = tree->FindLeafPage(index_key, true);
+  page_id_t page_id = page->GetPageId();
+  bpm->UnpinPage(page_id, false, LatchType::READ);
+  while (page_id != INVALID_PAGE_ID) {
+    page = bpm->FetchPage(page_id);
+    auto leaf = reinterpret_cast<BPlusTreeLeafPage<GenericKey<8>, RID, GenericComparator<8>> *>(page->GetData());
+    sizes.push_back(leaf->GetSize());
+    bpm->UnpinPage(page_id, false);
+    page_id = leaf->GetNextPageId();
+  }
+  return sizes;
+}
+
+// bulk load keys 1..n, check the tree, then remove everything in random order
+void BulkLoadAndCheck(int64_t n, double fill_factor, int leaf_max_size, int internal_max_size) {
+  std::string createStmt = "a bigint";
+  Schema *key_schema = ParseCreateStatement(createStmt);
+  GenericComparator<8> comparator(key_schema);
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
+  Tree tree("foo_pk", bpm, comparator, leaf_max_size, internal_max_size);
+  Transaction *transaction = new Transaction(0);
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+
+  // every key is handed over twice, the duplicates are skipped
+  int64_t next = 2;
+  bool ok = tree.BulkLoad(
+      [&](GenericKey<8> *index_key, RID *rid) {
+        if (next / 2 > n) return false;
+        int64_t key = next / 2;
+        index_key->SetFromInteger(key);
+        rid->Set(static_cast<int32_t>(key >> 32), key & 0xFFFFFFFF);
+        next++;
+        return true;
+      },
+      fill_factor, transaction);
+  EXPECT_TRUE(ok);
+  EXPECT_FALSE(tree.IsEmpty());
+
+  GenericKey<8> index_key;
+  std::vector<RID> rids;
+  for (int64_t key = 1; key <= n; key++) {
+    rids.clear();
+    index_key.SetFromInteger(key);
+    tree.GetValue(index_key, &rids, transaction);
+    EXPECT_EQ(rids.size(), 1);
+    EXPECT_EQ(rids[0].GetSlotNum(), key);
+  }
+  int64_t current_key = 1;
+  for (auto iterator = tree.begin(); iterator != tree.End(); ++iterator) {
+    EXPECT_EQ((*iterator).second.GetSlotNum(), current_key);
+    current_key++;
+  }
+  EXPECT_EQ(current_key, n + 1);
+
+  // pages are packed to the fill factor, only the last two leaves may differ from it
+  std::vector<int> sizes = LeafSizes(&tree, bpm);
+  int fill = std::max((leaf_max_size + 1) / 2, std::min(leaf_max_size, static_cast<int>(leaf_max_size * fill_factor)));
+  for (size_t i = 0; i < sizes.size(); i++) {
+    if (sizes.size() > 1) {
+      EXPECT_GE(sizes[i], (leaf_max_size + 1) / 2);
+    }
+    EXPECT_LE(sizes[i], leaf_max_size);
+    if (i + 2 < sizes.size()) {
+      EXPECT_EQ(sizes[i], fill);
+    }
+  }
+
+  // the tree has to stay valid under inserts and removes
+  std::vector<int64_t> keys;
+  for (int64_t key = 1; key <= n; key++) keys.push_back(key);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(static_cast<uint32_t>(n)));
+  for (int64_t key = n + 1; key <= n + 20; key++) {
+    index_key.SetFromInteger(key);
+    EXPECT_TRUE(tree.Insert(index_key, RID(key), transaction));
+    keys.push_back(key);
+  }
+  for (auto key : keys) {
+    index_key.SetFromInteger(key);
+    EXPECT_TRUE(tree.Remove(index_key, transaction));
+  }
+  EXPECT_TRUE(tree.IsEmpty());
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete key_schema;
+  delete transaction;
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(BPlusTreeTests, BulkLoadTest) {
+  for (int64_t n : {1, 2, 3, 5, 8, 9, 37, 100, 1000}) {
+    BulkLoadAndCheck(n, 1.0, 4, 3);
+    BulkLoadAndCheck(n, 0.7, 5, 4);
+    BulkLoadAndCheck(n, 0.1, 6, 5);
+  }
+}
+
+TEST(BPlusTreeTests, BulkLoadRejectTest) {
+  std::string createStmt = "a bigint";
+  Schema *key_schema = ParseCreateStatement(createStmt);
+  GenericComparator<8> comparator(key_schema);
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
+  Tree tree("foo_pk", bpm, comparator, 4, 3);
+  Transaction *transaction = new Transaction(0);
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+
+  // keys out of order: nothing is loaded
+  std::vector<int64_t> unsorted = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 4};
+  size_t next = 0;
+  auto source = [&](GenericKey<8> *index_key, RID *rid) {
+    if (next == unsorted.size()) return false;
+    index_key->SetFromInteger(unsorted[next]);
+    *rid = RID(unsorted[next]);
+    next++;
+    return true;
+  };
+  EXPECT_FALSE(tree.BulkLoad(source, 1.0, transaction));
+  EXPECT_TRUE(tree.IsEmpty());
+
+  // the file is sorted before loading
+  {
+    std::ofstream out("bulk_load_keys.txt");
+    for (auto key : {5, 3, 9, 1, 7, 2, 8, 4, 6, 10}) out << key << std::endl;
+  }
+  tree.BulkLoadFromFile("bulk_load_keys.txt", 1.0, transaction);
+  remove("bulk_load_keys.txt");
+  int64_t current_key = 1;
+  for (auto iterator = tree.begin(); iterator != tree.End(); ++iterator) {
+    EXPECT_EQ((*iterator).second.GetSlotNum(), current_key);
+    current_key++;
+  }
+  EXPECT_EQ(current_key, 11);
+
+  // only an empty tree can be loaded
+  next = 0;
+  unsorted.pop_back();
+  EXPECT_FALSE(tree.BulkLoad(source, 1.0, transaction));
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete key_schema;
+  delete transaction;
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+}  // namespace bustub
@@ -0,0 +1,258 @@
+/**
+ * b_plus_tree_compression_test.cpp
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "b_plus_tree_test_util.h"  // NOLINT
+#include "buffer/buffer_pool_manager.h"
+#include "gtest/gtest.h"
+#include "storage/index/b_plus_tree.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+using CompressedTree = BPlusTree<GenericKey<64>, RID, GenericComparator<64>>;
+using CompressedLeaf = BPlusTreeLeafPage<GenericKey<64>, RID, GenericComparator<64>>;
+
+// keys of eight bigint columns, only the last two differ
+GenericKey<64> CompositeKey(int64_t key, Schema *key_schema) {
+  std::vector<Value> values(8, ValueFactory::GetBigIntValue(42));
+  values[6] = ValueFactory::GetBigIntValue(key / 1000);
+  values[7] = ValueFactory::GetBigIntValue(key);
+  Tuple tuple(values, key_schema);
+  GenericKey<64> index_key;
+  index_key.SetFromKey(tuple, key_schema);
+  return index_key;
+}
+
+// walk the leaves from left to right, they have to be ordered and bounded by their low and high keys
+void CheckLeaves(CompressedTree *tree, BufferPoolManager *bpm, const GenericComparator<64> &comparator,
+                 int64_t expected_size) {
+  GenericKey<64> index_key;
+  Page *page = tree->FindLeafPage(index_key, true);
+  page_id_t page_id = page->GetPageId();
+  bpm->UnpinPage(page_id, false, LatchType::READ);
+  int64_t size = 0;
+  int leaves = 0;
+  int compressed = 0;
+  while (page_id != INVALID_PAGE_ID) {
+    page = bpm->FetchPage(page_id);
+    auto leaf = reinterpret_cast<CompressedLeaf *>(page->GetData());
+    for (int i = 0; i < leaf->GetSize(); i++) {
+      EXPECT_LE(comparator(leaf->GetLowKey(), leaf->KeyAt(i)), 0);
+      if (leaf->GetNextPageId() != INVALID_PAGE_ID) {
+        EXPECT_LT(comparator(leaf->KeyAt(i), leaf->GetHighKey()), 0);
+      }
+    }
+    if (leaf->GetPrefixSize() > 0) {
+      // LEAF_PAGE_SIZE for 64 byte keys
+      EXPECT_GT(leaf->GetMaxSize(), static_cast<int>((PAGE_SIZE - 56 - 2 * 64) / (64 + sizeof(RID)) - 1));
+      compressed++;
+    }
+    size += leaf->GetSize();
+    leaves++;
+    bpm->UnpinPage(page_id, false);
+    page_id = leaf->GetNextPageId();
+  }
+  EXPECT_EQ(size, expected_size);
+  if (leaves > 2) {
+    // the first and the last leaf are bounded by the smallest or the largest key only
+    EXPECT_GE(compressed, leaves - 2);
+  }
+  std::cout << "[CompressionTest] " << expected_size << " keys in " << leaves << " leaves, " << compressed
+            << " of them prefix compressed" << std::endl;
+}
+
+// insert and remove composite keys in random order under the default page sizes
+TEST(BPlusTreeTests, PrefixCompressionTest) {
+  Schema *key_schema = ParseCreateStatement("a bigint,b bigint,c bigint,d bigint,e bigint,f bigint,g bigint,h bigint");
+  GenericComparator<64> comparator(key_schema);
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(100, disk_manager);
+  CompressedTree tree("foo_pk", bpm, comparator);
+  Transaction *transaction = new Transaction(0);
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+
+  const int64_t scale = 20000;
+  std::vector<int64_t> keys;
+  for (int64_t key = 0; key < scale; key++) keys.push_back(key);
+  std::mt19937 gen(0);
+  std::shuffle(keys.begin(), keys.end(), gen);
+  for (auto key : keys) {
+    EXPECT_TRUE(tree.Insert(CompositeKey(key, key_schema), RID(key), transaction));
+  }
+  CheckLeaves(&tree, bpm, comparator, scale);
+
+  std::vector<RID> rids;
+  for (int64_t key = 0; key < scale; key++) {
+    rids.clear();
+    tree.GetValue(CompositeKey(key, key_schema), &rids, transaction);
+    EXPECT_EQ(rids.size(), 1);
+    EXPECT_EQ(rids[0].GetSlotNum(), key);
+  }
+  int64_t current_key = 0;
+  for (auto iterator = tree.begin(); iterator != tree.End(); ++iterator) {
+    EXPECT_EQ((*iterator).second.GetSlotNum(), current_key);
+    EXPECT_EQ(comparator((*iterator).first, CompositeKey(current_key, key_schema)), 0);
+    current_key++;
+  }
+  EXPECT_EQ(current_key, scale);
+
+  // merges and redistributions widen the bounds of pages again
+  std::shuffle(keys.begin(), keys.end(), gen);
+  for (int64_t i = 0; i < scale; i++) {
+    EXPECT_TRUE(tree.Remove(CompositeKey(keys[i], key_schema), transaction));
+    if (i == scale / 2) {
+      CheckLeaves(&tree, bpm, comparator, scale - i - 1);
+    }
+  }
+  EXPECT_TRUE(tree.IsEmpty());
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete key_schema;
+  delete transaction;
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+// varchar keys, most of them much shorter than the 64 bytes of the key
+GenericKey<64> VarcharKey(int64_t key, Schema *key_schema) {
+  std::string name = "user" + std::to_string(key);
+  if (key % 50 == 0) name += std::string(40, 'x');
+  std::vector<Value> values{ValueFactory::GetVarcharValue(name)};
+  Tuple tuple(values, key_schema);
+  GenericKey<64> index_key;
+  index_key.SetFromKey(tuple, key_schema);
+  return index_key;
+}
+
+// the keys in their varchar order
+std::vector<int64_t> VarcharOrder(int64_t scale) {
+  std::vector<std::pair<std::string, int64_t>> names;
+  for (int64_t key = 0; key < scale; key++) {
+    std::string name = "user" + std::to_string(key);
+    if (key % 50 == 0) name += std::string(40, 'x');
+    names.emplace_back(name, key);
+  }
+  std::sort(names.begin(), names.end());
+  std::vector<int64_t> order;
+  for (auto &name : names) order.push_back(name.second);
+  return order;
+}
+
+// leaves store the keys at their actual length, so they hold many more of them than fit at 64 bytes each
+TEST(BPlusTreeTests, VariableKeyTest) {
+  Schema *key_schema = ParseCreateStatement("a varchar(56)");
+  GenericComparator<64> comparator(key_schema);
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(100, disk_manager);
+  CompressedTree tree("foo_pk", bpm, comparator);
+  Transaction *transaction = new Transaction(0);
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+
+  const int64_t scale = 20000;
+  std::vector<int64_t> keys;
+  for (int64_t key = 0; key < scale; key++) keys.push_back(key);
+  std::mt19937 gen(0);
+  std::shuffle(keys.begin(), keys.end(), gen);
+  for (auto key : keys) {
+    EXPECT_TRUE(tree.Insert(VarcharKey(key, key_schema), RID(key), transaction));
+  }
+  int leaves = 0;
+  {
+    GenericKey<64> index_key;
+    Page *page = tree.FindLeafPage(index_key, true);
+    page_id_t leaf_id = page->GetPageId();
+    bpm->UnpinPage(leaf_id, false, LatchType::READ);
+    for (; leaf_id != INVALID_PAGE_ID; leaves++) {
+      page = bpm->FetchPage(leaf_id);
+      auto leaf = reinterpret_cast<CompressedLeaf *>(page->GetData());
+      bpm->UnpinPage(leaf_id, false);
+      leaf_id = leaf->GetNextPageId();
+    }
+  }
+  // LEAF_PAGE_SIZE for 64 byte keys
+  int fixed_size = static_cast<int>((PAGE_SIZE - 56 - 2 * 64) / (64 + sizeof(RID)) - 1);
+  std::cout << "[VariableKeyTest] " << scale << " keys in " << leaves << " leaves, " << fixed_size
+            << " keys of 64 bytes fit into one" << std::endl;
+  EXPECT_LT(leaves, scale / (2 * fixed_size));
+
+  // removes leave dead cells behind, the inserts after them have to move the cells together
+  std::vector<int64_t> order = VarcharOrder(scale);
+  for (int round = 0; round < 2; round++) {
+    for (int64_t i = 0; i < scale; i += 2) {
+      EXPECT_TRUE(tree.Remove(VarcharKey(keys[i], key_schema), transaction));
+    }
+    for (int64_t i = 0; i < scale; i += 2) {
+      EXPECT_TRUE(tree.Insert(VarcharKey(keys[i], key_schema), RID(keys[i]), transaction));
+    }
+  }
+  std::vector<RID> rids;
+  for (int64_t key = 0; key < scale; key++) {
+    rids.clear();
+    tree.GetValue(VarcharKey(key, key_schema), &rids, transaction);
+    EXPECT_EQ(rids.size(), 1);
+    EXPECT_EQ(rids[0].GetSlotNum(), key);
+  }
+  size_t next = 0;
+  for (auto iterator = tree.begin(); iterator != tree.End(); ++iterator) {
+    ASSERT_LT(next, order.size());
+    EXPECT_EQ((*iterator).second.GetSlotNum(), order[next]);
+    EXPECT_EQ(comparator((*iterator).first, VarcharKey(order[next], key_schema)), 0);
+    next++;
+  }
+  EXPECT_EQ(next, order.size());
+
+  std::shuffle(keys.begin(), keys.end(), gen);
+  for (auto key : keys) {
+    EXPECT_TRUE(tree.Remove(VarcharKey(key, key_schema), transaction));
+  }
+  EXPECT_TRUE(tree.IsEmpty());
+
+  // bulk loading fills the leaves by their bytes as well
+  next = 0;
+  EXPECT_TRUE(tree.BulkLoad(
+      [&](GenericKey<64> *index_key, RID *rid) {
+        if (next == order.size()) return false;
+        *index_key = VarcharKey(order[next], key_schema);
+        *rid = RID(order[next]);
+        next++;
+        return true;
+      },
+      1.0, transaction));
+  for (int64_t key = 0; key < scale; key++) {
+    rids.clear();
+    tree.GetValue(VarcharKey(key, key_schema), &rids, transaction);
+    EXPECT_EQ(rids.size(), 1);
+    EXPECT_EQ(rids[0].GetSlotNum(), key);
+  }
+  for (auto key : keys) {
+    EXPECT_TRUE(tree.Remove(VarcharKey(key, key_schema), transaction));
+  }
+  EXPECT_TRUE(tree.IsEmpty());
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete key_schema;
+  delete transaction;
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+}  // namespace bustub
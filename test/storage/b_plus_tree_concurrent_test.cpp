@@ -2,9 +2,11 @@
  * b_plus_tree_test.cpp
  */
 
+#include <atomic>
 #include <chrono>  // NOLINT
 #include <cstdio>
 #include <functional>
+#include <random>
 #include <thread>                   // NOLINT
 #include "b_plus_tree_test_util.h"  // NOLINT
 
@@ -576,5 +578,213 @@ TEST(BPlusTreeConcurrentTest, RandomTest) {
   delete key_schema;
 }
 
+/*
+ * Throughput of concurrent inserts and point lookups: the writers insert disjoint
+ * key ranges while the readers look up keys that are already in the tree.
+ */
+void InsertLookupThroughput(bool blink) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(100, disk_manager);
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, 32, 32, nullptr, blink);
+
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+
+  const int num_writers = 4;
+  const int num_readers = 4;
+  const int64_t keys_per_writer = 2000;
+  std::atomic<int> writers_left{num_writers};
+  std::atomic<uint64_t> lookups{0};
+  std::atomic<uint64_t> misses{0};
+
+  auto writer = [&](uint64_t thread_itr) {
+    GenericKey<8> index_key;
+    RID rid;
+    Transaction transaction(0);
+    // interleave the threads over the key space so that they share leaves
+    for (int64_t i = 0; i < keys_per_writer; i++) {
+      int64_t key = i * num_writers + static_cast<int64_t>(thread_itr);
+      rid.Set(static_cast<int32_t>(key >> 32), static_cast<uint32_t>(key & 0xFFFFFFFF));
+      index_key.SetFromInteger(key);
+      tree.Insert(index_key, rid, &transaction);
+    }
+    writers_left--;
+  };
+  auto reader = [&](uint64_t thread_itr) {
+    GenericKey<8> index_key;
+    std::vector<RID> rids;
+    Transaction transaction(0);
+    std::mt19937_64 rng(thread_itr);
+    // a key that is not inserted yet counts as a miss
+    while (writers_left > 0) {
+      int64_t key = static_cast<int64_t>(rng() % (num_writers * keys_per_writer));
+      index_key.SetFromInteger(key);
+      rids.clear();
+      if (!tree.GetValue(index_key, &rids, &transaction)) misses++;
+      lookups++;
+    }
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_writers; i++) threads.emplace_back(writer, i);
+  for (int i = 0; i < num_readers; i++) threads.emplace_back(reader, i);
+  for (auto &thread : threads) thread.join();
+  auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  uint64_t inserts = num_writers * keys_per_writer;
+  LOG_INFO("[throughput] %s, %d writers, %d readers: %lu inserts (%.0f/s), %lu lookups (%.0f/s, %lu misses) in %.3fs",
+           blink ? "b-link" : "crabbing", num_writers, num_readers, inserts, inserts / elapsed, lookups.load(),
+           lookups.load() / elapsed, misses.load(), elapsed);
+
+  // every insert is visible afterwards
+  Transaction transaction(0);
+  std::vector<RID> rids;
+  GenericKey<8> index_key;
+  for (int64_t key = 0; key < static_cast<int64_t>(inserts); key++) {
+    rids.clear();
+    index_key.SetFromInteger(key);
+    EXPECT_TRUE(tree.GetValue(index_key, &rids, &transaction));
+    ASSERT_EQ(rids.size(), 1);
+    EXPECT_EQ(rids[0].GetSlotNum(), key);
+  }
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+
+  delete key_schema;
+}
+
+TEST(BPlusTreeConcurrentTest, InsertLookupThroughputTest) { InsertLookupThroughput(false); }
+
+TEST(BPlusTreeConcurrentTest, BLinkInsertLookupThroughputTest) { InsertLookupThroughput(true); }
+
+/*
+ * B-link mode with small pages, so that splits (and root splits) race with each
+ * other: inserts and removes of separate key sets run concurrently.
+ */
+TEST(BPlusTreeConcurrentTest, BLinkMixTest) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, 4, 4, nullptr, true);
+
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+
+  const int64_t scale_factor = 1000;
+  std::vector<int64_t> keys;
+  std::vector<int64_t> more_keys;
+  std::vector<int64_t> remove_keys;
+  for (int64_t key = 1; key <= scale_factor; key++) {
+    keys.push_back(key);
+    more_keys.push_back(scale_factor + key);
+    if (key % 2 == 0) remove_keys.push_back(key);
+  }
+  LaunchParallelTest(4, InsertHelperSplit, &tree, keys, 4);
+
+  std::thread inserter([&] { LaunchParallelTest(2, InsertHelperSplit, &tree, more_keys, 2); });
+  std::thread remover([&] { LaunchParallelTest(2, DeleteHelperSplit, &tree, remove_keys, 2); });
+  inserter.join();
+  remover.join();
+
+  std::vector<int64_t> expected;
+  for (int64_t key = 1; key <= 2 * scale_factor; key++) {
+    if (key > scale_factor || key % 2 == 1) expected.push_back(key);
+  }
+
+  Transaction transaction(0);
+  std::vector<RID> rids;
+  GenericKey<8> index_key;
+  for (int64_t key = 1; key <= 2 * scale_factor; key++) {
+    rids.clear();
+    index_key.SetFromInteger(key);
+    bool in_tree = key > scale_factor || key % 2 == 1;
+    EXPECT_EQ(tree.GetValue(index_key, &rids, &transaction), in_tree);
+  }
+
+  size_t size = 0;
+  for (auto iterator = tree.begin(); iterator != tree.End(); ++iterator) {
+    ASSERT_LT(size, expected.size());
+    EXPECT_EQ((*iterator).second.GetSlotNum(), expected[size]);
+    size++;
+  }
+  EXPECT_EQ(size, expected.size());
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+
+  delete key_schema;
+}
+
+/*
+ * Read-only point lookups with a growing number of threads. Lookups do not latch
+ * the pages they read, so the throughput should grow with the threads.
+ */
+TEST(BPlusTreeConcurrentTest, LookupScalabilityTest) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(100, disk_manager);
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm, comparator, 32, 32);
+
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+
+  const int64_t num_keys = 2000;
+  std::vector<int64_t> keys;
+  for (int64_t key = 0; key < num_keys; key++) {
+    keys.push_back(key);
+  }
+  InsertHelper(&tree, keys);
+
+  const int lookups_per_thread = 50000;
+  for (int num_threads = 1; num_threads <= 4; num_threads *= 2) {
+    std::atomic<uint64_t> misses{0};
+    auto reader = [&](uint64_t thread_itr) {
+      GenericKey<8> index_key;
+      std::vector<RID> rids;
+      Transaction transaction(0);
+      std::mt19937_64 rng(thread_itr);
+      for (int i = 0; i < lookups_per_thread; i++) {
+        index_key.SetFromInteger(static_cast<int64_t>(rng() % num_keys));
+        rids.clear();
+        if (!tree.GetValue(index_key, &rids, &transaction)) misses++;
+      }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) threads.emplace_back(reader, i);
+    for (auto &thread : threads) thread.join();
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    LOG_INFO("[throughput] %d readers: %.0f lookups/s", num_threads, num_threads * lookups_per_thread / elapsed);
+    EXPECT_EQ(misses.load(), 0);
+  }
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+
+  delete key_schema;
+}
 
 }  // namespace bustub
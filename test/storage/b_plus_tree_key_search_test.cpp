@@ -0,0 +1,140 @@
+/**
+ * b_plus_tree_key_search_test.cpp
+ */
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "b_plus_tree_test_util.h"  // NOLINT
+#include "common/rid.h"
+#include "gtest/gtest.h"
+#include "storage/page/b_plus_tree_key_search.h"
+
+namespace bustub {
+
+// a comparator of its own type, so the search falls back to the primary template
+class PlainComparator : public GenericComparator<8> {
+ public:
+  explicit PlainComparator(Schema *key_schema) : GenericComparator<8>(key_schema) {}
+};
+
+using FastSearch = KeySearch<GenericKey<8>, GenericComparator<8>>;
+using PlainSearch = KeySearch<GenericKey<8>, PlainComparator>;
+
+// the slots of a page holding keys, with prefix_size bytes left out. the 8 bytes in front of the slots stay unused,
+// like the page header does in a page
+template <typename ValueType>
+std::vector<char> MakeSlots(const std::vector<GenericKey<8>> &keys, size_t prefix_size) {
+  size_t stride = sizeof(GenericKey<8>) - prefix_size + sizeof(ValueType);
+  std::vector<char> buffer(8 + keys.size() * stride);
+  for (size_t i = 0; i < keys.size(); i++) {
+    memcpy(buffer.data() + 8 + i * stride, keys[i].data_ + prefix_size, sizeof(GenericKey<8>) - prefix_size);
+  }
+  return buffer;
+}
+
+// sorted pages of random sizes and prefix sizes, probed with keys in and around them
+template <typename ValueType>
+void CompareSearches(Schema *key_schema) {
+  GenericComparator<8> comparator(key_schema);
+  PlainComparator plain_comparator(key_schema);
+  std::mt19937_64 gen(0);
+  std::uniform_int_distribution<int64_t> value_dist(-1000, 1000);
+
+  for (int round = 0; round < 500; round++) {
+    int size = static_cast<int>(gen() % 300);
+    size_t prefix_size = gen() % 8;
+    std::vector<int64_t> values(size);
+    for (auto &value : values) value = value_dist(gen);
+    // keys that share their first prefix_size bytes, as a big-endian integer with the sign bit flipped
+    if (round % 2 == 1) {
+      uint64_t mask = prefix_size == 0 ? ~0ULL : (1ULL << (8 * (8 - prefix_size))) - 1;
+      uint64_t prefix = gen() & ~mask;
+      for (auto &value : values) value = static_cast<int64_t>((prefix | (gen() & mask)) ^ (1ULL << 63));
+    } else {
+      prefix_size = 0;
+    }
+    std::sort(values.begin(), values.end());
+    values.erase(std::unique(values.begin(), values.end()), values.end());
+    size = static_cast<int>(values.size());
+
+    std::vector<GenericKey<8>> keys(size);
+    for (int i = 0; i < size; i++) {
+      keys[i].SetFromInteger(values[i]);
+    }
+    GenericKey<8> prefix_key = size == 0 ? GenericKey<8>{} : keys[0];
+    if (size == 0) prefix_size = 0;
+    std::vector<char> buffer = MakeSlots<ValueType>(keys, prefix_size);
+    KeySlots<GenericKey<8>> slots{buffer.data() + 8, sizeof(GenericKey<8>) - prefix_size + sizeof(ValueType),
+                                  &prefix_key, prefix_size};
+
+    std::vector<int64_t> probes = {INT64_MIN, INT64_MAX, 0, -1, 1};
+    for (int i = 0; i < size; i++) {
+      probes.push_back(values[i]);
+      probes.push_back(values[i] - 1);
+      probes.push_back(values[i] + 1);
+    }
+    GenericKey<8> key;
+    for (auto probe : probes) {
+      key.SetFromInteger(probe);
+      int begin = size == 0 ? 0 : static_cast<int>(gen() % 2);
+      int expected = static_cast<int>(std::lower_bound(values.begin() + begin, values.end(), probe) - values.begin());
+      EXPECT_EQ(FastSearch::LowerBound(slots, begin, size, key, comparator), expected);
+      EXPECT_EQ(PlainSearch::LowerBound(slots, begin, size, key, plain_comparator), expected);
+      expected = static_cast<int>(std::upper_bound(values.begin() + begin, values.end(), probe) - values.begin());
+      EXPECT_EQ(FastSearch::UpperBound(slots, begin, size, key, comparator), expected);
+      EXPECT_EQ(PlainSearch::UpperBound(slots, begin, size, key, plain_comparator), expected);
+    }
+  }
+}
+
+TEST(BPlusTreeTests, KeySearchTest) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  // leaf pages hold RIDs, internal pages hold page ids
+  CompareSearches<RID>(key_schema);
+  CompareSearches<page_id_t>(key_schema);
+  delete key_schema;
+}
+
+// lower bound searches in a full leaf page of 8 byte keys
+TEST(BPlusTreeTests, KeySearchBenchmark) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+  PlainComparator plain_comparator(key_schema);
+
+  const int size = 255;
+  std::vector<GenericKey<8>> keys(size);
+  for (int i = 0; i < size; i++) {
+    keys[i].SetFromInteger(2 * i);
+  }
+  std::vector<char> buffer = MakeSlots<RID>(keys, 0);
+  KeySlots<GenericKey<8>> slots{buffer.data() + 8, sizeof(GenericKey<8>) + sizeof(RID), &keys[0], 0};
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int64_t> dist(0, 2 * size);
+  const int searches = 1000000;
+  std::vector<GenericKey<8>> probes(1024);
+  for (auto &key : probes) key.SetFromInteger(dist(gen));
+
+  int64_t sum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < searches; i++) {
+    sum += PlainSearch::LowerBound(slots, 0, size, probes[i % probes.size()], plain_comparator);
+  }
+  double plain_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < searches; i++) {
+    sum -= FastSearch::LowerBound(slots, 0, size, probes[i % probes.size()], comparator);
+  }
+  double fast_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  EXPECT_EQ(sum, 0);
+  std::cout << "[KeySearchBenchmark] comparator: " << plain_seconds * 1e9 / searches
+            << " ns, specialized: " << fast_seconds * 1e9 / searches << " ns per search" << std::endl;
+  delete key_schema;
+}
+
+}  // namespace bustub
@@ -0,0 +1,191 @@
+/**
+ * b_plus_tree_non_unique_test.cpp
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "b_plus_tree_test_util.h"  // NOLINT
+#include "buffer/buffer_pool_manager.h"
+#include "gtest/gtest.h"
+#include "storage/index/b_plus_tree.h"
+
+namespace bustub {
+
+using Tree = BPlusTree<GenericKey<8>, RID, GenericComparator<8>>;
+
+// the rows of every key, in RID order
+using Rows = std::map<int64_t, std::vector<RID>>;
+
+// every key has to return exactly its rows, in order, and the iterator has to return all of them by key
+void CheckRows(Tree *tree, const Rows &rows, Transaction *transaction) {
+  GenericKey<8> index_key;
+  std::vector<RID> rids;
+  size_t total = 0;
+  for (auto &entry : rows) {
+    rids.clear();
+    index_key.SetFromInteger(entry.first);
+    EXPECT_EQ(tree->GetValue(index_key, &rids, transaction), !entry.second.empty());
+    ASSERT_EQ(rids.size(), entry.second.size()) << entry.first;
+    for (size_t i = 0; i < rids.size(); i++) {
+      EXPECT_EQ(rids[i], entry.second[i]);
+    }
+    total += entry.second.size();
+  }
+  if (total == 0) return;
+  auto entry = rows.begin();
+  size_t index = 0;
+  size_t count = 0;
+  for (auto iterator = tree->begin(); iterator != tree->End(); ++iterator) {
+    while (entry != rows.end() && index == entry->second.size()) {
+      entry++;
+      index = 0;
+    }
+    ASSERT_NE(entry, rows.end());
+    EXPECT_EQ((*iterator).first.ToString(), entry->first);
+    EXPECT_EQ((*iterator).second, entry->second[index]);
+    index++;
+    count++;
+  }
+  EXPECT_EQ(count, total);
+}
+
+void RemoveRow(Rows *rows, int64_t key, const RID &rid) {
+  auto &rids = (*rows)[key];
+  rids.erase(std::find(rids.begin(), rids.end(), rid));
+}
+
+// 50 keys with 100 rows each and one key with 5000 rows, whose posting list takes a few pages
+void NonUniqueInsertAndRemove(bool blink) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
+  Tree tree("foo_pk", bpm, comparator, 4, 4, nullptr, blink, false);
+  Transaction *transaction = new Transaction(0);
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+
+  std::vector<std::pair<int64_t, RID>> pairs;
+  for (int64_t row = 0; row < 5000; row++) {
+    pairs.emplace_back(row % 50, RID(static_cast<page_id_t>(row / 50), static_cast<uint32_t>(row % 50)));
+  }
+  for (int64_t row = 5000; row < 10000; row++) {
+    pairs.emplace_back(1000, RID(static_cast<page_id_t>(row / 50), static_cast<uint32_t>(row % 50)));
+  }
+  std::mt19937 gen(0);
+  std::shuffle(pairs.begin(), pairs.end(), gen);
+  Rows rows;
+  GenericKey<8> index_key;
+  for (auto &pair : pairs) {
+    index_key.SetFromInteger(pair.first);
+    EXPECT_TRUE(tree.Insert(index_key, pair.second, transaction));
+    rows[pair.first].push_back(pair.second);
+  }
+  for (auto &entry : rows) {
+    std::sort(entry.second.begin(), entry.second.end(),
+              [](const RID &lhs, const RID &rhs) { return lhs.Get() < rhs.Get(); });
+  }
+  // a row is in the index once
+  for (size_t i = 0; i < 100; i++) {
+    index_key.SetFromInteger(pairs[i].first);
+    EXPECT_FALSE(tree.Insert(index_key, pairs[i].second, transaction));
+  }
+  CheckRows(&tree, rows, transaction);
+
+  // remove rows one by one, lists shrink back into the leaves and pages of the long list go away
+  std::shuffle(pairs.begin(), pairs.end(), gen);
+  for (size_t i = 0; i < pairs.size() * 9 / 10; i++) {
+    index_key.SetFromInteger(pairs[i].first);
+    EXPECT_TRUE(tree.Remove(index_key, pairs[i].second, transaction));
+    EXPECT_FALSE(tree.Remove(index_key, pairs[i].second, transaction));
+    RemoveRow(&rows, pairs[i].first, pairs[i].second);
+  }
+  CheckRows(&tree, rows, transaction);
+
+  // the key goes with all of its rows
+  for (auto &entry : rows) {
+    index_key.SetFromInteger(entry.first);
+    EXPECT_EQ(tree.Remove(index_key, transaction), !entry.second.empty());
+    entry.second.clear();
+  }
+  CheckRows(&tree, rows, transaction);
+  if (!blink) {
+    EXPECT_TRUE(tree.IsEmpty());
+  }
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete key_schema;
+  delete transaction;
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(BPlusTreeTests, NonUniqueTest) {
+  NonUniqueInsertAndRemove(false);
+  NonUniqueInsertAndRemove(true);
+}
+
+// bulk loading puts the rows of a key into one posting list
+TEST(BPlusTreeTests, NonUniqueBulkLoadTest) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
+  Tree tree("foo_pk", bpm, comparator, 16, 4, nullptr, false, false);
+  Transaction *transaction = new Transaction(0);
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+
+  // key k has k rows, the keys are handed over in order and their rows in any order
+  Rows rows;
+  std::vector<std::pair<int64_t, RID>> pairs;
+  std::mt19937 gen(0);
+  for (int64_t key = 1; key <= 150; key++) {
+    size_t first = pairs.size();
+    for (int64_t row = 0; row < key; row++) {
+      pairs.emplace_back(key, RID(static_cast<page_id_t>(key), static_cast<uint32_t>(row)));
+      rows[key].push_back(pairs.back().second);
+    }
+    std::shuffle(pairs.begin() + first, pairs.end(), gen);
+  }
+  size_t next = 0;
+  EXPECT_TRUE(tree.BulkLoad(
+      [&](GenericKey<8> *index_key, RID *rid) {
+        if (next == pairs.size()) return false;
+        index_key->SetFromInteger(pairs[next].first);
+        *rid = pairs[next].second;
+        next++;
+        return true;
+      },
+      1.0, transaction));
+  CheckRows(&tree, rows, transaction);
+
+  GenericKey<8> index_key;
+  for (auto &pair : pairs) {
+    index_key.SetFromInteger(pair.first);
+    EXPECT_TRUE(tree.Remove(index_key, pair.second, transaction));
+    RemoveRow(&rows, pair.first, pair.second);
+  }
+  CheckRows(&tree, rows, transaction);
+  EXPECT_TRUE(tree.IsEmpty());
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete key_schema;
+  delete transaction;
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+}  // namespace bustub
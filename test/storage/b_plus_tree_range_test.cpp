@@ -0,0 +1,260 @@
+/**
+ * b_plus_tree_range_test.cpp
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "b_plus_tree_test_util.h"  // NOLINT
+#include "buffer/buffer_pool_manager.h"
+#include "gtest/gtest.h"
+#include "storage/index/b_plus_tree.h"
+
+namespace bustub {
+
+using Tree = BPlusTree<GenericKey<8>, RID, GenericComparator<8>>;
+using Leaf = BPlusTreeLeafPage<GenericKey<8>, RID, GenericComparator<8>>;
+
+GenericKey<8> Key(int64_t key) {
+  GenericKey<8> index_key;
+  index_key.SetFromInteger(key);
+  return index_key;
+}
+
+// the keys of present between low and high, in order
+std::vector<int64_t> Expected(const std::vector<bool> &present, int64_t low, bool low_inclusive, int64_t high,
+                              bool high_inclusive) {
+  std::vector<int64_t> keys;
+  for (int64_t key = 0; key < static_cast<int64_t>(present.size()); key++) {
+    if (present[key] && (key > low || (low_inclusive && key == low)) && (key < high || (high_inclusive && key == high))) {
+      keys.push_back(key);
+    }
+  }
+  return keys;
+}
+
+// scan [low, high] forward and backward with every kind of bound
+void CheckRanges(Tree *tree, const std::vector<bool> &present, int64_t low, int64_t high) {
+  for (int bounds = 0; bounds < 4; bounds++) {
+    bool low_inclusive = (bounds & 1) != 0;
+    bool high_inclusive = (bounds & 2) != 0;
+    std::vector<int64_t> expected = Expected(present, low, low_inclusive, high, high_inclusive);
+    std::vector<int64_t> keys;
+    for (auto iterator = tree->Begin(Key(low), low_inclusive, Key(high), high_inclusive); iterator != tree->End();
+         ++iterator) {
+      keys.push_back((*iterator).first.ToString());
+      EXPECT_EQ((*iterator).second, RID(keys.back()));
+    }
+    EXPECT_EQ(keys, expected) << low << " " << high << " " << bounds;
+
+    keys.clear();
+    for (auto iterator = tree->RBegin(Key(low), low_inclusive, Key(high), high_inclusive); iterator != tree->End();
+         --iterator) {
+      keys.push_back((*iterator).first.ToString());
+    }
+    std::reverse(keys.begin(), keys.end());
+    EXPECT_EQ(keys, expected) << low << " " << high << " " << bounds;
+  }
+}
+
+// the whole tree backward, and back and forth
+void CheckReverse(Tree *tree, const std::vector<bool> &present) {
+  std::vector<int64_t> expected = Expected(present, 0, true, static_cast<int64_t>(present.size()), false);
+  std::vector<int64_t> keys;
+  for (auto iterator = tree->rbegin(); iterator != tree->End(); --iterator) {
+    keys.push_back((*iterator).first.ToString());
+  }
+  std::reverse(keys.begin(), keys.end());
+  EXPECT_EQ(keys, expected);
+
+  if (expected.size() < 3) return;
+  auto iterator = tree->begin();
+  ++iterator;
+  ++iterator;
+  --iterator;
+  EXPECT_EQ((*iterator).first.ToString(), expected[1]);
+  --iterator;
+  EXPECT_EQ((*iterator).first.ToString(), expected[0]);
+  --iterator;
+  EXPECT_TRUE(iterator == tree->End());
+}
+
+void RangeScan(bool blink) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
+  Tree tree("foo_pk", bpm, comparator, 4, 4, nullptr, blink);
+  Transaction *transaction = new Transaction(0);
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+
+  // even keys only, so that bounds fall on keys and between them
+  const int64_t scale = 2000;
+  std::vector<bool> present(scale, false);
+  std::vector<int64_t> keys;
+  for (int64_t key = 0; key < scale; key += 2) keys.push_back(key);
+  std::mt19937 gen(0);
+  std::shuffle(keys.begin(), keys.end(), gen);
+  for (auto key : keys) {
+    EXPECT_TRUE(tree.Insert(Key(key), RID(key), transaction));
+    present[key] = true;
+  }
+  CheckReverse(&tree, present);
+  CheckRanges(&tree, present, 0, scale);
+  CheckRanges(&tree, present, 101, 1199);
+  CheckRanges(&tree, present, 100, 1200);
+  CheckRanges(&tree, present, 500, 500);
+  CheckRanges(&tree, present, 501, 502);
+
+  // merges relink the leaves that are left
+  for (size_t i = 0; i < keys.size() * 3 / 4; i++) {
+    EXPECT_TRUE(tree.Remove(Key(keys[i]), transaction));
+    present[keys[i]] = false;
+  }
+  CheckReverse(&tree, present);
+  CheckRanges(&tree, present, 0, scale);
+  CheckRanges(&tree, present, 301, 1700);
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete key_schema;
+  delete transaction;
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(BPlusTreeTests, RangeScanTest) {
+  RangeScan(false);
+  RangeScan(true);
+}
+
+// a scan that ends at the bound of a leaf does not touch the leaf beyond it, it would wait for its latch
+TEST(BPlusTreeTests, RangeScanStopsAtLeafTest) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
+  Tree tree("foo_pk", bpm, comparator, 4, 4);
+  Transaction *transaction = new Transaction(0);
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+
+  const int64_t scale = 100;
+  std::vector<bool> present(scale, true);
+  size_t next = 0;
+  EXPECT_TRUE(tree.BulkLoad(
+      [&](GenericKey<8> *index_key, RID *rid) {
+        if (next == scale) return false;
+        index_key->SetFromInteger(next);
+        *rid = RID(next);
+        next++;
+        return true;
+      },
+      1.0, transaction));
+  CheckReverse(&tree, present);
+
+  // write latch a leaf in the middle, its bounds are keys
+  Page *page = tree.FindLeafPage(Key(scale / 2));
+  auto leaf = reinterpret_cast<Leaf *>(page->GetData());
+  int64_t low_key = leaf->GetLowKey().ToString();
+  int64_t high_key = leaf->GetHighKey().ToString();
+  page_id_t leaf_id = page->GetPageId();
+  bpm->UnpinPage(leaf_id, false, LatchType::READ);
+  page = bpm->FetchPage(leaf_id);
+  page->WLatch();
+
+  int64_t count = 0;
+  for (auto iterator = tree.Begin(Key(0), true, Key(low_key), false); iterator != tree.End(); ++iterator) {
+    EXPECT_EQ((*iterator).first.ToString(), count);
+    count++;
+  }
+  EXPECT_EQ(count, low_key);
+  count = 0;
+  for (auto iterator = tree.RBegin(Key(high_key), true, Key(scale), true); iterator != tree.End(); --iterator) {
+    EXPECT_EQ((*iterator).first.ToString(), scale - 1 - count);
+    count++;
+  }
+  EXPECT_EQ(count, scale - high_key);
+  bpm->UnpinPage(leaf_id, false, LatchType::WRITE);
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete key_schema;
+  delete transaction;
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+// reverse scans meet splits and merges on their way to the left
+TEST(BPlusTreeTests, ConcurrentReverseScanTest) {
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(50, disk_manager);
+  Tree tree("foo_pk", bpm, comparator, 4, 4);
+  Transaction *transaction = new Transaction(0);
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+
+  // multiples of 4 stay, the other keys come and go
+  const int64_t scale = 2000;
+  for (int64_t key = 0; key < scale; key += 4) {
+    EXPECT_TRUE(tree.Insert(Key(key), RID(key), transaction));
+  }
+  auto writer = [&](uint64_t thread_itr) {
+    Transaction txn(static_cast<txn_id_t>(thread_itr + 1));
+    for (int round = 0; round < 3; round++) {
+      for (int64_t key = static_cast<int64_t>(thread_itr) + 1; key < scale; key += 4) {
+        EXPECT_TRUE(tree.Insert(Key(key), RID(key), &txn));
+      }
+      for (int64_t key = static_cast<int64_t>(thread_itr) + 1; key < scale; key += 4) {
+        EXPECT_TRUE(tree.Remove(Key(key), &txn));
+      }
+    }
+  };
+  auto reader = [&](uint64_t thread_itr) {
+    (void)thread_itr;
+    for (int round = 0; round < 10; round++) {
+      int64_t expected = scale - 4;
+      for (auto iterator = tree.rbegin(); iterator != tree.End(); --iterator) {
+        int64_t key = (*iterator).first.ToString();
+        if (key % 4 != 0) continue;
+        EXPECT_EQ(key, expected);
+        expected = key - 4;
+      }
+      EXPECT_EQ(expected, -4);
+    }
+  };
+  std::vector<std::thread> threads;
+  threads.emplace_back(writer, 0);
+  threads.emplace_back(writer, 1);
+  threads.emplace_back(reader, 2);
+  threads.emplace_back(reader, 3);
+  for (auto &thread : threads) thread.join();
+
+  std::vector<bool> present(scale, false);
+  for (int64_t key = 0; key < scale; key += 4) present[key] = true;
+  CheckReverse(&tree, present);
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete key_schema;
+  delete transaction;
+  delete disk_manager;
+  delete bpm;
+  remove("test.db");
+  remove("test.log");
+}
+
+}  // namespace bustub
@@ -10,7 +10,9 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <cstdio>
 #include <cstring>
+#include <vector>
 
 #include "common/exception.h"
 #include "gtest/gtest.h"
@@ -30,6 +32,11 @@ class DiskManagerTest : public ::testing::Test {
   void TearDown() override {
     remove("test.db");
     remove("test.log");
+    for (int i = 0; i < 16; i++) {
+      char name[32];
+      snprintf(name, sizeof(name), "test.log.%06d", i);
+      remove(name);
+    }
   };
 };
 
@@ -72,6 +79,73 @@ TEST_F(DiskManagerTest, ReadWriteLogTest) {
   dm.ShutDown();
 }
 
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, LogSegmentTest) {
+  // Each write is one "record" that starts with its own size, like a log record.
+  const int record_size = 1000;
+  auto make_record = [&](int i) {
+    std::vector<char> record(record_size, static_cast<char>(i));
+    *reinterpret_cast<int32_t *>(record.data()) = record_size;
+    return record;
+  };
+  std::string db_file("test.db");
+  const int segment_size = LOG_BUFFER_SIZE;
+  const int records_per_segment = segment_size / record_size;
+
+  // WriteLog expects the caller to alternate between buffers, so every record gets its own.
+  std::vector<std::vector<char>> records;
+  std::vector<int64_t> offsets;
+  {
+    DiskManager dm(db_file, segment_size);
+    EXPECT_EQ(0, dm.GetLogStartOffset());
+    for (int i = 0; i < 3 * records_per_segment; i++) {
+      records.push_back(make_record(i));
+      offsets.push_back(dm.WriteLog(records.back().data(), record_size));
+    }
+    // Writes are not split, so the first write of each segment starts it.
+    EXPECT_EQ(segment_size, offsets[records_per_segment]);
+    EXPECT_EQ(2 * segment_size, offsets[2 * records_per_segment]);
+    for (size_t i = 0; i < offsets.size(); i++) {
+      std::vector<char> buf(record_size);
+      ASSERT_TRUE(dm.ReadLog(buf.data(), record_size, offsets[i]));
+      EXPECT_EQ(make_record(i), buf);
+    }
+    EXPECT_FALSE(dm.ReadLog(nullptr, record_size, dm.GetLogEndOffset()));
+    // No ShutDown(): the next disk manager has to find the end of the log itself.
+  }
+
+  int64_t log_end;
+  {
+    DiskManager dm(db_file);
+    EXPECT_EQ(segment_size, dm.GetLogSegmentSize());
+    log_end = dm.GetLogEndOffset();
+    EXPECT_EQ(offsets.back() + record_size, log_end);
+
+    // Everything in front of the third segment is no longer needed. Both segments become spares and the next two
+    // segments reuse them.
+    dm.TruncateLog(offsets[2 * records_per_segment] + record_size);
+    EXPECT_EQ(2 * segment_size, dm.GetLogStartOffset());
+    EXPECT_FALSE(dm.ReadLog(nullptr, record_size, 0));
+    for (int i = 0; i < records_per_segment + 10; i++) {
+      records.push_back(make_record(records.size()));
+      offsets.push_back(dm.WriteLog(records.back().data(), record_size));
+    }
+    EXPECT_EQ(2, dm.GetNumRecycledLogSegments());
+    dm.ShutDown();
+  }
+
+  {
+    // The reused segments still held old records of the same size, which must not extend the log.
+    DiskManager dm(db_file);
+    EXPECT_EQ(2 * segment_size, dm.GetLogStartOffset());
+    EXPECT_EQ(offsets.back() + record_size, dm.GetLogEndOffset());
+    std::vector<char> buf(record_size);
+    ASSERT_TRUE(dm.ReadLog(buf.data(), record_size, offsets.back()));
+    EXPECT_EQ(records.back(), buf);
+    dm.ShutDown();
+  }
+}
+
 // NOLINTNEXTLINE
 TEST_F(DiskManagerTest, ThrowBadFileTest) { EXPECT_THROW(DiskManager("dev/null\\/foo/bar/baz/test.db"), Exception); }
 
@@ -0,0 +1,141 @@
+/**
+ * generic_key_test.cpp
+ */
+
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "b_plus_tree_test_util.h"  // NOLINT
+#include "buffer/buffer_pool_manager.h"
+#include "gtest/gtest.h"
+#include "storage/index/b_plus_tree.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+// keys compare like the values they were built from, column by column
+TEST(GenericKeyTest, ByteComparableTest) {
+  Schema *key_schema = ParseCreateStatement("a tinyint,b smallint,c integer,d bigint,e double,f varchar(8),g boolean");
+  GenericComparator<64> comparator(key_schema);
+  std::vector<std::vector<Value>> columns = {
+      {ValueFactory::GetTinyIntValue(-128 + 1), ValueFactory::GetTinyIntValue(-1), ValueFactory::GetTinyIntValue(0),
+       ValueFactory::GetTinyIntValue(1), ValueFactory::GetTinyIntValue(127)},
+      {ValueFactory::GetSmallIntValue(-300), ValueFactory::GetSmallIntValue(-1), ValueFactory::GetSmallIntValue(0),
+       ValueFactory::GetSmallIntValue(255), ValueFactory::GetSmallIntValue(256)},
+      {ValueFactory::GetIntegerValue(-70000), ValueFactory::GetIntegerValue(-1), ValueFactory::GetIntegerValue(0),
+       ValueFactory::GetIntegerValue(1), ValueFactory::GetIntegerValue(70000)},
+      {ValueFactory::GetBigIntValue(-(1LL << 40)), ValueFactory::GetBigIntValue(-1), ValueFactory::GetBigIntValue(0),
+       ValueFactory::GetBigIntValue(1), ValueFactory::GetBigIntValue(1LL << 40)},
+      {ValueFactory::GetDecimalValue(-1e10), ValueFactory::GetDecimalValue(-0.5), ValueFactory::GetDecimalValue(0.0),
+       ValueFactory::GetDecimalValue(0.25), ValueFactory::GetDecimalValue(3e8)},
+      {ValueFactory::GetVarcharValue(""), ValueFactory::GetVarcharValue("a"), ValueFactory::GetVarcharValue("ab"),
+       ValueFactory::GetVarcharValue("b"), ValueFactory::GetVarcharValue("ba")},
+      {ValueFactory::GetBooleanValue(false), ValueFactory::GetBooleanValue(true)},
+  };
+
+  std::mt19937 gen(0);
+  for (int i = 0; i < 2000; i++) {
+    std::vector<Value> lhs_values;
+    std::vector<Value> rhs_values;
+    int expected = 0;
+    for (auto &column : columns) {
+      std::uniform_int_distribution<size_t> dist(0, column.size() - 1);
+      size_t l = dist(gen);
+      size_t r = dist(gen);
+      lhs_values.push_back(column[l]);
+      rhs_values.push_back(column[r]);
+      if (expected == 0 && l != r) {
+        expected = l < r ? -1 : 1;
+      }
+    }
+    Tuple lhs_tuple(lhs_values, key_schema);
+    Tuple rhs_tuple(rhs_values, key_schema);
+    GenericKey<64> lhs;
+    GenericKey<64> rhs;
+    lhs.SetFromKey(lhs_tuple, key_schema);
+    rhs.SetFromKey(rhs_tuple, key_schema);
+    EXPECT_EQ(comparator(lhs, rhs), expected);
+  }
+
+  GenericKey<8> key;
+  for (int64_t value : {-(1LL << 62), -1LL, 0LL, 1LL, 1LL << 62}) {
+    key.SetFromInteger(value);
+    EXPECT_EQ(key.ToString(), value);
+  }
+  delete key_schema;
+}
+
+// B+ tree lookups with keys of KeySize / 8 bigint columns, the keys only differ in the last column
+template <size_t KeySize>
+void LookupBenchmark() {
+  std::string createStmt;
+  for (size_t i = 0; i < KeySize / 8; i++) {
+    createStmt += (i == 0 ? "c" : ",c") + std::to_string(i) + " bigint";
+  }
+  Schema *key_schema = ParseCreateStatement(createStmt);
+  GenericComparator<KeySize> comparator(key_schema);
+
+  DiskManager *disk_manager = new DiskManager("test.db");
+  BufferPoolManager *bpm = new BufferPoolManager(256, disk_manager);
+  BPlusTree<GenericKey<KeySize>, RID, GenericComparator<KeySize>> tree("foo_pk", bpm, comparator);
+  Transaction *transaction = new Transaction(0);
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(&page_id);
+  (void)header_page;
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+
+  const int64_t scale = 50000;
+  std::vector<GenericKey<KeySize>> keys(scale);
+  for (int64_t i = 0; i < scale; i++) {
+    std::vector<Value> values(KeySize / 8, ValueFactory::GetBigIntValue(0));
+    values.back() = ValueFactory::GetBigIntValue(i);
+    Tuple tuple(values, key_schema);
+    keys[i].SetFromKey(tuple, key_schema);
+  }
+  int64_t next = 0;
+  tree.BulkLoad(
+      [&](GenericKey<KeySize> *key, RID *rid) {
+        if (next == scale) return false;
+        *key = keys[next];
+        *rid = RID(next);
+        next++;
+        return true;
+      },
+      1.0, transaction);
+
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int64_t> dist(0, scale - 1);
+  std::vector<RID> rids;
+  const int lookups = 200000;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < lookups; i++) {
+    int64_t key = dist(gen);
+    rids.clear();
+    tree.GetValue(keys[key], &rids, transaction);
+    EXPECT_EQ(rids.size(), 1);
+    EXPECT_EQ(rids[0].GetSlotNum(), key);
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "[LookupBenchmark] GenericKey<" << KeySize << ">: " << seconds * 1e9 / lookups << " ns per lookup"
+            << std::endl;
+
+  delete key_schema;
+  delete transaction;
+  delete bpm;
+  delete disk_manager;
+  remove("test.db");
+  remove("test.log");
+}
+
+TEST(GenericKeyTest, LookupBenchmark) {
+  LookupBenchmark<8>();
+  LookupBenchmark<16>();
+  LookupBenchmark<32>();
+  LookupBenchmark<64>();
+}
+
+}  // namespace bustub